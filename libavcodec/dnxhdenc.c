@@ -112,8 +112,8 @@ void dnxhd_10bit_get_pixels_8x4_sym(int16_t *av_restrict block,
     memcpy(block + 4 * 8, pixels + 3 * line_size, 8 * sizeof(*block));
 }
 
-static int dnxhd_10bit_dct_quantize_444(MpegEncContext *ctx, int16_t *block,
-                                        int n, int qscale, int *overflow)
+static int dnxhd_10bit_quantize_444(MpegEncContext *ctx, int16_t *block,
+                                    int n, int qscale, int *overflow)
 {
     int i, j, level, last_non_zero, start_i;
     const int *qmat;
@@ -122,8 +122,6 @@ static int dnxhd_10bit_dct_quantize_444(MpegEncContext *ctx, int16_t *block,
     int max = 0;
     unsigned int threshold1, threshold2;
 
-    ctx->fdsp.fdct(block);
-
     block[0] = (block[0] + 2) >> 2;
     start_i = 1;
     last_non_zero = 0;
@@ -171,16 +169,21 @@ static int dnxhd_10bit_dct_quantize_444(MpegEncContext *ctx, int16_t *block,
     return last_non_zero;
 }
 
-static int dnxhd_10bit_dct_quantize(MpegEncContext *ctx, int16_t *block,
-                                    int n, int qscale, int *overflow)
+static int dnxhd_10bit_dct_quantize_444(MpegEncContext *ctx, int16_t *block,
+                                        int n, int qscale, int *overflow)
+{
+    ctx->fdsp.fdct(block);
+    return dnxhd_10bit_quantize_444(ctx, block, n, qscale, overflow);
+}
+
+static int dnxhd_10bit_quantize(MpegEncContext *ctx, int16_t *block,
+                                int n, int qscale, int *overflow)
 {
     const uint8_t *scantable= ctx->intra_scantable.scantable;
     const int *qmat = n<4 ? ctx->q_intra_matrix[qscale] : ctx->q_chroma_intra_matrix[qscale];
     int last_non_zero = 0;
     int i;
 
-    ctx->fdsp.fdct(block);
-
     // Divide by 4 with rounding, to compensate scaling of DCT coefficients
     block[0] = (block[0] + 2) >> 2;
 
@@ -202,6 +205,13 @@ static int dnxhd_10bit_dct_quantize(MpegEncContext *ctx, int16_t *block,
     return last_non_zero;
 }
 
+static int dnxhd_10bit_dct_quantize(MpegEncContext *ctx, int16_t *block,
+                                    int n, int qscale, int *overflow)
+{
+    ctx->fdsp.fdct(block);
+    return dnxhd_10bit_quantize(ctx, block, n, qscale, overflow);
+}
+
 static av_cold int dnxhd_init_vlc(DNXHDEncContext *ctx)
 {
     int i, j, level, run;
@@ -451,10 +461,12 @@ static av_cold int dnxhd_encode_init(AVCodecContext *avctx)
 
     if (ctx->is_444 || ctx->profile == FF_PROFILE_DNXHR_HQX) {
         ctx->m.dct_quantize     = dnxhd_10bit_dct_quantize_444;
+        ctx->quantize           = dnxhd_10bit_quantize_444;
         ctx->get_pixels_8x4_sym = dnxhd_10bit_get_pixels_8x4_sym;
         ctx->block_width_l2     = 4;
     } else if (ctx->bit_depth == 10) {
         ctx->m.dct_quantize     = dnxhd_10bit_dct_quantize;
+        ctx->quantize           = dnxhd_10bit_quantize;
         ctx->get_pixels_8x4_sym = dnxhd_10bit_get_pixels_8x4_sym;
         ctx->block_width_l2     = 4;
     } else {
@@ -903,6 +915,92 @@ static int dnxhd_calc_bits_thread(AVCodecContext *avctx, void *arg,
     return 0;
 }
 
+static int dnxhd_calc_bits_rdo_thread(AVCodecContext *avctx, void *arg,
+                                      int jobnr, int threadnr)
+{
+    DNXHDEncContext *ctx = avctx->priv_data;
+    int mb_y = jobnr, mb_x, q;
+    LOCAL_ALIGNED_16(int16_t, block, [64]);
+    LOCAL_ALIGNED_16(int16_t, dct_blocks, [12], [64]);
+    ctx = ctx->thread[threadnr];
+
+    ctx->m.last_dc[0] =
+    ctx->m.last_dc[1] =
+    ctx->m.last_dc[2] = 1 << (ctx->bit_depth + 2);
+
+    for (mb_x = 0; mb_x < ctx->m.mb_width; mb_x++) {
+        unsigned mb = mb_y * ctx->m.mb_width + mb_x;
+        int nb_blocks = 8 + 4 * ctx->is_444;
+        int dc_bits = 0;
+        int i;
+
+        dnxhd_get_blocks(ctx, mb_x, mb_y);
+
+        /* the transform does not depend on qscale, do it only once */
+        if (ctx->quantize) {
+            for (i = 0; i < nb_blocks; i++) {
+                memcpy(dct_blocks[i], ctx->blocks[i], 64 * sizeof(*block));
+                ctx->m.fdsp.fdct(dct_blocks[i]);
+            }
+        }
+
+        for (q = 1; q < avctx->qmax; q++) {
+            RCEntry *rc = &ctx->mb_rc[(q * ctx->m.mb_num) + mb];
+            int ssd     = 0;
+            int ac_bits = 0;
+            int coded   = 0;
+
+            for (i = 0; i < nb_blocks; i++) {
+                int overflow, last_index;
+                int n = dnxhd_switch_matrix(ctx, i);
+                int component = ctx->is_444 ? 4 * (n > 0) : 4 & (2 * i);
+
+                if (ctx->quantize) {
+                    memcpy(block, dct_blocks[i], 64 * sizeof(*block));
+                    last_index = ctx->quantize(&ctx->m, block, component,
+                                               q, &overflow);
+                } else {
+                    memcpy(block, ctx->blocks[i], 64 * sizeof(*block));
+                    last_index = ctx->m.dct_quantize(&ctx->m, block, component,
+                                                     q, &overflow);
+                }
+                ac_bits += dnxhd_calc_ac_bits(ctx, block, last_index);
+                coded   |= last_index;
+
+                /* neither does the DC quantisation */
+                if (q == 1) {
+                    int nbits, diff = block[0] - ctx->m.last_dc[n];
+                    if (diff < 0)
+                        nbits = av_log2_16bit(-2 * diff);
+                    else
+                        nbits = av_log2_16bit(2 * diff);
+
+                    av_assert1(nbits < ctx->bit_depth + 4);
+                    dc_bits += ctx->cid_table->dc_bits[nbits] + nbits;
+
+                    ctx->m.last_dc[n] = block[0];
+                }
+
+                dnxhd_unquantize_c(ctx, block, i, q, last_index);
+                ctx->m.idsp.idct(block);
+                ssd += dnxhd_ssd_block(block, ctx->blocks[i]);
+            }
+            rc->ssd  = ssd;
+            rc->bits = ac_bits + dc_bits + 12 +
+                       (1 + ctx->is_444) * 8 * ctx->vlc_bits[0];
+
+            /* The 10-bit quantisation matrices do not grow with qscale, so
+             * once all AC coefficients are zero they stay zero for the larger
+             * ones. The clipped 8-bit matrices lack that property. */
+            if (!coded && ctx->quantize) {
+                while (++q < avctx->qmax)
+                    ctx->mb_rc[(q * ctx->m.mb_num) + mb] = *rc;
+            }
+        }
+    }
+    return 0;
+}
+
 static int dnxhd_encode_thread(AVCodecContext *avctx, void *arg,
                                int jobnr, int threadnr)
 {
@@ -1035,11 +1133,8 @@ static int dnxhd_encode_rdo(AVCodecContext *avctx, DNXHDEncContext *ctx)
     int last_lower = INT_MAX, last_higher = 0;
     int x, y, q;
 
-    for (q = 1; q < avctx->qmax; q++) {
-        ctx->qscale = q;
-        avctx->execute2(avctx, dnxhd_calc_bits_thread,
-                        NULL, NULL, ctx->m.mb_height);
-    }
+    avctx->execute2(avctx, dnxhd_calc_bits_rdo_thread,
+                    NULL, NULL, ctx->m.mb_height);
     up_step = down_step = 2 << LAMBDA_FRAC_BITS;
     lambda  = ctx->lambda;
 
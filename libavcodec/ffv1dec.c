@@ -39,8 +39,8 @@
 #include "mathops.h"
 #include "ffv1.h"
 
-static inline av_flatten int get_symbol_inline(RangeCoder *c, uint8_t *state,
-                                               int is_signed)
+static av_always_inline av_flatten int get_symbol_inline(RangeCoder *c, uint8_t *state,
+                                                         int is_signed)
 {
     if (get_rac(c, state + 0))
         return 0;
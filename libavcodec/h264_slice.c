@@ -2444,6 +2444,39 @@ static int fill_filter_caches(const H264Context *h, H264SliceContext *sl, int mb
     return 0;
 }
 
+#if HAVE_THREADS
+static void deblock_report(H264Context *h, atomic_int *progress, int n)
+{
+    pthread_mutex_lock(&h->deblock_mutex);
+    atomic_store_explicit(progress, n, memory_order_release);
+    pthread_cond_broadcast(&h->deblock_cond);
+    pthread_mutex_unlock(&h->deblock_mutex);
+}
+#endif
+
+/**
+ * Wait until the MBs above and above right of the current MB are deblocked.
+ * Intra prediction swaps their bottom lines with the unfiltered top borders,
+ * which must not happen while they are filtered.
+ */
+static void await_deblock_top(H264SliceContext *sl)
+{
+#if HAVE_THREADS
+    H264Context *h = sl->h264;
+    int n = (sl->mb_y - 1 - FIELD_OR_MBAFF_PICTURE(h)) * h->mb_width +
+            FFMIN(sl->mb_x + 2, h->mb_width);
+
+    if (!sl->deblock_sl ||
+        atomic_load_explicit(&h->deblock_progress, memory_order_acquire) >= n)
+        return;
+
+    pthread_mutex_lock(&h->deblock_mutex);
+    while (atomic_load_explicit(&h->deblock_progress, memory_order_relaxed) < n)
+        pthread_cond_wait(&h->deblock_cond, &h->deblock_mutex);
+    pthread_mutex_unlock(&h->deblock_mutex);
+#endif
+}
+
 static void loop_filter(const H264Context *h, H264SliceContext *sl, int start_x, int end_x)
 {
     uint8_t *dest_y, *dest_cb, *dest_cr;
@@ -2456,6 +2489,15 @@ static void loop_filter(const H264Context *h, H264SliceContext *sl, int start_x,
     if (h->postpone_filter)
         return;
 
+#if HAVE_THREADS
+    /* hand the MBs over to deblock_rows() */
+    if (sl->deblock_sl) {
+        deblock_report(sl->h264, &sl->h264->deblock_ready,
+                       sl->mb_y * h->mb_width + end_x);
+        return;
+    }
+#endif
+
     if (sl->deblocking_filter) {
         for (mb_x = start_x; mb_x < end_x; mb_x++)
             for (mb_y = end_mb_y - FRAME_MBAFF(h); mb_y <= end_mb_y; mb_y++) {
@@ -2534,6 +2576,10 @@ static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
     int height         =  16      << FRAME_MBAFF(h);
     int deblock_border = (16 + 4) << FRAME_MBAFF(h);
 
+    /* done by deblock_rows() after the row is deblocked */
+    if (sl->deblock_sl)
+        return;
+
     if (sl->deblocking_filter) {
         if ((top + height) >= pic_height)
             height += deblock_border;
@@ -2631,6 +2677,8 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 return AVERROR_INVALIDDATA;
             }
 
+            await_deblock_top(sl);
+
             ret = ff_h264_decode_mb_cabac(h, sl);
             // STOP_TIMER("decode_mb_cabac")
 
@@ -2703,6 +2751,8 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 return AVERROR_INVALIDDATA;
             }
 
+            await_deblock_top(sl);
+
             ret = ff_h264_decode_mb_cavlc(h, sl);
 
             if (ret >= 0)
@@ -2781,6 +2831,114 @@ finish:
     return 0;
 }
 
+#if HAVE_THREADS
+/**
+ * Deblock the MB rows of the slice decoded by decode_slice() on another
+ * thread, each one as soon as it has been handed over completely.
+ */
+static void deblock_rows(H264Context *h, H264SliceContext *sl)
+{
+    int mb_x = sl->mb_x, mb_y = sl->mb_y;
+
+    for (; mb_y < h->mb_height; mb_y += 1 + FIELD_OR_MBAFF_PICTURE(h), mb_x = 0) {
+        int row = mb_y * h->mb_width;
+        int ready, end_x;
+
+        pthread_mutex_lock(&h->deblock_mutex);
+        while ((ready = atomic_load_explicit(&h->deblock_ready, memory_order_relaxed)) < row + h->mb_width &&
+               !h->decode_done)
+            pthread_cond_wait(&h->deblock_cond, &h->deblock_mutex);
+        pthread_mutex_unlock(&h->deblock_mutex);
+
+        end_x    = FFMIN(ready - row, h->mb_width);
+        sl->mb_y = mb_y;
+        for (; mb_x < end_x; mb_x++) {
+            loop_filter(h, sl, mb_x, mb_x + 1);
+            deblock_report(h, &h->deblock_progress, row + mb_x + 1);
+        }
+        if (end_x < h->mb_width)
+            break;
+        decode_finish_row(h, sl);
+    }
+}
+
+static int decode_slice_deblock(AVCodecContext *avctx, void *arg)
+{
+    H264SliceContext *sl = arg;
+    H264Context *h = sl->h264;
+    int ret;
+
+    if (sl != h->slice_ctx) {
+        deblock_rows(h, sl);
+        return 0;
+    }
+
+    ret = decode_slice(avctx, sl);
+
+    pthread_mutex_lock(&h->deblock_mutex);
+    h->decode_done = 1;
+    pthread_cond_broadcast(&h->deblock_cond);
+    pthread_mutex_unlock(&h->deblock_mutex);
+
+    return ret;
+}
+
+/**
+ * Decode the only slice of a picture on one slice thread while a second one
+ * deblocks the finished MB rows and draws them. Not used with
+ * draw_horiz_band(), which would be called from the second thread.
+ *
+ * The filter runs one MB row behind the decoding. The decoder waits for the
+ * MBs above right to be deblocked before it predicts from their unfiltered
+ * top borders, so the output is identical to decode_slice() alone.
+ */
+static int decode_slice_pipelined(H264Context *h)
+{
+    H264SliceContext *sl    = &h->slice_ctx[0];
+    H264SliceContext *lf_sl = &h->slice_ctx[1];
+    uint8_t (*top_borders[2])[(16 * 3) * 2] = { lf_sl->top_borders[0],
+                                                lf_sl->top_borders[1] };
+    int ret[2], start;
+
+    ret[0] = alloc_scratch_buffers(sl, h->cur_pic_ptr->f->linesize[0]);
+    if (ret[0] < 0)
+        return ret[0];
+
+    /* the filter context shares the top borders of the decoder */
+    lf_sl->top_borders[0]         = sl->top_borders[0];
+    lf_sl->top_borders[1]         = sl->top_borders[1];
+    lf_sl->linesize               = h->cur_pic_ptr->f->linesize[0];
+    lf_sl->uvlinesize             = h->cur_pic_ptr->f->linesize[1];
+    lf_sl->slice_num              = sl->slice_num;
+    lf_sl->slice_type             = sl->slice_type;
+    lf_sl->list_count             = sl->list_count;
+    lf_sl->deblocking_filter      = sl->deblocking_filter;
+    lf_sl->slice_alpha_c0_offset  = sl->slice_alpha_c0_offset;
+    lf_sl->slice_beta_offset      = sl->slice_beta_offset;
+    lf_sl->qp_thresh              = sl->qp_thresh;
+    lf_sl->qscale                 = sl->qscale;
+    lf_sl->mb_mbaff               = sl->mb_mbaff;
+    lf_sl->mb_field_decoding_flag = sl->mb_field_decoding_flag;
+    lf_sl->mb_x                   = sl->mb_x;
+    lf_sl->mb_y                   = sl->mb_y;
+
+    start = sl->mb_y * h->mb_width + sl->mb_x;
+    atomic_store_explicit(&h->deblock_ready,    start, memory_order_relaxed);
+    atomic_store_explicit(&h->deblock_progress, start, memory_order_relaxed);
+    h->decode_done = 0;
+    sl->deblock_sl = lf_sl;
+
+    h->avctx->execute(h->avctx, decode_slice_deblock, h->slice_ctx,
+                      ret, 2, sizeof(h->slice_ctx[0]));
+
+    sl->deblock_sl        = NULL;
+    lf_sl->top_borders[0] = top_borders[0];
+    lf_sl->top_borders[1] = top_borders[1];
+
+    return ret[0];
+}
+#endif
+
 /**
  * Call decode_slice() for each context.
  *
@@ -2806,7 +2964,15 @@ int ff_h264_execute_decode_slices(H264Context *h)
         h->slice_ctx[0].next_slice_idx = h->mb_width * h->mb_height;
         h->postpone_filter = 0;
 
-        ret = decode_slice(avctx, &h->slice_ctx[0]);
+#if HAVE_THREADS
+        /* the pipelined filter would call draw_horiz_band() from its own
+         * thread, callers expect it on the decoding one */
+        if (h->nb_slice_ctx > 1 && h->slice_ctx[0].deblocking_filter &&
+            !avctx->draw_horiz_band)
+            ret = decode_slice_pipelined(h);
+        else
+#endif
+            ret = decode_slice(avctx, &h->slice_ctx[0]);
         h->mb_y = h->slice_ctx[0].mb_y;
         if (ret < 0)
             goto finish;
@@ -352,6 +352,13 @@ static int h264_init_context(AVCodecContext *avctx, H264Context *h)
     for (i = 0; i < h->nb_slice_ctx; i++)
         h->slice_ctx[i].h264 = h;
 
+#if HAVE_THREADS
+    if (h->nb_slice_ctx > 1) {
+        pthread_mutex_init(&h->deblock_mutex, NULL);
+        pthread_cond_init(&h->deblock_cond, NULL);
+    }
+#endif
+
     return 0;
 }
 
@@ -371,6 +378,12 @@ static av_cold int h264_decode_end(AVCodecContext *avctx)
 
     h->cur_pic_ptr = NULL;
 
+#if HAVE_THREADS
+    if (h->nb_slice_ctx > 1) {
+        pthread_mutex_destroy(&h->deblock_mutex);
+        pthread_cond_destroy(&h->deblock_cond);
+    }
+#endif
     av_freep(&h->slice_ctx);
     h->nb_slice_ctx = 0;
 
@@ -28,6 +28,8 @@
 #ifndef AVCODEC_H264DEC_H
 #define AVCODEC_H264DEC_H
 
+#include <stdatomic.h>
+
 #include "libavutil/buffer.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/thread.h"
@@ -236,6 +238,11 @@ typedef struct H264SliceContext {
     int next_slice_idx;
     int mb_skip_run;
     int is_complex;
+    /**
+     * slice context deblocking this slice on another thread, set while a
+     * single slice picture is decoded with slice threads
+     */
+    struct H264SliceContext *deblock_sl;
 
     int picture_structure;
     int mb_field_decoding_flag;
@@ -372,6 +379,17 @@ typedef struct H264Context {
      */
     int postpone_filter;
 
+#if HAVE_THREADS
+    /* Deblocking of single slice pictures on a second slice thread: mb index
+     * (mb_y * mb_width + mb_x) up to which MBs are decoded and handed over
+     * for deblocking, and up to which they are deblocked. */
+    atomic_int deblock_ready;
+    atomic_int deblock_progress;
+    int decode_done;
+    pthread_mutex_t deblock_mutex;
+    pthread_cond_t deblock_cond;
+#endif
+
     /*
      * Set to 1 when the current picture is IDR, 0 otherwise.
      */
@@ -403,6 +403,23 @@ static inline void encode_vlc_codeword(PutBitContext *pb, unsigned codebook, int
 #define GET_SIGN(x)  ((x) >> 31)
 #define MAKE_CODE(x) ((((x)) * 2) ^ GET_SIGN(x))
 
+/**
+ * Reciprocal of a quantiser for quant_div(), exact for all int16_t inputs.
+ */
+static inline uint32_t quant_recip(int q)
+{
+    return ((1U << 31) + q - 1) / q;
+}
+
+/**
+ * Divide the magnitude of a coefficient by a quantiser without a division
+ * instruction. The result is exact for abs_coef <= 32768 and q < 65536.
+ */
+static av_always_inline int quant_div(int abs_coef, uint32_t recip)
+{
+    return (uint64_t)abs_coef * recip >> 31;
+}
+
 static void encode_dcs(PutBitContext *pb, int16_t *blocks,
                        int blocks_per_slice, int scale)
 {
@@ -435,7 +452,7 @@ static void encode_acs(PutBitContext *pb, int16_t *blocks,
                        const uint8_t *scan, const int16_t *qmat)
 {
     int idx, i;
-    int run, level, run_cb, lev_cb;
+    int run, run_cb, lev_cb;
     int max_coeffs, abs_level;
 
     max_coeffs = blocks_per_slice << 6;
@@ -444,14 +461,14 @@ static void encode_acs(PutBitContext *pb, int16_t *blocks,
     run        = 0;
 
     for (i = 1; i < 64; i++) {
+        uint32_t recip = quant_recip(qmat[scan[i]]);
         for (idx = scan[i]; idx < max_coeffs; idx += 64) {
-            level = blocks[idx] / qmat[scan[i]];
-            if (level) {
-                abs_level = FFABS(level);
+            abs_level = quant_div(FFABS(blocks[idx]), recip);
+            if (abs_level) {
                 encode_vlc_codeword(pb, ff_prores_ac_codebook[run_cb], run);
                 encode_vlc_codeword(pb, ff_prores_ac_codebook[lev_cb],
                                     abs_level - 1);
-                put_sbits(pb, 1, GET_SIGN(level));
+                put_sbits(pb, 1, GET_SIGN(blocks[idx]));
 
                 run_cb = ff_prores_run_to_cb_index[FFMIN(run, 15)];
                 lev_cb = ff_prores_lev_to_cb_index[FFMIN(abs_level, 9)];
@@ -695,9 +712,9 @@ static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
                         const uint8_t *scan, const int16_t *qmat)
 {
     int idx, i;
-    int run, level, run_cb, lev_cb;
+    int run, run_cb, lev_cb;
     int max_coeffs, abs_level;
-    int bits = 0;
+    int bits = 0, err = 0;
 
     max_coeffs = blocks_per_slice << 6;
     run_cb     = ff_prores_run_to_cb_index[4];
@@ -705,11 +722,13 @@ static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
     run        = 0;
 
     for (i = 1; i < 64; i++) {
+        const int q = qmat[scan[i]];
+        uint32_t recip = quant_recip(q);
         for (idx = scan[i]; idx < max_coeffs; idx += 64) {
-            level   = blocks[idx] / qmat[scan[i]];
-            *error += FFABS(blocks[idx]) % qmat[scan[i]];
-            if (level) {
-                abs_level = FFABS(level);
+            int abs_coef = FFABS(blocks[idx]);
+            abs_level = quant_div(abs_coef, recip);
+            err      += abs_coef - abs_level * q;
+            if (abs_level) {
                 bits += estimate_vlc(ff_prores_ac_codebook[run_cb], run);
                 bits += estimate_vlc(ff_prores_ac_codebook[lev_cb],
                                      abs_level - 1) + 1;
@@ -722,6 +741,7 @@ static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
             }
         }
     }
+    *error += err;
 
     return bits;
 }
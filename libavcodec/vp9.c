@@ -41,11 +41,8 @@
 static void vp9_free_entries(AVCodecContext *avctx) {
     VP9Context *s = avctx->priv_data;
 
-    if (avctx->active_thread_type & FF_THREAD_SLICE)  {
-        pthread_mutex_destroy(&s->progress_mutex);
-        pthread_cond_destroy(&s->progress_cond);
+    if (avctx->active_thread_type & FF_THREAD_SLICE)
         av_freep(&s->entries);
-    }
 }
 
 static int vp9_alloc_entries(AVCodecContext *avctx, int n) {
@@ -65,26 +62,23 @@ static int vp9_alloc_entries(AVCodecContext *avctx, int n) {
 
         for (i  = 0; i < n; i++)
             atomic_init(&s->entries[i], 0);
-
-        pthread_mutex_init(&s->progress_mutex, NULL);
-        pthread_cond_init(&s->progress_cond, NULL);
     }
     return 0;
 }
 
-static void vp9_report_tile_progress(VP9Context *s, int field, int n) {
+static void vp9_report_progress(VP9Context *s, atomic_int *progress, int n) {
     pthread_mutex_lock(&s->progress_mutex);
-    atomic_fetch_add_explicit(&s->entries[field], n, memory_order_release);
-    pthread_cond_signal(&s->progress_cond);
+    atomic_fetch_add_explicit(progress, n, memory_order_release);
+    pthread_cond_broadcast(&s->progress_cond);
     pthread_mutex_unlock(&s->progress_mutex);
 }
 
-static void vp9_await_tile_progress(VP9Context *s, int field, int n) {
-    if (atomic_load_explicit(&s->entries[field], memory_order_acquire) >= n)
+static void vp9_await_progress(VP9Context *s, atomic_int *progress, int n) {
+    if (atomic_load_explicit(progress, memory_order_acquire) >= n)
         return;
 
     pthread_mutex_lock(&s->progress_mutex);
-    while (atomic_load_explicit(&s->entries[field], memory_order_relaxed) != n)
+    while (atomic_load_explicit(progress, memory_order_relaxed) < n)
         pthread_cond_wait(&s->progress_cond, &s->progress_mutex);
     pthread_mutex_unlock(&s->progress_mutex);
 }
@@ -239,6 +233,10 @@ static int update_size(AVCodecContext *avctx, int w, int h)
     s->rows      = (h + 7) >> 3;
     lflvl_len    = avctx->active_thread_type == FF_THREAD_SLICE ? s->sb_rows : 1;
 
+    vp9_free_entries(avctx);
+    if ((ret = vp9_alloc_entries(avctx, s->sb_rows)) < 0)
+        return ret;
+
 #define assign(var, type, n) var = (type) p; p += s->sb_cols * (n) * sizeof(*var)
     av_freep(&s->intra_pred_data[0]);
     // FIXME we slightly over-allocate here for subsampled chroma, but a little
@@ -755,7 +753,7 @@ static int decode_frame_header(AVCodecContext *avctx,
     s->s.h.tiling.log2_tile_rows = decode012(&s->gb);
     s->s.h.tiling.tile_rows = 1 << s->s.h.tiling.log2_tile_rows;
     if (s->s.h.tiling.tile_cols != (1 << s->s.h.tiling.log2_tile_cols)) {
-        int n_range_coders;
+        int n_range_coders, n_td;
         VP56RangeCoder *rc;
 
         if (s->td) {
@@ -776,12 +774,17 @@ static int decode_frame_header(AVCodecContext *avctx,
         } else {
             n_range_coders = s->s.h.tiling.tile_cols;
         }
-        s->td = av_mallocz_array(s->active_tile_cols, sizeof(VP9TileData) +
+        // single tile streams are decoded with row multithreading, which
+        // needs one extra VP9TileData per thread for the reconstruction
+        n_td = s->active_tile_cols;
+        if (avctx->active_thread_type == FF_THREAD_SLICE && s->s.h.tiling.tile_cols == 1)
+            n_td += avctx->thread_count;
+        s->td = av_mallocz_array(n_td, sizeof(VP9TileData) +
                                  n_range_coders * sizeof(VP56RangeCoder));
         if (!s->td)
             return AVERROR(ENOMEM);
-        rc = (VP56RangeCoder *) &s->td[s->active_tile_cols];
-        for (i = 0; i < s->active_tile_cols; i++) {
+        rc = (VP56RangeCoder *) &s->td[n_td];
+        for (i = 0; i < n_td; i++) {
             s->td[i].s = s;
             s->td[i].c_b = rc;
             rc += n_range_coders;
@@ -1217,6 +1220,12 @@ static av_cold int vp9_decode_free(AVCodecContext *avctx)
 
     free_buffers(s);
     vp9_free_entries(avctx);
+#if HAVE_THREADS
+    if (avctx->active_thread_type & FF_THREAD_SLICE) {
+        pthread_mutex_destroy(&s->progress_mutex);
+        pthread_cond_destroy(&s->progress_cond);
+    }
+#endif
     av_freep(&s->td);
     return 0;
 }
@@ -1236,6 +1245,7 @@ static int decode_tiles(AVCodecContext *avctx,
     ls_y = f->linesize[0];
     ls_uv =f->linesize[1];
     bytesperpixel = s->bytesperpixel;
+    td->pass = s->pass;
 
     yoff = uvoff = 0;
     for (tile_row = 0; tile_row < s->s.h.tiling.tile_rows; tile_row++) {
@@ -1375,6 +1385,7 @@ int decode_tiles_mt(AVCodecContext *avctx, void *tdata, int jobnr,
     set_tile_offset(&tile_col_start, &tile_col_end,
                     jobnr, s->s.h.tiling.log2_tile_cols, s->sb_cols);
     td->tile_col_start  = tile_col_start;
+    td->pass = 0;
     uvoff = (64 * bytesperpixel >> s->ss_h)*(tile_col_start >> 3);
     yoff = (64 * bytesperpixel)*(tile_col_start >> 3);
     lflvl_ptr_base = s->lflvl+(tile_col_start >> 3);
@@ -1426,7 +1437,7 @@ int decode_tiles_mt(AVCodecContext *avctx, void *tdata, int jobnr,
                        8 * tile_cols_len * bytesperpixel >> s->ss_h);
             }
 
-            vp9_report_tile_progress(s, row >> 3, 1);
+            vp9_report_progress(s, &s->entries[row >> 3], 1);
         }
     }
     return 0;
@@ -1446,7 +1457,7 @@ int loopfilter_proc(AVCodecContext *avctx)
     ls_uv =f->linesize[1];
 
     for (i = 0; i < s->sb_rows; i++) {
-        vp9_await_tile_progress(s, i, s->s.h.tiling.tile_cols);
+        vp9_await_progress(s, &s->entries[i], s->s.h.tiling.tile_cols);
 
         if (s->s.h.filter.level) {
             yoff = (ls_y * 64)*i;
@@ -1462,6 +1473,159 @@ int loopfilter_proc(AVCodecContext *avctx)
     }
     return 0;
 }
+
+static void set_row_block_data(VP9TileData *td, int sb_row)
+{
+    VP9Context *s = td->s;
+    VP9TileData *td0 = &s->td[0];
+    int bytesperpixel = s->bytesperpixel;
+    int chroma_blocks = 64 * 64 >> (s->ss_h + s->ss_v);
+    int chroma_eobs   = 16 * 16 >> (s->ss_h + s->ss_v);
+    int sbs = sb_row * s->sb_cols;
+
+    // every sb row gets a fixed part of the 2-pass block buffers, so that the
+    // rows can be reconstructed independently of each other
+    td->b          = td0->b_base + sb_row * 8 * s->cols;
+    td->block      = td0->block_base + sbs * 64 * 64 * bytesperpixel;
+    td->uvblock[0] = td0->uvblock_base[0] + sbs * chroma_blocks * bytesperpixel;
+    td->uvblock[1] = td0->uvblock_base[1] + sbs * chroma_blocks * bytesperpixel;
+    td->eob        = td0->eob_base + sbs * 16 * 16;
+    td->uveob[0]   = td0->uveob_base[0] + sbs * chroma_eobs;
+    td->uveob[1]   = td0->uveob_base[1] + sbs * chroma_eobs;
+}
+
+/**
+ * Row multithreading main function: parse all sb rows (pass 1) while the
+ * slice threads reconstruct the rows that are already parsed.
+ */
+static av_always_inline
+int parse_rows_proc(AVCodecContext *avctx)
+{
+    VP9Context *s = avctx->priv_data;
+    VP9TileData *td = &s->td[0];
+    VP9Filter *lflvl_ptr = s->lflvl;
+    int row, col, tile_row, tile_row_start, tile_row_end;
+
+    td->pass = 1;
+    td->tile_col_start = 0;
+    for (tile_row = 0; tile_row < s->s.h.tiling.tile_rows; tile_row++) {
+        set_tile_offset(&tile_row_start, &tile_row_end,
+                        tile_row, s->s.h.tiling.log2_tile_rows, s->sb_rows);
+
+        td->c = &td->c_b[tile_row];
+        for (row = tile_row_start; row < tile_row_end; row += 8) {
+            memset(td->left_partition_ctx, 0, 8);
+            memset(td->left_skip_ctx, 0, 8);
+            if (s->s.h.keyframe || s->s.h.intraonly) {
+                memset(td->left_mode_ctx, DC_PRED, 16);
+            } else {
+                memset(td->left_mode_ctx, NEARESTMV, 8);
+            }
+            memset(td->left_y_nnz_ctx, 0, 16);
+            memset(td->left_uv_nnz_ctx, 0, 32);
+            memset(td->left_segpred_ctx, 0, 8);
+
+            set_row_block_data(td, row >> 3);
+            // the pixel offsets are only used by pass 2
+            for (col = 0; col < s->cols; col += 8, lflvl_ptr++) {
+                if (vpX_rac_is_end(td->c)) {
+                    atomic_store(&s->error_sb, (row >> 3) * s->sb_cols + (col >> 3));
+                    vp9_report_progress(s, &s->rows_parsed, s->sb_rows - (row >> 3));
+                    return AVERROR_INVALIDDATA;
+                }
+                decode_sb(td, row, col, lflvl_ptr, 0, 0, BL_64X64);
+            }
+
+            vp9_report_progress(s, &s->rows_parsed, 1);
+        }
+    }
+    return 0;
+}
+
+static av_always_inline
+void finish_sb_mt(AVCodecContext *avctx, VP9Filter *lflvl, int row, int col,
+                  ptrdiff_t yoff, ptrdiff_t uvoff)
+{
+    VP9Context *s = avctx->priv_data;
+    AVFrame *f = s->s.frames[CUR_FRAME].tf.f;
+    ptrdiff_t ls_y = f->linesize[0], ls_uv = f->linesize[1];
+    int bytesperpixel = s->bytesperpixel;
+    int len = 8 * FFMIN(s->cols - col, 8) * bytesperpixel;
+
+    // backup pre-loopfilter reconstruction data for intra prediction of the
+    // next row of sb64s; this row is done reading the previous data here
+    if (row + 8 < s->rows) {
+        memcpy(s->intra_pred_data[0] + col * 8 * bytesperpixel,
+               f->data[0] + yoff + 63 * ls_y, len);
+        memcpy(s->intra_pred_data[1] + (col * 8 * bytesperpixel >> s->ss_h),
+               f->data[1] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv,
+               len >> s->ss_h);
+        memcpy(s->intra_pred_data[2] + (col * 8 * bytesperpixel >> s->ss_h),
+               f->data[2] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv,
+               len >> s->ss_h);
+    }
+
+    if (s->s.h.filter.level)
+        ff_vp9_loopfilter_sb(avctx, lflvl, row, col, yoff, uvoff);
+}
+
+/**
+ * Row multithreading job: reconstruct and loopfilter one sb row.
+ *
+ * A sb is finished (intra pred backup and loopfilter) after its right
+ * neighbour is reconstructed, and every sb waits until the row above has
+ * finished the sb above-right of it, so the result is the same as for
+ * sequential decoding. entries[] is incremented for every reconstructed sb
+ * and once more after the last sb is finished, so entries[] - 1 sbs of the
+ * row are finished.
+ */
+static av_always_inline
+int decode_rows_mt(AVCodecContext *avctx, void *tdata, int jobnr,
+                   int threadnr)
+{
+    VP9Context *s = avctx->priv_data;
+    VP9TileData *td = &s->td[1 + threadnr];
+    AVFrame *f = s->s.frames[CUR_FRAME].tf.f;
+    int bytesperpixel = s->bytesperpixel, row = jobnr << 3, col, sb_col;
+    ptrdiff_t yoff = f->linesize[0] * 64 * jobnr;
+    ptrdiff_t uvoff = (f->linesize[1] * 64 >> s->ss_v) * jobnr;
+    VP9Filter *lflvl_ptr = s->lflvl + s->sb_cols * jobnr;
+    int sb_cols = s->sb_cols, nb_sbs;
+
+    vp9_await_progress(s, &s->rows_parsed, jobnr + 1);
+    // like decode_tiles(), stop at the first sb that could not be parsed and
+    // leave that row unfiltered
+    nb_sbs = atomic_load(&s->error_sb) - jobnr * sb_cols;
+
+    td->pass = 2;
+    td->tile_col_start = 0;
+    set_row_block_data(td, jobnr);
+
+    for (col = 0, sb_col = 0; col < s->cols;
+         col += 8, sb_col++, yoff += 64 * bytesperpixel,
+         uvoff += 64 * bytesperpixel >> s->ss_h, lflvl_ptr++) {
+        if (sb_col >= nb_sbs)
+            break;
+        if (jobnr)
+            vp9_await_progress(s, &s->entries[jobnr - 1],
+                               FFMIN(sb_col + 3, sb_cols + 1));
+
+        memset(lflvl_ptr->mask, 0, sizeof(lflvl_ptr->mask));
+        decode_sb_mem(td, row, col, lflvl_ptr, yoff, uvoff, BL_64X64);
+        if (col && nb_sbs >= sb_cols)
+            finish_sb_mt(avctx, lflvl_ptr - 1, row, col - 8,
+                         yoff - 64 * bytesperpixel,
+                         uvoff - (64 * bytesperpixel >> s->ss_h));
+        vp9_report_progress(s, &s->entries[jobnr], 1);
+    }
+    if (nb_sbs >= sb_cols)
+        finish_sb_mt(avctx, lflvl_ptr - 1, row, col - 8,
+                     yoff - 64 * bytesperpixel,
+                     uvoff - (64 * bytesperpixel >> s->ss_h));
+    vp9_report_progress(s, &s->entries[jobnr], sb_cols + 1 - sb_col);
+
+    return 0;
+}
 #endif
 
 static int vp9_decode_frame(AVCodecContext *avctx, void *frame,
@@ -1570,6 +1734,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
     memset(s->above_segpred_ctx, 0, s->cols);
     s->pass = s->s.frames[CUR_FRAME].uses_2pass =
         avctx->active_thread_type == FF_THREAD_FRAME && s->s.h.refreshctx && !s->s.h.parallelmode;
+    // row multithreading parses into the 2-pass buffers as well
+    if (avctx->active_thread_type == FF_THREAD_SLICE && s->s.h.tiling.tile_cols == 1)
+        s->s.frames[CUR_FRAME].uses_2pass = 1;
     if ((ret = update_block_buffers(avctx)) < 0) {
         av_log(avctx, AV_LOG_ERROR,
                "Failed to allocate block buffers\n");
@@ -1642,7 +1809,15 @@ FF_ENABLE_DEPRECATION_WARNINGS
                 }
             }
 
-            ff_slice_thread_execute_with_mainfunc(avctx, decode_tiles_mt, loopfilter_proc, s->td, NULL, s->s.h.tiling.tile_cols);
+            if (s->s.h.tiling.tile_cols == 1) {
+                atomic_store(&s->rows_parsed, 0);
+                atomic_store(&s->error_sb, s->sb_rows * s->sb_cols);
+                ff_slice_thread_execute_with_mainfunc(avctx, decode_rows_mt, parse_rows_proc, s->td, NULL, s->sb_rows);
+                if (atomic_load(&s->error_sb) < s->sb_rows * s->sb_cols)
+                    return AVERROR_INVALIDDATA;
+            } else {
+                ff_slice_thread_execute_with_mainfunc(avctx, decode_tiles_mt, loopfilter_proc, s->td, NULL, s->s.h.tiling.tile_cols);
+            }
         } else
 #endif
         {
@@ -1730,6 +1905,19 @@ static av_cold int vp9_decode_init(AVCodecContext *avctx)
     s->last_bpp = 0;
     s->s.h.filter.sharpness = -1;
 
+#if HAVE_THREADS
+    if (avctx->active_thread_type & FF_THREAD_SLICE) {
+        int ret;
+
+        if ((ret = pthread_mutex_init(&s->progress_mutex, NULL)))
+            return AVERROR(ret);
+        if ((ret = pthread_cond_init(&s->progress_cond, NULL))) {
+            pthread_mutex_destroy(&s->progress_mutex);
+            return AVERROR(ret);
+        }
+    }
+#endif
+
     return init_frames(avctx);
 }
 
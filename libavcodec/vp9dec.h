@@ -102,6 +102,10 @@ typedef struct VP9Context {
     pthread_mutex_t progress_mutex;
     pthread_cond_t progress_cond;
     atomic_int *entries;
+    // row multithreading: number of parsed sb rows and index of the first sb
+    // that could not be parsed
+    atomic_int rows_parsed;
+    atomic_int error_sb;
 #endif
 
     uint8_t ss_h, ss_v;
@@ -165,6 +169,7 @@ struct VP9TileData {
     ptrdiff_t y_stride, uv_stride;
     VP9Block *b_base, *b;
     unsigned tile_col_start;
+    int pass;
 
     struct {
         unsigned y_mode[4][10];
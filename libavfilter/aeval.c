@@ -275,9 +275,11 @@ static int request_frame(AVFilterLink *outlink)
 {
     EvalContext *eval = outlink->src->priv;
     AVFrame *samplesref;
-    int i, j;
+    int i, j, k, n;
     int64_t t = av_rescale(eval->n, AV_TIME_BASE, eval->sample_rate);
     int nb_samples;
+    double ns[64], ts[64];
+    const double *arrays[VAR_VARS_NB] = { [VAR_N] = ns, [VAR_T] = ts };
 
     if (eval->duration >= 0 && t >= eval->duration)
         return AVERROR_EOF;
@@ -293,14 +295,21 @@ static int request_frame(AVFilterLink *outlink)
     if (!samplesref)
         return AVERROR(ENOMEM);
 
-    /* evaluate expression for each single sample and for each channel */
-    for (i = 0; i < nb_samples; i++, eval->n++) {
-        eval->var_values[VAR_N] = eval->n;
-        eval->var_values[VAR_T] = eval->var_values[VAR_N] * (double)1/eval->sample_rate;
+    /* evaluate expression for each channel on blocks of samples */
+    for (i = 0; i < nb_samples; i += n, eval->n += n) {
+        n = FFMIN(nb_samples - i, FF_ARRAY_ELEMS(ns));
+        for (k = 0; k < n; k++) {
+            ns[k] = eval->n + k;
+            ts[k] = ns[k] * (double)1/eval->sample_rate;
+        }
 
         for (j = 0; j < eval->nb_channels; j++) {
-            *((double *) samplesref->extended_data[j] + i) =
-                av_expr_eval(eval->expr[j], eval->var_values, NULL);
+            int ret = av_expr_eval_batch(eval->expr[j], (double *)samplesref->extended_data[j] + i,
+                                         n, eval->var_values, arrays, NULL);
+            if (ret < 0) {
+                av_frame_free(&samplesref);
+                return ret;
+            }
         }
     }
 
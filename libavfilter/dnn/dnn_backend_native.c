@@ -25,6 +25,7 @@
 
 #include "dnn_backend_native.h"
 #include "libavutil/avassert.h"
+#include "dnn_backend_native_layer_conv2d.h"
 #include "dnn_backend_native_layer_pad.h"
 
 static DNNReturnType set_input_output_native(void *model, DNNInputData *input, const char *input_name, const char **output_names, uint32_t nb_output)
@@ -35,6 +36,7 @@ static DNNReturnType set_input_output_native(void *model, DNNInputData *input, c
     DepthToSpaceParams *depth_to_space_params;
     LayerPadParams *pad_params;
     int cur_width, cur_height, cur_channels;
+    int scratch_size = 0;
     int32_t layer;
 
     if (network->layers_num <= 0 || network->layers[0].type != INPUT){
@@ -63,6 +65,13 @@ static DNNReturnType set_input_output_native(void *model, DNNInputData *input, c
                 return DNN_ERROR;
             }
             cur_channels = conv_params->output_num;
+            scratch_size = FFMAX(scratch_size, dnn_layer_conv2d_scratch_size(conv_params));
+            if (!network->conv_kernels[layer]){
+                network->conv_kernels[layer] = dnn_prepare_layer_conv2d(conv_params);
+                if (!network->conv_kernels[layer]){
+                    return DNN_ERROR;
+                }
+            }
 
             if (conv_params->padding_method == VALID) {
                 int pad_size = (conv_params->kernel_size - 1) * conv_params->dilation;
@@ -101,9 +110,97 @@ static DNNReturnType set_input_output_native(void *model, DNNInputData *input, c
         }
     }
 
+    av_freep(&network->scratch);
+    network->scratch_size = scratch_size;
+    if (scratch_size) {
+        network->scratch = av_malloc_array(network->nb_threads, scratch_size * sizeof(float));
+        if (!network->scratch)
+            return DNN_ERROR;
+    }
+
     return DNN_SUCCESS;
 }
 
+static void depth_to_space(const float *input, float *output, int block_size, int width, int height, int channels)
+{
+    int y, x, by, bx, ch;
+    int new_channels = channels / (block_size * block_size);
+    int output_linesize = width * channels;
+    int by_linesize = output_linesize / block_size;
+    int x_linesize = new_channels * block_size;
+
+    for (y = 0; y < height; ++y){
+        for (x = 0; x < width; ++x){
+            for (by = 0; by < block_size; ++by){
+                for (bx = 0; bx < block_size; ++bx){
+                    for (ch = 0; ch < new_channels; ++ch){
+                        output[by * by_linesize + x * x_linesize + bx * new_channels + ch] = input[ch];
+                    }
+                    input += new_channels;
+                }
+            }
+        }
+        output += output_linesize;
+    }
+}
+
+static void execute_layer_slice(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ConvolutionalNetwork *network = priv;
+    const Layer *layer = &network->layers[network->cur_layer];
+    const float *input = network->layers[network->cur_layer - 1].output;
+    int width    = network->cur_width;
+    int height   = network->cur_height;
+    int channels = network->cur_channels;
+    ConvolutionalParams *conv_params;
+    DepthToSpaceParams *depth_to_space_params;
+    int rows, slice_start, slice_end;
+
+    switch (layer->type){
+    case CONV:
+        conv_params = layer->params;
+        rows = height;
+        if (conv_params->padding_method == VALID)
+            rows -= (conv_params->kernel_size - 1) / 2 * conv_params->dilation * 2;
+        slice_start = (rows *  jobnr     ) / nb_jobs;
+        slice_end   = (rows * (jobnr + 1)) / nb_jobs;
+        dnn_execute_layer_conv2d(input, layer->output, conv_params,
+                                 network->conv_kernels[network->cur_layer], width, height,
+                                 slice_start, slice_end,
+                                 network->scratch + threadnr * network->scratch_size,
+                                 network->fdsp);
+        break;
+    case DEPTH_TO_SPACE:
+        depth_to_space_params = layer->params;
+        slice_start = (height *  jobnr     ) / nb_jobs;
+        slice_end   = (height * (jobnr + 1)) / nb_jobs;
+        /* every input row produces block_size output rows of the same size */
+        depth_to_space(input + slice_start * width * channels,
+                       layer->output + slice_start * width * channels,
+                       depth_to_space_params->block_size, width,
+                       slice_end - slice_start, channels);
+        break;
+    default:
+        av_assert0(0);
+    }
+}
+
+static void execute_layer(ConvolutionalNetwork *network, int layer,
+                          int width, int height, int channels)
+{
+    int nb_jobs = FFMIN(height, network->nb_threads);
+
+    network->cur_layer    = layer;
+    network->cur_width    = width;
+    network->cur_height   = height;
+    network->cur_channels = channels;
+
+    if (network->slicethread && nb_jobs > 1)
+        avpriv_slicethread_execute(network->slicethread, nb_jobs, 0);
+    else
+        execute_layer_slice(network, 0, 0, 1, 1);
+}
+
 // Loads model and its parameters that are stored in a binary file with following structure:
 // layers_num,layer_type,layer_parameterss,layer_type,layer_parameters...
 // For CONV layer: activation_function, input_num, output_num, kernel_size, kernel, biases
@@ -131,7 +228,7 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
     }
     file_size = avio_size(model_file_context);
 
-    network = av_malloc(sizeof(ConvolutionalNetwork));
+    network = av_mallocz(sizeof(ConvolutionalNetwork));
     if (!network){
         avio_closep(&model_file_context);
         av_freep(&model);
@@ -154,6 +251,12 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
         network->layers[layer].output = NULL;
         network->layers[layer].params = NULL;
     }
+    network->conv_kernels = av_mallocz_array(network->layers_num, sizeof(*network->conv_kernels));
+    if (!network->conv_kernels){
+        avio_closep(&model_file_context);
+        ff_dnn_free_model_native(&model);
+        return NULL;
+    }
     network->layers[0].type = INPUT;
     network->layers[0].params = av_malloc(sizeof(InputParams));
     if (!network->layers[0].params){
@@ -247,89 +350,21 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
         return NULL;
     }
 
-    model->set_input_output = &set_input_output_native;
-
-    return model;
-}
-
-#define CLAMP_TO_EDGE(x, w) ((x) < 0 ? 0 : ((x) >= (w) ? (w - 1) : (x)))
-
-static void convolve(const float *input, float *output, const ConvolutionalParams *conv_params, int width, int height)
-{
-    int radius = conv_params->kernel_size >> 1;
-    int src_linesize = width * conv_params->input_num;
-    int filter_linesize = conv_params->kernel_size * conv_params->input_num;
-    int filter_size = conv_params->kernel_size * filter_linesize;
-    int pad_size = (conv_params->padding_method == VALID) ? (conv_params->kernel_size - 1) / 2 * conv_params->dilation : 0;
-
-    for (int y = pad_size; y < height - pad_size; ++y) {
-        for (int x = pad_size; x < width - pad_size; ++x) {
-            for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter) {
-                output[n_filter] = conv_params->biases[n_filter];
-
-                for (int ch = 0; ch < conv_params->input_num; ++ch) {
-                    for (int kernel_y = 0; kernel_y < conv_params->kernel_size; ++kernel_y) {
-                        for (int kernel_x = 0; kernel_x < conv_params->kernel_size; ++kernel_x) {
-                            float input_pel;
-                            if (conv_params->padding_method == SAME_CLAMP_TO_EDGE) {
-                                int y_pos = CLAMP_TO_EDGE(y + (kernel_y - radius) * conv_params->dilation, height);
-                                int x_pos = CLAMP_TO_EDGE(x + (kernel_x - radius) * conv_params->dilation, width);
-                                input_pel = input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
-                            } else {
-                                int y_pos = y + (kernel_y - radius) * conv_params->dilation;
-                                int x_pos = x + (kernel_x - radius) * conv_params->dilation;
-                                input_pel = (x_pos < 0 || x_pos >= width || y_pos < 0 || y_pos >= height) ? 0.0 :
-                                                   input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
-                            }
-
-
-                            output[n_filter] += input_pel * conv_params->kernel[n_filter * filter_size + kernel_y * filter_linesize +
-                                                                                kernel_x * conv_params->input_num + ch];
-                        }
-                    }
-                }
-                switch (conv_params->activation){
-                case RELU:
-                    output[n_filter] = FFMAX(output[n_filter], 0.0);
-                    break;
-                case TANH:
-                    output[n_filter] = 2.0f  / (1.0f + exp(-2.0f * output[n_filter])) - 1.0f;
-                    break;
-                case SIGMOID:
-                    output[n_filter] = 1.0f / (1.0f + exp(-output[n_filter]));
-                    break;
-                case NONE:
-                    break;
-                case LEAKY_RELU:
-                    output[n_filter] = FFMAX(output[n_filter], 0.0) + 0.2 * FFMIN(output[n_filter], 0.0);
-                }
-            }
-            output += conv_params->output_num;
-        }
+    network->fdsp = avpriv_float_dsp_alloc(0);
+    if (!network->fdsp){
+        ff_dnn_free_model_native(&model);
+        return NULL;
+    }
+    network->nb_threads = avpriv_slicethread_create(&network->slicethread, network,
+                                                    execute_layer_slice, NULL, 0);
+    if (network->nb_threads <= 1){
+        avpriv_slicethread_free(&network->slicethread);
+        network->nb_threads = 1;
     }
-}
 
-static void depth_to_space(const float *input, float *output, int block_size, int width, int height, int channels)
-{
-    int y, x, by, bx, ch;
-    int new_channels = channels / (block_size * block_size);
-    int output_linesize = width * channels;
-    int by_linesize = output_linesize / block_size;
-    int x_linesize = new_channels * block_size;
+    model->set_input_output = &set_input_output_native;
 
-    for (y = 0; y < height; ++y){
-        for (x = 0; x < width; ++x){
-            for (by = 0; by < block_size; ++by){
-                for (bx = 0; bx < block_size; ++bx){
-                    for (ch = 0; ch < new_channels; ++ch){
-                        output[by * by_linesize + x * x_linesize + bx * new_channels + ch] = input[ch];
-                    }
-                    input += new_channels;
-                }
-            }
-        }
-        output += output_linesize;
-    }
+    return model;
 }
 
 DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNData *outputs, uint32_t nb_output)
@@ -359,7 +394,7 @@ DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNData *output
         switch (network->layers[layer].type){
         case CONV:
             conv_params = (ConvolutionalParams *)network->layers[layer].params;
-            convolve(network->layers[layer - 1].output, network->layers[layer].output, conv_params, cur_width, cur_height);
+            execute_layer(network, layer, cur_width, cur_height, cur_channels);
             cur_channels = conv_params->output_num;
             if (conv_params->padding_method == VALID) {
                 int pad_size = (conv_params->kernel_size - 1) * conv_params->dilation;
@@ -369,8 +404,7 @@ DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNData *output
             break;
         case DEPTH_TO_SPACE:
             depth_to_space_params = (DepthToSpaceParams *)network->layers[layer].params;
-            depth_to_space(network->layers[layer - 1].output, network->layers[layer].output,
-                           depth_to_space_params->block_size, cur_width, cur_height, cur_channels);
+            execute_layer(network, layer, cur_width, cur_height, cur_channels);
             cur_height *= depth_to_space_params->block_size;
             cur_width *= depth_to_space_params->block_size;
             cur_channels /= depth_to_space_params->block_size * depth_to_space_params->block_size;
@@ -416,8 +450,14 @@ void ff_dnn_free_model_native(DNNModel **model)
                 av_freep(&conv_params->biases);
             }
             av_freep(&network->layers[layer].params);
+            if (network->conv_kernels)
+                av_freep(&network->conv_kernels[layer]);
         }
         av_freep(&network->layers);
+        av_freep(&network->conv_kernels);
+        avpriv_slicethread_free(&network->slicethread);
+        av_freep(&network->fdsp);
+        av_freep(&network->scratch);
         av_freep(&network);
         av_freep(model);
     }
@@ -29,6 +29,8 @@
 
 #include "../dnn_interface.h"
 #include "libavformat/avio.h"
+#include "libavutil/float_dsp.h"
+#include "libavutil/slicethread.h"
 
 typedef enum {INPUT, CONV, DEPTH_TO_SPACE, MIRROR_PAD} DNNLayerType;
 
@@ -63,6 +65,17 @@ typedef struct DepthToSpaceParams{
 typedef struct ConvolutionalNetwork{
     Layer *layers;
     int32_t layers_num;
+
+    AVSliceThread *slicethread; ///< NULL if layers are executed in the caller thread
+    int nb_threads;
+    AVFloatDSPContext *fdsp;
+    float **conv_kernels;       ///< reordered kernels of the conv layers, indexed by layer
+    float *scratch;             ///< per thread scratch memory for conv layers
+    int scratch_size;           ///< floats of scratch memory per thread
+
+    /* layer being executed by the slice threads */
+    int cur_layer;
+    int cur_width, cur_height, cur_channels;
 } ConvolutionalNetwork;
 
 DNNModel *ff_dnn_load_model_native(const char *model_filename);
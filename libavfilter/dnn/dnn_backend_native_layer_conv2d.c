@@ -0,0 +1,163 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "dnn_backend_native_layer_conv2d.h"
+
+#define CLAMP_TO_EDGE(x, w) ((x) < 0 ? 0 : ((x) >= (w) ? (w - 1) : (x)))
+
+float *dnn_prepare_layer_conv2d(const ConvolutionalParams *conv_params)
+{
+    int kernel_size = conv_params->kernel_size;
+    int input_num   = conv_params->input_num;
+    int output_num  = conv_params->output_num;
+    int filter_linesize = kernel_size * input_num;
+    int filter_size = kernel_size * filter_linesize;
+    float *kernel;
+    int n, ch, ky, kx;
+
+    kernel = av_malloc_array(filter_size * output_num, sizeof(*kernel));
+    if (!kernel)
+        return NULL;
+
+    /* taps are ordered by input channel first, as in the original direct
+     * convolution, so that every output is summed in the same order */
+    for (n = 0; n < output_num; n++)
+        for (ch = 0; ch < input_num; ch++)
+            for (ky = 0; ky < kernel_size; ky++)
+                for (kx = 0; kx < kernel_size; kx++) {
+                    int k = (ch * kernel_size + ky) * kernel_size + kx;
+                    kernel[k * output_num + n] =
+                        conv_params->kernel[n * filter_size + ky * filter_linesize + kx * input_num + ch];
+                }
+
+    return kernel;
+}
+
+int dnn_layer_conv2d_scratch_size(const ConvolutionalParams *conv_params)
+{
+    return conv_params->input_num * conv_params->kernel_size * conv_params->kernel_size;
+}
+
+static void vector_fmac_scalar_c(float *dst, const float *src, float mul, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        dst[i] += src[i] * mul;
+}
+
+static void im2col(float *col, const float *input, const ConvolutionalParams *conv_params,
+                   int x, int y, int width, int height)
+{
+    int kernel_size = conv_params->kernel_size;
+    int input_num   = conv_params->input_num;
+    int dilation    = conv_params->dilation;
+    int radius      = kernel_size >> 1;
+    int src_linesize = width * input_num;
+    int x0 = x - radius * dilation;
+    int y0 = y - radius * dilation;
+    int x1 = x0 + (kernel_size - 1) * dilation;
+    int y1 = y0 + (kernel_size - 1) * dilation;
+    int ch, ky, kx;
+
+    if (x0 >= 0 && y0 >= 0 && x1 < width && y1 < height) {
+        const float *src = input + y0 * src_linesize + x0 * input_num;
+
+        for (ch = 0; ch < input_num; ch++)
+            for (ky = 0; ky < kernel_size; ky++)
+                for (kx = 0; kx < kernel_size; kx++)
+                    *col++ = src[ky * dilation * src_linesize + kx * dilation * input_num + ch];
+        return;
+    }
+
+    for (ch = 0; ch < input_num; ch++) {
+        for (ky = 0; ky < kernel_size; ky++) {
+            for (kx = 0; kx < kernel_size; kx++) {
+                int y_pos = y0 + ky * dilation;
+                int x_pos = x0 + kx * dilation;
+
+                if (conv_params->padding_method == SAME_CLAMP_TO_EDGE) {
+                    y_pos = CLAMP_TO_EDGE(y_pos, height);
+                    x_pos = CLAMP_TO_EDGE(x_pos, width);
+                    *col++ = input[y_pos * src_linesize + x_pos * input_num + ch];
+                } else {
+                    *col++ = (x_pos < 0 || x_pos >= width || y_pos < 0 || y_pos >= height) ? 0.0 :
+                             input[y_pos * src_linesize + x_pos * input_num + ch];
+                }
+            }
+        }
+    }
+}
+
+static void activate(float *output, const ConvolutionalParams *conv_params)
+{
+    int n_filter;
+
+    for (n_filter = 0; n_filter < conv_params->output_num; ++n_filter) {
+        switch (conv_params->activation){
+        case RELU:
+            output[n_filter] = FFMAX(output[n_filter], 0.0);
+            break;
+        case TANH:
+            output[n_filter] = 2.0f  / (1.0f + exp(-2.0f * output[n_filter])) - 1.0f;
+            break;
+        case SIGMOID:
+            output[n_filter] = 1.0f / (1.0f + exp(-output[n_filter]));
+            break;
+        case NONE:
+            break;
+        case LEAKY_RELU:
+            output[n_filter] = FFMAX(output[n_filter], 0.0) + 0.2 * FFMIN(output[n_filter], 0.0);
+        }
+    }
+}
+
+void dnn_execute_layer_conv2d(const float *input, float *output,
+                              const ConvolutionalParams *conv_params, const float *kernel,
+                              int width, int height, int slice_start, int slice_end,
+                              float *scratch, AVFloatDSPContext *fdsp)
+{
+    int output_num = conv_params->output_num;
+    int taps = dnn_layer_conv2d_scratch_size(conv_params);
+    int pad_size = (conv_params->padding_method == VALID) ? (conv_params->kernel_size - 1) / 2 * conv_params->dilation : 0;
+    int out_width = width - 2 * pad_size;
+    void (*fmac)(float *dst, const float *src, float mul, int len) = vector_fmac_scalar_c;
+    int x, y, k;
+
+    /* output rows and kernel rows stay 32-byte aligned for the simd version */
+    if (fdsp && !(output_num & 15))
+        fmac = fdsp->vector_fmac_scalar;
+
+    output += slice_start * out_width * output_num;
+    for (y = slice_start + pad_size; y < slice_end + pad_size; ++y) {
+        for (x = pad_size; x < width - pad_size; ++x) {
+            im2col(scratch, input, conv_params, x, y, width, height);
+
+            memcpy(output, conv_params->biases, output_num * sizeof(*output));
+            for (k = 0; k < taps; k++)
+                fmac(output, kernel + k * output_num, scratch[k], output_num);
+            activate(output, conv_params);
+            output += output_num;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * layer conv2d for native backend.
+ */
+
+#ifndef AVFILTER_DNN_DNN_BACKEND_NATIVE_LAYER_CONV2D_H
+#define AVFILTER_DNN_DNN_BACKEND_NATIVE_LAYER_CONV2D_H
+
+#include "libavutil/float_dsp.h"
+
+#include "dnn_backend_native.h"
+
+/**
+ * Make a copy of the kernel of a layer, reordered from the model file layout
+ * (output channel, kernel row, kernel column, input channel) to the layout
+ * used by dnn_execute_layer_conv2d(), which stores the weights of all output
+ * channels for one input tap contiguously. conv_params->kernel is not changed.
+ *
+ * @return the reordered kernel, to be freed with av_free(), or NULL on failure
+ */
+float *dnn_prepare_layer_conv2d(const ConvolutionalParams *conv_params);
+
+/**
+ * Number of floats of scratch memory dnn_execute_layer_conv2d() needs.
+ */
+int dnn_layer_conv2d_scratch_size(const ConvolutionalParams *conv_params);
+
+/**
+ * Compute the output rows [slice_start, slice_end) of a convolution.
+ *
+ * Every output pixel is computed as a matrix product of its input patch
+ * (gathered into scratch) and the reordered kernel.
+ *
+ * @param kernel  kernel returned by dnn_prepare_layer_conv2d()
+ * @param width   input width
+ * @param height  input height
+ * @param scratch dnn_layer_conv2d_scratch_size() floats, not shared with
+ *                concurrent calls
+ */
+void dnn_execute_layer_conv2d(const float *input, float *output,
+                              const ConvolutionalParams *conv_params, const float *kernel,
+                              int width, int height, int slice_start, int slice_end,
+                              float *scratch, AVFloatDSPContext *fdsp);
+
+#endif
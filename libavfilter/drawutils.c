@@ -602,6 +602,17 @@ static void blend_line_hv(uint8_t *dst, int dst_delta,
 {
     int x;
 
+    /* full resolution plane and 8-bit mask: one mask value per pixel,
+     * written so that the compiler can vectorize it */
+    if (!hsub && !vsub && l2depth == 3) {
+        mask += xm;
+        for (x = 0; x < w; x++) {
+            unsigned a = mask[x] * alpha;
+            dst[x * dst_delta] = ((0x1010101 - a) * dst[x * dst_delta] + a * src) >> 24;
+        }
+        return;
+    }
+
     if (left) {
         blend_pixel(dst, src, alpha, mask, mask_linesize, l2depth,
                     left, hband, hsub + vsub, xm);
@@ -0,0 +1,304 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Partitioned FFT convolution
+ */
+
+#include <string.h>
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+
+#include "partconv.h"
+
+static void fcmul_add_c(float *sum, const float *t, const float *c, ptrdiff_t len)
+{
+    int n;
+
+    for (n = 0; n < len; n++) {
+        const float cre = c[2 * n    ];
+        const float cim = c[2 * n + 1];
+        const float tre = t[2 * n    ];
+        const float tim = t[2 * n + 1];
+
+        sum[2 * n    ] += tre * cre - tim * cim;
+        sum[2 * n + 1] += tre * cim + tim * cre;
+    }
+
+    sum[2 * n] += t[2 * n] * c[2 * n];
+}
+
+av_cold void ff_afir_init(AudioFIRDSPContext *dsp)
+{
+    dsp->fcmul_add = fcmul_add_c;
+
+    if (ARCH_X86)
+        ff_afir_init_x86(dsp);
+}
+
+static av_cold int init_segment(FFPartConvContext *s, PartConvSegment *seg,
+                                int offset, int nb_partitions, int part_size)
+{
+    seg->rdft  = av_calloc(s->nb_channels, sizeof(*seg->rdft));
+    seg->irdft = av_calloc(s->nb_channels, sizeof(*seg->irdft));
+    if (!seg->rdft || !seg->irdft)
+        return AVERROR(ENOMEM);
+
+    seg->fft_length    = part_size * 2 + 1;
+    seg->part_size     = part_size;
+    seg->block_size    = FFALIGN(seg->fft_length, 32);
+    seg->coeff_size    = FFALIGN(seg->part_size + 1, 32);
+    seg->nb_partitions = nb_partitions;
+    seg->input_size    = offset + s->min_part_size;
+    seg->input_offset  = offset;
+    /* room for sliding the input window, so that it only has to be
+     * moved back once per input_size samples instead of every quantum */
+    seg->input_stride  = FFALIGN(2 * seg->input_size, 32);
+
+    seg->part_index    = av_calloc(s->nb_channels, sizeof(*seg->part_index));
+    seg->output_offset = av_calloc(s->nb_channels, sizeof(*seg->output_offset));
+    seg->input_pos     = av_calloc(s->nb_channels, sizeof(*seg->input_pos));
+    if (!seg->part_index || !seg->output_offset || !seg->input_pos)
+        return AVERROR(ENOMEM);
+
+    for (int ch = 0; ch < s->nb_channels; ch++) {
+        seg->rdft[ch]  = av_rdft_init(av_log2(2 * part_size), DFT_R2C);
+        seg->irdft[ch] = av_rdft_init(av_log2(2 * part_size), IDFT_C2R);
+        if (!seg->rdft[ch] || !seg->irdft[ch])
+            return AVERROR(ENOMEM);
+    }
+
+    seg->sum    = av_calloc(s->nb_channels, seg->block_size * sizeof(*seg->sum));
+    seg->block  = av_calloc(s->nb_channels, seg->nb_partitions * seg->block_size * sizeof(*seg->block));
+    seg->buffer = av_calloc(s->nb_channels, seg->part_size * sizeof(*seg->buffer));
+    seg->coeff  = av_calloc(s->nb_coeff_channels, seg->nb_partitions * seg->coeff_size * 2 * sizeof(*seg->coeff));
+    seg->input  = av_calloc(s->nb_channels, seg->input_stride * sizeof(*seg->input));
+    seg->output = av_calloc(s->nb_channels, seg->part_size * sizeof(*seg->output));
+    if (!seg->buffer || !seg->sum || !seg->block || !seg->coeff || !seg->input || !seg->output)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+av_cold int ff_partconv_init(FFPartConvContext *s, int nb_channels, int nb_coeff_channels,
+                             int nb_taps, int min_part_size, int max_part_size)
+{
+    int left, offset = 0, part_size;
+    int ret, i;
+
+    if (nb_channels <= 0 || nb_coeff_channels <= 0 || nb_taps <= 0 || min_part_size < 4)
+        return AVERROR(EINVAL);
+
+    s->nb_channels       = nb_channels;
+    s->nb_coeff_channels = nb_coeff_channels;
+    s->nb_taps           = nb_taps;
+
+    part_size     = 1 << av_log2(min_part_size);
+    max_part_size = 1 << av_log2(FFMAX(max_part_size, min_part_size));
+
+    s->min_part_size = part_size;
+
+    left = nb_taps;
+    for (i = 0; left > 0; i++) {
+        int step = part_size == max_part_size ? INT_MAX : 1 + (i == 0);
+        int nb_partitions = FFMIN(step, (left + part_size - 1) / part_size);
+
+        if (i >= FF_PARTCONV_MAX_SEGMENTS)
+            return AVERROR_BUG;
+
+        s->nb_segments = i + 1;
+        ret = init_segment(s, &s->seg[i], offset, nb_partitions, part_size);
+        if (ret < 0)
+            return ret;
+        offset += nb_partitions * part_size;
+        left -= nb_partitions * part_size;
+        part_size *= 2;
+        part_size = FFMIN(part_size, max_part_size);
+    }
+
+    s->fdsp = avpriv_float_dsp_alloc(0);
+    if (!s->fdsp)
+        return AVERROR(ENOMEM);
+
+    ff_afir_init(&s->dsp);
+
+    return 0;
+}
+
+void ff_partconv_set_coeffs(FFPartConvContext *s, int ch, const float *coeffs)
+{
+    int toffset = 0;
+
+    for (int segment = 0; segment < s->nb_segments; segment++) {
+        PartConvSegment *seg = &s->seg[segment];
+        /* the sum buffer of the first channel is cleared before each use */
+        float *block = seg->sum;
+        FFTComplex *coeff = (FFTComplex *)seg->coeff + ch * seg->nb_partitions * seg->coeff_size;
+
+        for (int i = 0; i < seg->nb_partitions; i++) {
+            const float scale = 1.f / seg->part_size;
+            const int coffset = i * seg->coeff_size;
+            const int remaining = s->nb_taps - toffset;
+            const int size = remaining >= seg->part_size ? seg->part_size : remaining;
+
+            memset(block, 0, sizeof(*block) * seg->fft_length);
+            memcpy(block, coeffs + toffset, size * sizeof(*block));
+
+            av_rdft_calc(seg->rdft[0], block);
+
+            coeff[coffset].re = block[0] * scale;
+            coeff[coffset].im = 0;
+            for (int n = 1; n < seg->part_size; n++) {
+                coeff[coffset + n].re = block[2 * n] * scale;
+                coeff[coffset + n].im = block[2 * n + 1] * scale;
+            }
+            coeff[coffset + seg->part_size].re = block[1] * scale;
+            coeff[coffset + seg->part_size].im = 0;
+
+            toffset += size;
+        }
+    }
+}
+
+static void advance_input(FFPartConvContext *s, PartConvSegment *seg, int ch)
+{
+    float *input = seg->input + ch * seg->input_stride;
+
+    seg->input_pos[ch] += s->min_part_size;
+    if (seg->input_pos[ch] + seg->input_size > seg->input_stride) {
+        memmove(input, input + seg->input_pos[ch],
+                (seg->input_size - s->min_part_size) * sizeof(*input));
+        seg->input_pos[ch] = 0;
+    }
+}
+
+void ff_partconv_filter(FFPartConvContext *s, int ch, float *dst, const float *src,
+                        float gain, int nb_samples)
+{
+    const int cch = s->nb_coeff_channels > 1 ? ch : 0;
+    int n, i, j;
+
+    for (int segment = 0; segment < s->nb_segments; segment++) {
+        PartConvSegment *seg = &s->seg[segment];
+        float *input = seg->input + ch * seg->input_stride + seg->input_pos[ch];
+        float *out = seg->output + ch * seg->part_size;
+        float *sum = seg->sum + ch * seg->block_size;
+        float *blocks = seg->block + ch * seg->nb_partitions * seg->block_size;
+        const FFTComplex *coeffs = (const FFTComplex *)seg->coeff + cch * seg->nb_partitions * seg->coeff_size;
+        float *block, *buf;
+
+        s->fdsp->vector_fmul_scalar(input + seg->input_offset, src, gain, FFALIGN(nb_samples, 4));
+
+        seg->output_offset[ch] += s->min_part_size;
+        if (seg->output_offset[ch] == seg->part_size) {
+            seg->output_offset[ch] = 0;
+        } else {
+            advance_input(s, seg, ch);
+
+            out += seg->output_offset[ch];
+            for (n = 0; n < nb_samples; n++) {
+                dst[n] += out[n];
+            }
+            continue;
+        }
+
+        memset(sum, 0, sizeof(*sum) * seg->fft_length);
+        block = blocks + seg->part_index[ch] * seg->block_size;
+        memset(block + seg->part_size, 0, sizeof(*block) * (seg->fft_length - seg->part_size));
+
+        memcpy(block, input, sizeof(*input) * seg->part_size);
+
+        av_rdft_calc(seg->rdft[ch], block);
+        block[2 * seg->part_size] = block[1];
+        block[1] = 0;
+
+        j = seg->part_index[ch];
+
+        for (i = 0; i < seg->nb_partitions; i++) {
+            const FFTComplex *coeff = coeffs + j * seg->coeff_size;
+
+            s->dsp.fcmul_add(sum, blocks + i * seg->block_size, (const float *)coeff, seg->part_size);
+
+            if (j == 0)
+                j = seg->nb_partitions;
+            j--;
+        }
+
+        sum[1] = sum[2 * seg->part_size];
+        av_rdft_calc(seg->irdft[ch], sum);
+
+        buf = seg->buffer + ch * seg->part_size;
+        for (n = 0; n < seg->part_size; n++) {
+            buf[n] += sum[n];
+        }
+
+        memcpy(out, buf, seg->part_size * sizeof(*out));
+        memcpy(buf, sum + seg->part_size, seg->part_size * sizeof(*buf));
+
+        seg->part_index[ch] = (seg->part_index[ch] + 1) % seg->nb_partitions;
+
+        advance_input(s, seg, ch);
+
+        for (n = 0; n < nb_samples; n++) {
+            dst[n] += out[n];
+        }
+    }
+}
+
+static av_cold void uninit_segment(FFPartConvContext *s, PartConvSegment *seg)
+{
+    if (seg->rdft) {
+        for (int ch = 0; ch < s->nb_channels; ch++) {
+            av_rdft_end(seg->rdft[ch]);
+        }
+    }
+    av_freep(&seg->rdft);
+
+    if (seg->irdft) {
+        for (int ch = 0; ch < s->nb_channels; ch++) {
+            av_rdft_end(seg->irdft[ch]);
+        }
+    }
+    av_freep(&seg->irdft);
+
+    av_freep(&seg->output_offset);
+    av_freep(&seg->part_index);
+    av_freep(&seg->input_pos);
+
+    av_freep(&seg->block);
+    av_freep(&seg->sum);
+    av_freep(&seg->buffer);
+    av_freep(&seg->coeff);
+    av_freep(&seg->input);
+    av_freep(&seg->output);
+}
+
+av_cold void ff_partconv_uninit(FFPartConvContext *s)
+{
+    for (int i = 0; i < s->nb_segments; i++) {
+        uninit_segment(s, &s->seg[i]);
+    }
+    s->nb_segments = 0;
+
+    av_freep(&s->fdsp);
+}
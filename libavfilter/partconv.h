@@ -0,0 +1,112 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_PARTCONV_H
+#define AVFILTER_PARTCONV_H
+
+#include <stddef.h>
+
+#include "libavutil/float_dsp.h"
+#include "libavcodec/avfft.h"
+
+#define FF_PARTCONV_MAX_SEGMENTS 32
+
+typedef struct AudioFIRDSPContext {
+    void (*fcmul_add)(float *sum, const float *t, const float *c,
+                      ptrdiff_t len);
+} AudioFIRDSPContext;
+
+/**
+ * A run of partitions of equal size.
+ */
+typedef struct PartConvSegment {
+    int nb_partitions;
+    int part_size;
+    int block_size;
+    int fft_length;
+    int coeff_size;
+    int input_size;
+    int input_offset;
+    int input_stride;
+
+    int *output_offset;
+    int *part_index;
+    int *input_pos;
+
+    float *sum;
+    float *block;
+    float *buffer;
+    float *coeff;
+    float *input;
+    float *output;
+
+    RDFTContext **rdft, **irdft;
+} PartConvSegment;
+
+/**
+ * Non-uniformly partitioned FFT convolution of several channels.
+ *
+ * The impulse response is split in segments of equally sized partitions.
+ * The first partitions are min_part_size long so the output has no added
+ * latency, later ones double in size up to max_part_size to reduce the
+ * number of transforms and complex multiplications per sample.
+ * Input is consumed in quanta of min_part_size samples, channels can be
+ * processed concurrently.
+ */
+typedef struct FFPartConvContext {
+    int nb_channels;
+    int nb_coeff_channels;      ///< 1 if all channels share the same impulse response
+    int nb_taps;
+    int min_part_size;
+
+    PartConvSegment seg[FF_PARTCONV_MAX_SEGMENTS];
+    int nb_segments;
+
+    AudioFIRDSPContext dsp;
+    AVFloatDSPContext *fdsp;
+} FFPartConvContext;
+
+/**
+ * Set up the partitions for an impulse response of nb_taps samples.
+ * Partition sizes are rounded down to powers of two. On failure the
+ * context must still be freed with ff_partconv_uninit().
+ */
+int ff_partconv_init(FFPartConvContext *s, int nb_channels, int nb_coeff_channels,
+                     int nb_taps, int min_part_size, int max_part_size);
+
+/**
+ * Load the nb_taps samples long impulse response of coefficient channel ch.
+ */
+void ff_partconv_set_coeffs(FFPartConvContext *s, int ch, const float *coeffs);
+
+/**
+ * Filter one quantum of channel ch and add the result to dst.
+ *
+ * @param src        input samples, 32-byte aligned, readable up to a multiple of 4
+ * @param gain       gain applied to the input
+ * @param nb_samples number of samples, at most min_part_size
+ */
+void ff_partconv_filter(FFPartConvContext *s, int ch, float *dst, const float *src,
+                        float gain, int nb_samples);
+
+void ff_partconv_uninit(FFPartConvContext *s);
+
+void ff_afir_init(AudioFIRDSPContext *s);
+void ff_afir_init_x86(AudioFIRDSPContext *s);
+
+#endif /* AVFILTER_PARTCONV_H */
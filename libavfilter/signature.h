@@ -104,6 +104,7 @@ typedef struct StreamContext {
     /* needed for xml_export */
     int w; /* height */
     int h; /* width */
+    int colstart[33]; /* first column of every block column */
 
     /* overflow protection */
     int divide;
@@ -124,6 +125,30 @@ typedef struct StreamContext {
     int exported; /* boolean whether stream already exported */
 } StreamContext;
 
+/* coarse signature index */
+#define INDEX_HASHES 32
+#define INDEX_BAND_ROWS 2
+#define INDEX_BANDS (INDEX_HASHES / INDEX_BAND_ROWS)
+#define INDEX_BUCKET_BITS 16
+
+typedef struct IndexEntry {
+    int video; /* index of the name of the reference video */
+    int64_t start; /* in AV_TIME_BASE units */
+    int64_t end;
+    uint8_t data[5][31];
+    int next[INDEX_BANDS]; /* next entry in the same bucket, -1 at the end */
+} IndexEntry;
+
+typedef struct SignatureIndex {
+    char **names;
+    int nb_names;
+    IndexEntry *entries;
+    int nb_entries;
+    int *buckets; /* first entry of every bucket, one table per band */
+    unsigned *visited; /* last query which visited an entry */
+    unsigned query;
+} SignatureIndex;
+
 typedef struct SignatureContext {
     const AVClass *class;
     /* input parameters */
@@ -135,11 +160,16 @@ typedef struct SignatureContext {
     int thcomposdist;
     int thl1;
     int thdi;
-    int thit;
+    double thit;
+    char *index_filename;
+    int index_add;
+    char *index_name;
+    double thindex;
     /* end input parameters */
 
     uint8_t l1distlut[243*242/2]; /* 243 + 242 + 241 ... */
     StreamContext* streamcontexts;
+    SignatureIndex index;
 } SignatureContext;
 
 
@@ -0,0 +1,351 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * MPEG-7 video signature coarse signature index
+ *
+ * The index file stores the coarse signatures of reference videos. Every
+ * coarse signature is hashed with MinHash over the words of its 5 bags, and
+ * the hashes are grouped into bands (locality sensitive hashing). Only the
+ * signatures sharing a bucket with the query in at least one band are
+ * compared, so the cost of a lookup does not grow with the number of
+ * unrelated reference videos.
+ *
+ * File layout, all numbers little endian:
+ *   header:  "FSIX", version (32 bit)
+ *   video:   'V', name length (16 bit), name
+ *   segment: 'S', start, end (64 bit, in AV_TIME_BASE units), 5 * 31 bytes
+ *            of words; segments belong to the last video record
+ */
+
+#include "libavutil/intreadwrite.h"
+#include "signature.h"
+
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE 8
+#define INDEX_SEGMENT_SIZE (1 + 8 + 8 + 5 * 31)
+
+static uint32_t index_hash(uint32_t elem, int k)
+{
+    uint64_t h = (elem + 1) * UINT64_C(0x9E3779B97F4A7C15) ^
+                 (k    + 1) * UINT64_C(0xC2B2AE3D27D4EB4F);
+
+    h ^= h >> 29;
+    h *= UINT64_C(0xBF58476D1CE4E5B9);
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * calculates the bucket of a coarse signature in every band
+ */
+static void index_keys(const uint8_t data[5][31], uint32_t keys[INDEX_BANDS])
+{
+    uint32_t minhash[INDEX_HASHES];
+    int i, j, k;
+
+    for (k = 0; k < INDEX_HASHES; k++)
+        minhash[k] = UINT32_MAX;
+
+    for (i = 0; i < 5; i++) {
+        for (j = 0; j < 243; j++) {
+            if (!(data[i][j >> 3] & (0x80 >> (j & 7))))
+                continue;
+            for (k = 0; k < INDEX_HASHES; k++)
+                minhash[k] = FFMIN(minhash[k], index_hash(i * 243 + j, k));
+        }
+    }
+
+    for (i = 0; i < INDEX_BANDS; i++) {
+        uint64_t h = i;
+        for (k = 0; k < INDEX_BAND_ROWS; k++)
+            h = (h ^ minhash[i * INDEX_BAND_ROWS + k]) * UINT64_C(0x100000001B3);
+        keys[i] = (h ^ (h >> 32)) & ((1 << INDEX_BUCKET_BITS) - 1);
+    }
+}
+
+/**
+ * mean jaccard similarity of the 5 bags of words
+ */
+static double index_similarity(const uint8_t first[5][31], const uint8_t second[5][31])
+{
+    double sim = 0;
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        unsigned int u = union_word(first[i], second[i]);
+        if (u)
+            sim += (double) intersection_word(first[i], second[i]) / u;
+    }
+    return sim / 5;
+}
+
+static int index_add_entry(SignatureIndex *idx, const uint8_t *rec)
+{
+    IndexEntry *entries, *e;
+
+    if (!(idx->nb_entries & (idx->nb_entries - 1))) {
+        entries = av_realloc_array(idx->entries, FFMAX(2 * idx->nb_entries, 1), sizeof(*entries));
+        if (!entries)
+            return AVERROR(ENOMEM);
+        idx->entries = entries;
+    }
+    e = &idx->entries[idx->nb_entries++];
+    e->video = idx->nb_names - 1;
+    e->start = AV_RL64(rec + 1);
+    e->end   = AV_RL64(rec + 9);
+    memcpy(e->data, rec + 17, sizeof(e->data));
+    return 0;
+}
+
+/**
+ * reads an index file and builds the buckets; a missing file is an empty index
+ */
+static int index_load(AVFilterContext *ctx, SignatureIndex *idx, const char *filename)
+{
+    uint8_t *buf = NULL;
+    int64_t size;
+    int i, b, pos, ret = AVERROR_INVALIDDATA;
+    FILE *f;
+
+    f = fopen(filename, "rb");
+    if (!f)
+        return 0;
+
+    if (fseek(f, 0, SEEK_END) < 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) < 0 ||
+        size > INT_MAX) {
+        ret = AVERROR(EIO);
+        goto end;
+    }
+    if (!size) {
+        ret = 0;
+        goto end;
+    }
+    buf = av_malloc(size);
+    if (!buf) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if (fread(buf, 1, size, f) != size) {
+        ret = AVERROR(EIO);
+        goto end;
+    }
+    if (size < INDEX_HEADER_SIZE || AV_RL32(buf) != MKTAG('F','S','I','X') ||
+        AV_RL32(buf + 4) != INDEX_VERSION)
+        goto end;
+
+    for (pos = INDEX_HEADER_SIZE; pos < size;) {
+        if (buf[pos] == 'V' && pos + 3 <= size) {
+            int len = AV_RL16(buf + pos + 1);
+            char *name;
+
+            if (pos + 3 + len > size)
+                goto end;
+            name = av_strndup(buf + pos + 3, len);
+            if (!name) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            if ((ret = av_dynarray_add_nofree(&idx->names, &idx->nb_names, name)) < 0) {
+                av_free(name);
+                goto end;
+            }
+            ret = AVERROR_INVALIDDATA;
+            pos += 3 + len;
+        } else if (buf[pos] == 'S' && pos + INDEX_SEGMENT_SIZE <= size && idx->nb_names) {
+            if ((ret = index_add_entry(idx, buf + pos)) < 0)
+                goto end;
+            ret = AVERROR_INVALIDDATA;
+            pos += INDEX_SEGMENT_SIZE;
+        } else {
+            goto end;
+        }
+    }
+
+    idx->buckets = av_malloc_array(INDEX_BANDS << INDEX_BUCKET_BITS, sizeof(*idx->buckets));
+    idx->visited = av_calloc(FFMAX(idx->nb_entries, 1), sizeof(*idx->visited));
+    if (!idx->buckets || !idx->visited) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    memset(idx->buckets, 0xFF, (INDEX_BANDS << INDEX_BUCKET_BITS) * sizeof(*idx->buckets));
+
+    for (i = 0; i < idx->nb_entries; i++) {
+        IndexEntry *e = &idx->entries[i];
+        uint32_t keys[INDEX_BANDS];
+
+        index_keys(e->data, keys);
+        for (b = 0; b < INDEX_BANDS; b++) {
+            int *bucket = &idx->buckets[(b << INDEX_BUCKET_BITS) + keys[b]];
+            e->next[b] = *bucket;
+            *bucket = i;
+        }
+    }
+
+    av_log(ctx, AV_LOG_VERBOSE, "loaded %d segments of %d videos from index %s\n",
+           idx->nb_entries, idx->nb_names, filename);
+    ret = 0;
+
+end:
+    if (ret < 0)
+        av_log(ctx, AV_LOG_ERROR, "cannot read index file %s\n", filename);
+    av_free(buf);
+    fclose(f);
+    return ret;
+}
+
+static void index_free(SignatureIndex *idx)
+{
+    int i;
+
+    for (i = 0; i < idx->nb_names; i++)
+        av_freep(&idx->names[i]);
+    av_freep(&idx->names);
+    av_freep(&idx->entries);
+    av_freep(&idx->buckets);
+    av_freep(&idx->visited);
+    idx->nb_names = idx->nb_entries = 0;
+}
+
+/**
+ * looks up the coarse signatures of a stream in the index and reports the
+ * matching reference videos
+ */
+static int index_lookup(AVFilterContext *ctx, SignatureContext *sic, StreamContext *sc, int input)
+{
+    SignatureIndex *idx = &sic->index;
+    CoarseSignature *cs;
+    struct {
+        int segments;
+        unsigned last;
+        double sim;
+        int64_t first;
+        int64_t ref;
+    } *hits;
+    int i, b, nb_segments = 0, matched = 0;
+
+    hits = av_calloc(FFMAX(idx->nb_names, 1), sizeof(*hits));
+    if (!hits)
+        return AVERROR(ENOMEM);
+
+    for (cs = sc->coarsesiglist; cs && idx->buckets; cs = cs->next) {
+        uint32_t keys[INDEX_BANDS];
+
+        if (!cs->first)
+            continue;
+        nb_segments++;
+        idx->query++;
+
+        index_keys(cs->data, keys);
+        for (b = 0; b < INDEX_BANDS; b++) {
+            for (i = idx->buckets[(b << INDEX_BUCKET_BITS) + keys[b]]; i >= 0; i = idx->entries[i].next[b]) {
+                IndexEntry *e = &idx->entries[i];
+                double sim;
+
+                if (idx->visited[i] == idx->query)
+                    continue;
+                idx->visited[i] = idx->query;
+
+                sim = index_similarity(cs->data, e->data);
+                if (sim < sic->thindex)
+                    continue;
+                /* count every segment of the stream once per video */
+                if (hits[e->video].last != idx->query) {
+                    hits[e->video].last = idx->query;
+                    hits[e->video].segments++;
+                }
+                if (sim > hits[e->video].sim) {
+                    hits[e->video].sim   = sim;
+                    hits[e->video].first = av_rescale_q(cs->first->pts, sc->time_base, AV_TIME_BASE_Q);
+                    hits[e->video].ref   = e->start;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < idx->nb_names; i++) {
+        if (!hits[i].segments)
+            continue;
+        av_log(ctx, AV_LOG_INFO, "index matching of video %d at %f and %s at %f, %d of %d segments matching\n",
+               input, hits[i].first / (double) AV_TIME_BASE,
+               idx->names[i], hits[i].ref / (double) AV_TIME_BASE,
+               hits[i].segments, nb_segments);
+        matched = 1;
+    }
+    if (!matched)
+        av_log(ctx, AV_LOG_INFO, "no index matching of video %d\n", input);
+
+    av_free(hits);
+    return 0;
+}
+
+/**
+ * appends the coarse signatures of a stream to the index file
+ */
+static int index_append(AVFilterContext *ctx, StreamContext *sc, const char *filename, const char *name)
+{
+    uint8_t rec[FFMAX(INDEX_SEGMENT_SIZE, INDEX_HEADER_SIZE)];
+    CoarseSignature *cs;
+    size_t len = strlen(name);
+    int err = 0;
+    FILE *f;
+
+    if (len > UINT16_MAX)
+        return AVERROR(EINVAL);
+
+    f = fopen(filename, "ab");
+    if (!f) {
+        char buf[128];
+        err = AVERROR(errno);
+        av_strerror(err, buf, sizeof(buf));
+        av_log(ctx, AV_LOG_ERROR, "cannot open index file %s: %s\n", filename, buf);
+        return err;
+    }
+
+    if (fseek(f, 0, SEEK_END) < 0) {
+        err = AVERROR(EIO);
+        goto end;
+    }
+    if (!ftell(f)) {
+        AV_WL32(rec, MKTAG('F','S','I','X'));
+        AV_WL32(rec + 4, INDEX_VERSION);
+        fwrite(rec, 1, INDEX_HEADER_SIZE, f);
+    }
+
+    rec[0] = 'V';
+    AV_WL16(rec + 1, len);
+    fwrite(rec, 1, 3, f);
+    fwrite(name, 1, len, f);
+
+    for (cs = sc->coarsesiglist; cs; cs = cs->next) {
+        if (!cs->first)
+            continue;
+        rec[0] = 'S';
+        AV_WL64(rec + 1, av_rescale_q(cs->first->pts, sc->time_base, AV_TIME_BASE_Q));
+        AV_WL64(rec + 9, av_rescale_q(cs->last->pts,  sc->time_base, AV_TIME_BASE_Q));
+        memcpy(rec + 17, cs->data, 5 * 31);
+        fwrite(rec, 1, INDEX_SEGMENT_SIZE, f);
+    }
+
+    if (ferror(f))
+        err = AVERROR(EIO);
+end:
+    fclose(f);
+    return err;
+}
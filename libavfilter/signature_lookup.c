@@ -544,6 +544,7 @@ static MatchingInfo lookup_signatures(AVFilterContext *ctx, SignatureContext *sc
     bestmatch.score = 0;
     bestmatch.meandist = 99999;
     bestmatch.whole = 0;
+    bestmatch.first = bestmatch.second = NULL;
 
     fill_l1distlut(sc->l1distlut);
 
@@ -568,10 +569,11 @@ static MatchingInfo lookup_signatures(AVFilterContext *ctx, SignatureContext *sc
         av_log(ctx, AV_LOG_DEBUG, "Stage 3: evaluate\n");
         if (infos) {
             bestmatch = evaluate_parameters(ctx, sc, infos, bestmatch, mode);
-            av_log(ctx, AV_LOG_DEBUG, "Stage 3: best matching pair at %"PRIu32" and %"PRIu32", "
-                   "ratio %f, offset %d, score %d, %d frames matching\n",
-                   bestmatch.first->index, bestmatch.second->index,
-                   bestmatch.framerateratio, bestmatch.offset, bestmatch.score, bestmatch.matchframes);
+            if (bestmatch.score)
+                av_log(ctx, AV_LOG_DEBUG, "Stage 3: best matching pair at %"PRIu32" and %"PRIu32", "
+                       "ratio %f, offset %d, score %d, %d frames matching\n",
+                       bestmatch.first->index, bestmatch.second->index,
+                       bestmatch.framerateratio, bestmatch.offset, bestmatch.score, bestmatch.matchframes);
             sll_free(infos);
         }
     } while (find_next_coarsecandidate(sc, second->coarsesiglist, &cs, &cs2, 0) && !bestmatch.whole);
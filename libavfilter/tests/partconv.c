@@ -0,0 +1,217 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "libavfilter/partconv.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define NB_SAMPLES 20000
+
+static void help(void)
+{
+    av_log(NULL, AV_LOG_INFO,
+           "usage: partconv [-h] [-s] [-c channels] [-t taps] [-p minp] [-P maxp]\n"
+           "-h       print this help\n"
+           "-s       speed test\n"
+           "-c n     number of channels for the speed test\n"
+           "-t n     number of taps for the speed test\n"
+           "-p n     minimum partition size for the speed test\n"
+           "-P n     maximum partition size for the speed test\n");
+}
+
+static void fill_random(AVLFG *lfg, float *dst, int len)
+{
+    for (int i = 0; i < len; i++)
+        dst[i] = av_lfg_get(lfg) / (double)UINT32_MAX - 0.5;
+}
+
+/* compare against direct convolution */
+static int check(AVLFG *lfg, int nb_channels, int nb_coeff_channels,
+                 int nb_taps, int minp, int maxp)
+{
+    FFPartConvContext s = { 0 };
+    float *ir = NULL, *src = NULL, *dst = NULL;
+    double max_err = 0;
+    int ret, ch, n, k;
+
+    ir  = av_malloc_array(nb_coeff_channels * nb_taps, sizeof(*ir));
+    src = av_malloc_array(nb_channels * NB_SAMPLES + 32, sizeof(*src));
+    dst = av_calloc(nb_channels * NB_SAMPLES + 32, sizeof(*dst));
+    if (!ir || !src || !dst) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = ff_partconv_init(&s, nb_channels, nb_coeff_channels, nb_taps, minp, maxp);
+    if (ret < 0)
+        goto end;
+
+    fill_random(lfg, ir, nb_coeff_channels * nb_taps);
+    fill_random(lfg, src, nb_channels * NB_SAMPLES + 32);
+    for (ch = 0; ch < nb_coeff_channels; ch++)
+        ff_partconv_set_coeffs(&s, ch, ir + ch * nb_taps);
+
+    for (ch = 0; ch < nb_channels; ch++)
+        for (n = 0; n < NB_SAMPLES; n += s.min_part_size)
+            ff_partconv_filter(&s, ch, dst + ch * NB_SAMPLES + n, src + ch * NB_SAMPLES + n,
+                               1.f, FFMIN(s.min_part_size, NB_SAMPLES - n));
+
+    for (ch = 0; ch < nb_channels; ch++) {
+        const float *h = ir + (nb_coeff_channels > 1 ? ch : 0) * nb_taps;
+        const float *x = src + ch * NB_SAMPLES;
+
+        for (n = 0; n < NB_SAMPLES; n++) {
+            double ref = 0;
+
+            for (k = 0; k < FFMIN(n + 1, nb_taps); k++)
+                ref += h[k] * x[n - k];
+            max_err = FFMAX(max_err, fabs(ref - dst[ch * NB_SAMPLES + n]));
+        }
+    }
+
+    printf("channels %d/%d taps %6d partitions %4d-%5d segments %2d: %s\n",
+           nb_channels, nb_coeff_channels, nb_taps, minp, maxp, s.nb_segments,
+           max_err < 1e-3 ? "OK" : "FAIL");
+    if (max_err >= 1e-3)
+        ret = AVERROR_BUG;
+
+end:
+    ff_partconv_uninit(&s);
+    av_free(ir);
+    av_free(src);
+    av_free(dst);
+    return ret;
+}
+
+static int speed_test(AVLFG *lfg, int nb_channels, int nb_taps, int minp, int maxp)
+{
+    FFPartConvContext s = { 0 };
+    int64_t time_start, duration;
+    float *ir = NULL, *src = NULL, *dst = NULL;
+    int nb_its, it, ch, ret;
+
+    ret = ff_partconv_init(&s, nb_channels, 1, nb_taps, minp, maxp);
+    if (ret < 0)
+        goto end;
+
+    ir  = av_malloc_array(nb_taps, sizeof(*ir));
+    src = av_malloc_array(s.min_part_size, sizeof(*src));
+    dst = av_calloc(s.min_part_size, sizeof(*dst));
+    if (!ir || !src || !dst) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    fill_random(lfg, ir, nb_taps);
+    fill_random(lfg, src, s.min_part_size);
+    ff_partconv_set_coeffs(&s, 0, ir);
+
+    av_log(NULL, AV_LOG_INFO, "Speed test, %d channels, %d taps, partitions %d-%d...\n",
+           nb_channels, nb_taps, s.min_part_size, 1 << av_log2(FFMAX(maxp, minp)));
+    /* we measure during about 1 second */
+    nb_its = 1;
+    for (;;) {
+        time_start = av_gettime_relative();
+        for (it = 0; it < nb_its; it++)
+            for (ch = 0; ch < nb_channels; ch++)
+                ff_partconv_filter(&s, ch, dst, src, 1.f, s.min_part_size);
+        duration = av_gettime_relative() - time_start;
+        if (duration >= 1000000)
+            break;
+        nb_its *= 2;
+    }
+    av_log(NULL, AV_LOG_INFO,
+           "time: %0.3f us/quantum, %0.1f ns/sample/channel [total time=%0.2f s its=%d]\n",
+           (double) duration / nb_its,
+           (double) duration * 1000 / ((double)nb_its * s.min_part_size * nb_channels),
+           (double) duration / 1000000.0,
+           nb_its);
+
+end:
+    ff_partconv_uninit(&s);
+    av_free(ir);
+    av_free(src);
+    av_free(dst);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const int tests[][5] = {
+        /* channels, coeff channels, taps, minp, maxp */
+        { 1, 1,    1,   16,   16 },
+        { 1, 1, 1000,   16,   16 },
+        { 2, 1, 4097,   32, 1024 },
+        { 2, 2, 9000,   64, 8192 },
+        { 3, 3,  100,  256,   64 },
+    };
+    int do_speed = 0, nb_channels = 2, nb_taps = 48000, minp = 64, maxp = 8192;
+    AVLFG lfg;
+    int ret = 0;
+
+    for (;;) {
+        int c = getopt(argc, argv, "hsc:t:p:P:");
+        if (c == -1)
+            break;
+        switch (c) {
+        case 'h':
+            help();
+            return 1;
+        case 's':
+            do_speed = 1;
+            break;
+        case 'c':
+            nb_channels = atoi(optarg);
+            break;
+        case 't':
+            nb_taps = atoi(optarg);
+            break;
+        case 'p':
+            minp = atoi(optarg);
+            break;
+        case 'P':
+            maxp = atoi(optarg);
+            break;
+        }
+    }
+
+    av_lfg_init(&lfg, 1);
+
+    if (do_speed)
+        return speed_test(&lfg, nb_channels, nb_taps, minp, maxp) < 0;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(tests); i++)
+        if (check(&lfg, tests[i][0], tests[i][1], tests[i][2], tests[i][3], tests[i][4]) < 0)
+            ret = 1;
+
+    return ret;
+}
@@ -0,0 +1,414 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Generic filter running a DNN model on every video frame.
+ *
+ * While the model processes a frame, the previous output frame is passed
+ * downstream, so the rest of the filtergraph and the encoder run in
+ * parallel with inference.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
+#include "avfilter.h"
+#include "dnn_interface.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+typedef struct DnnProcessingContext {
+    const AVClass *class;
+
+    char *model_filename;
+    DNNBackendType backend_type;
+    char *model_inputname;
+    char *model_outputname;
+    int async;
+
+    DNNModule *dnn_module;
+    DNNModel *model;
+    DNNInputData input;
+    DNNData output;
+
+    AVFrame *pending;               ///< output frame of the inference in flight
+    DNNReturnType result;
+
+#if HAVE_THREADS
+    pthread_t worker;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int worker_started;
+    int busy;                       ///< inference requested or running, protected by mutex
+    int quit;
+#endif
+} DnnProcessingContext;
+
+#define OFFSET(x) offsetof(DnnProcessingContext, x)
+#define FLAGS AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM
+static const AVOption dnn_processing_options[] = {
+    { "dnn_backend", "DNN backend",                OFFSET(backend_type),     AV_OPT_TYPE_INT,       { .i64 = 0 },    0, 1, FLAGS, "backend" },
+    { "native",      "native backend flag",        0,                        AV_OPT_TYPE_CONST,     { .i64 = 0 },    0, 0, FLAGS, "backend" },
+#if (CONFIG_LIBTENSORFLOW == 1)
+    { "tensorflow",  "tensorflow backend flag",    0,                        AV_OPT_TYPE_CONST,     { .i64 = 1 },    0, 0, FLAGS, "backend" },
+#endif
+    { "model",       "path to model file",         OFFSET(model_filename),   AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "input",       "input name of the model",    OFFSET(model_inputname),  AV_OPT_TYPE_STRING,    { .str = "x" },  0, 0, FLAGS },
+    { "output",      "output name of the model",   OFFSET(model_outputname), AV_OPT_TYPE_STRING,    { .str = "y" },  0, 0, FLAGS },
+    { "async",       "run the model in a separate thread", OFFSET(async),    AV_OPT_TYPE_BOOL,      { .i64 = 1 },    0, 1, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(dnn_processing);
+
+#if HAVE_THREADS
+static void *worker_thread(void *arg)
+{
+    DnnProcessingContext *s = arg;
+
+    pthread_mutex_lock(&s->mutex);
+    for (;;) {
+        while (!s->busy && !s->quit)
+            pthread_cond_wait(&s->cond, &s->mutex);
+        if (s->quit)
+            break;
+        pthread_mutex_unlock(&s->mutex);
+
+        s->result = (s->dnn_module->execute_model)(s->model, &s->output, 1);
+
+        pthread_mutex_lock(&s->mutex);
+        s->busy = 0;
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->mutex);
+
+    return NULL;
+}
+#endif
+
+static void start_inference(DnnProcessingContext *s)
+{
+#if HAVE_THREADS
+    if (s->worker_started) {
+        pthread_mutex_lock(&s->mutex);
+        s->busy = 1;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+        return;
+    }
+#endif
+    s->result = (s->dnn_module->execute_model)(s->model, &s->output, 1);
+}
+
+static DNNReturnType wait_inference(DnnProcessingContext *s)
+{
+#if HAVE_THREADS
+    if (s->worker_started) {
+        pthread_mutex_lock(&s->mutex);
+        while (s->busy)
+            pthread_cond_wait(&s->cond, &s->mutex);
+        pthread_mutex_unlock(&s->mutex);
+    }
+#endif
+    return s->result;
+}
+
+static av_cold int init(AVFilterContext *context)
+{
+    DnnProcessingContext *s = context->priv;
+
+    if (!s->model_filename) {
+        av_log(context, AV_LOG_ERROR, "model file for network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->dnn_module = ff_get_dnn_module(s->backend_type);
+    if (!s->dnn_module) {
+        av_log(context, AV_LOG_ERROR, "could not create DNN module for requested backend\n");
+        return AVERROR(ENOMEM);
+    }
+    if (!s->dnn_module->load_model) {
+        av_log(context, AV_LOG_ERROR, "load_model for network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->model = (s->dnn_module->load_model)(s->model_filename);
+    if (!s->model) {
+        av_log(context, AV_LOG_ERROR, "could not load DNN model\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->input.dt = DNN_FLOAT;
+
+#if HAVE_THREADS
+    if (s->async) {
+        int ret;
+
+        if ((ret = AVERROR(pthread_mutex_init(&s->mutex, NULL))) < 0)
+            return ret;
+        if ((ret = AVERROR(pthread_cond_init(&s->cond, NULL))) < 0) {
+            pthread_mutex_destroy(&s->mutex);
+            return ret;
+        }
+        if ((ret = AVERROR(pthread_create(&s->worker, NULL, worker_thread, s))) < 0) {
+            pthread_cond_destroy(&s->cond);
+            pthread_mutex_destroy(&s->mutex);
+            return ret;
+        }
+        s->worker_started = 1;
+    }
+#endif
+
+    return 0;
+}
+
+static int query_formats(AVFilterContext *context)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_RGB24, AV_PIX_FMT_BGR24,
+        AV_PIX_FMT_GRAY8, AV_PIX_FMT_GRAYF32,
+        AV_PIX_FMT_NONE
+    };
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+    if (!fmts_list)
+        return AVERROR(ENOMEM);
+    return ff_set_common_formats(context, fmts_list);
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *context = inlink->dst;
+    DnnProcessingContext *s = context->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    const char *model_output_name = s->model_outputname;
+    DNNReturnType result;
+
+    s->input.width    = inlink->w;
+    s->input.height   = inlink->h;
+    s->input.channels = desc->nb_components;
+
+    result = (s->model->set_input_output)(s->model->model, &s->input, s->model_inputname,
+                                          &model_output_name, 1);
+    if (result != DNN_SUCCESS) {
+        av_log(context, AV_LOG_ERROR, "could not set input and output for the model\n");
+        return AVERROR(EIO);
+    }
+
+    // have a try run in case that the dnn model resize the frame
+    start_inference(s);
+    if (wait_inference(s) != DNN_SUCCESS) {
+        av_log(context, AV_LOG_ERROR, "failed to execute model\n");
+        return AVERROR(EIO);
+    }
+
+    if (s->output.channels != s->input.channels) {
+        av_log(context, AV_LOG_ERROR, "the model outputs %d channels, %s needs %d\n",
+               s->output.channels, desc->name, s->input.channels);
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *context = outlink->src;
+    DnnProcessingContext *s = context->priv;
+
+    outlink->w = s->output.width;
+    outlink->h = s->output.height;
+
+    return 0;
+}
+
+static void copy_frame_to_tensor(float *dst, const AVFrame *frame, int channels)
+{
+    int bytewidth = frame->width * channels;
+    int x, y;
+
+    if (frame->format == AV_PIX_FMT_GRAYF32) {
+        for (y = 0; y < frame->height; y++)
+            memcpy(dst + y * frame->width,
+                   frame->data[0] + y * frame->linesize[0], frame->width * sizeof(*dst));
+        return;
+    }
+
+    for (y = 0; y < frame->height; y++) {
+        const uint8_t *src = frame->data[0] + y * frame->linesize[0];
+
+        for (x = 0; x < bytewidth; x++)
+            dst[x] = src[x] / 255.0f;
+        dst += bytewidth;
+    }
+}
+
+static void copy_tensor_to_frame(AVFrame *frame, const float *src, int channels)
+{
+    int bytewidth = frame->width * channels;
+    int x, y;
+
+    if (frame->format == AV_PIX_FMT_GRAYF32) {
+        for (y = 0; y < frame->height; y++)
+            memcpy(frame->data[0] + y * frame->linesize[0],
+                   src + y * frame->width, frame->width * sizeof(*src));
+        return;
+    }
+
+    for (y = 0; y < frame->height; y++) {
+        uint8_t *dst = frame->data[0] + y * frame->linesize[0];
+
+        for (x = 0; x < bytewidth; x++)
+            dst[x] = av_clip_uint8(lrintf(src[x] * 255.0f));
+        src += bytewidth;
+    }
+}
+
+/**
+ * Wait for the inference in flight and return its output frame, if any.
+ */
+static int finish_pending(AVFilterContext *context, AVFrame **out)
+{
+    DnnProcessingContext *s = context->priv;
+
+    *out = s->pending;
+    s->pending = NULL;
+    if (!*out)
+        return 0;
+
+    if (wait_inference(s) != DNN_SUCCESS) {
+        av_log(context, AV_LOG_ERROR, "failed to execute model\n");
+        av_frame_free(out);
+        return AVERROR(EIO);
+    }
+    copy_tensor_to_frame(*out, s->output.data, s->output.channels);
+
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *context = inlink->dst;
+    AVFilterLink *outlink = context->outputs[0];
+    DnnProcessingContext *s = context->priv;
+    AVFrame *out, *prev;
+    int ret;
+
+    out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+    if (!out) {
+        av_frame_free(&in);
+        return AVERROR(ENOMEM);
+    }
+    av_frame_copy_props(out, in);
+
+    /* the model reads its input tensor and overwrites its output tensor
+     * while running, so the previous frame has to be finished first */
+    ret = finish_pending(context, &prev);
+    if (ret < 0) {
+        av_frame_free(&in);
+        av_frame_free(&out);
+        return ret;
+    }
+
+    copy_frame_to_tensor(s->input.data, in, s->input.channels);
+    av_frame_free(&in);
+
+    s->pending = out;
+    start_inference(s);
+
+    return prev ? ff_filter_frame(outlink, prev) : 0;
+}
+
+static int request_frame(AVFilterLink *outlink)
+{
+    AVFilterContext *context = outlink->src;
+    AVFrame *out;
+    int ret;
+
+    ret = ff_request_frame(context->inputs[0]);
+    if (ret == AVERROR_EOF) {
+        ret = finish_pending(context, &out);
+        if (ret < 0)
+            return ret;
+        if (out)
+            return ff_filter_frame(outlink, out);
+        return AVERROR_EOF;
+    }
+
+    return ret;
+}
+
+static av_cold void uninit(AVFilterContext *context)
+{
+    DnnProcessingContext *s = context->priv;
+
+#if HAVE_THREADS
+    if (s->worker_started) {
+        pthread_mutex_lock(&s->mutex);
+        s->quit = 1;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+        pthread_join(s->worker, NULL);
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->mutex);
+        s->worker_started = 0;
+    }
+#endif
+    av_frame_free(&s->pending);
+
+    if (s->dnn_module)
+        (s->dnn_module->free_model)(&s->model);
+    av_freep(&s->dnn_module);
+}
+
+static const AVFilterPad dnn_processing_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+static const AVFilterPad dnn_processing_outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+        .config_props  = config_output,
+        .request_frame = request_frame,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_dnn_processing = {
+    .name          = "dnn_processing",
+    .description   = NULL_IF_CONFIG_SMALL("Apply DNN processing filter to the input."),
+    .priv_size     = sizeof(DnnProcessingContext),
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = dnn_processing_inputs,
+    .outputs       = dnn_processing_outputs,
+    .priv_class    = &dnn_processing_class,
+};
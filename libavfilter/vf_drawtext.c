@@ -184,6 +184,14 @@ typedef struct DrawTextContext {
     FT_Face face;                   ///< freetype font face handle
     FT_Stroker stroker;             ///< freetype stroker handle
     struct AVTreeNode *glyphs;      ///< rendered glyphs, stored using the UTF-32 char code
+    char *cached_text;              ///< expanded text the layout and masks below were made for
+    unsigned int cached_fontsize;   ///< font size the layout and masks below were made for
+    int text_w, text_h;             ///< size of the laid out text
+    uint8_t *text_mask;             ///< coverage of all glyphs of the text
+    uint8_t *border_mask;           ///< coverage of all glyph borders of the text
+    unsigned int masks_size;
+    int mask_x, mask_y;             ///< position of the masks relative to the text
+    int mask_w, mask_h, mask_linesize;
     char *x_expr;                   ///< expression for x position
     char *y_expr;                   ///< expression for y position
     AVExpr *x_pexpr, *y_pexpr;      ///< parsed expressions for x and y
@@ -817,6 +825,11 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_tree_destroy(s->glyphs);
     s->glyphs = NULL;
 
+    av_freep(&s->cached_text);
+    av_freep(&s->text_mask);
+    s->border_mask = NULL;
+    s->masks_size = 0;
+
     FT_Done_Face(s->face);
     FT_Stroker_Done(s->stroker);
     FT_Done_FreeType(s->library);
@@ -1209,50 +1222,152 @@ static int expand_text(AVFilterContext *ctx, char *text, AVBPrint *bp)
     return 0;
 }
 
-static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
-                       int width, int height,
-                       FFDrawColor *color,
-                       int x, int y, int borderw)
+static void composite_glyph(uint8_t *dst, int dst_linesize, const FT_Bitmap *bitmap)
+{
+    int x, y;
+
+    for (y = 0; y < bitmap->rows; y++) {
+        const uint8_t *src = bitmap->buffer + y * bitmap->pitch;
+
+        for (x = 0; x < bitmap->width; x++) {
+            int v = bitmap->pixel_mode == FT_PIXEL_MODE_MONO ?
+                    ((src[x >> 3] >> (7 - (x & 7))) & 1) * 255 : src[x];
+            /* overlapping glyphs add up as if blended one after the other */
+            dst[x] = dst[x] + v - (dst[x] * v + 127) / 255;
+        }
+        dst += dst_linesize;
+    }
+}
+
+/**
+ * Render the glyphs and borders of the laid out text into two 8-bit masks,
+ * so that every layer of the text is blended with a single ff_blend_mask()
+ * call per frame until the text changes.
+ */
+static int render_text_masks(DrawTextContext *s)
 {
     char *text = s->expanded_text.str;
-    uint32_t code = 0;
-    int i, x1, y1;
+    int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+    int nb_masks = s->borderw ? 2 : 1;
+    uint32_t code = 0, prev_code = 0;
+    Glyph *glyph;
     uint8_t *p;
-    Glyph *glyph = NULL;
+    int i;
 
     for (i = 0, p = text; *p; i++) {
-        FT_Bitmap bitmap;
         Glyph dummy = { 0 };
         GET_UTF8(code, *p++, continue;);
 
-        /* skip new line chars, just go to new line */
-        if (code == '\n' || code == '\r' || code == '\t')
+        /* skip the chars the layout gave no position, and tabs */
+        if (prev_code == '\r' && code == '\n')
+            continue;
+        prev_code = code;
+        if (is_newline(code) || code == '\t')
             continue;
 
         dummy.code = code;
         dummy.fontsize = s->fontsize;
         glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
 
-        bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
-
         if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
             glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
             return AVERROR(EINVAL);
 
-        x1 = s->positions[i].x+s->x+x - borderw;
-        y1 = s->positions[i].y+s->y+y - borderw;
+        x0 = FFMIN(x0, s->positions[i].x);
+        y0 = FFMIN(y0, s->positions[i].y);
+        x1 = FFMAX(x1, s->positions[i].x + (int)glyph->bitmap.width);
+        y1 = FFMAX(y1, s->positions[i].y + (int)glyph->bitmap.rows);
+        if (s->borderw) {
+            x0 = FFMIN(x0, s->positions[i].x - s->borderw);
+            y0 = FFMIN(y0, s->positions[i].y - s->borderw);
+            x1 = FFMAX(x1, s->positions[i].x - s->borderw + (int)glyph->border_bitmap.width);
+            y1 = FFMAX(y1, s->positions[i].y - s->borderw + (int)glyph->border_bitmap.rows);
+        }
+    }
+
+    s->mask_w = s->mask_h = 0;
+    if (x0 >= x1 || y0 >= y1)
+        return 0;
 
-        ff_blend_mask(&s->dc, color,
-                      frame->data, frame->linesize, width, height,
-                      bitmap.buffer, bitmap.pitch,
-                      bitmap.width, bitmap.rows,
-                      bitmap.pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
-                      0, x1, y1);
+    s->mask_x = x0;
+    s->mask_y = y0;
+    s->mask_w = x1 - x0;
+    s->mask_h = y1 - y0;
+    s->mask_linesize = FFALIGN(s->mask_w, 32);
+    av_fast_malloc(&s->text_mask, &s->masks_size, (size_t)s->mask_linesize * s->mask_h * nb_masks);
+    if (!s->text_mask) {
+        s->masks_size = 0;
+        s->mask_w = s->mask_h = 0;
+        return AVERROR(ENOMEM);
+    }
+    memset(s->text_mask, 0, (size_t)s->mask_linesize * s->mask_h * nb_masks);
+    s->border_mask = s->borderw ? s->text_mask + s->mask_linesize * s->mask_h : NULL;
+
+    prev_code = 0;
+    for (i = 0, p = text; *p; i++) {
+        Glyph dummy = { 0 };
+        GET_UTF8(code, *p++, continue;);
+
+        if (prev_code == '\r' && code == '\n')
+            continue;
+        prev_code = code;
+        if (is_newline(code) || code == '\t')
+            continue;
+
+        dummy.code = code;
+        dummy.fontsize = s->fontsize;
+        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+
+        composite_glyph(s->text_mask + (s->positions[i].y - y0) * s->mask_linesize +
+                        s->positions[i].x - x0, s->mask_linesize, &glyph->bitmap);
+        if (s->borderw)
+            composite_glyph(s->border_mask +
+                            (s->positions[i].y - s->borderw - y0) * s->mask_linesize +
+                            s->positions[i].x - s->borderw - x0,
+                            s->mask_linesize, &glyph->border_bitmap);
     }
 
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFrame *frame;
+    FFDrawColor *color;
+    const uint8_t *mask;
+    int x, y;
+} ThreadData;
+
+static int blend_mask_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DrawTextContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *frame = td->frame;
+    /* band boundaries are kept on chroma rows, so that no job touches the
+     * chroma samples of another one */
+    const int align = ~((1 << s->dc.vsub_max) - 1);
+    const int start = jobnr ? FFMAX((td->y + s->mask_h * jobnr / nb_jobs) & align, td->y) : td->y;
+    const int end   = jobnr < nb_jobs - 1 ?
+                      FFMAX((td->y + s->mask_h * (jobnr + 1) / nb_jobs) & align, td->y) :
+                      td->y + s->mask_h;
+
+    if (end > start)
+        ff_blend_mask(&s->dc, td->color,
+                      frame->data, frame->linesize, frame->width, frame->height,
+                      td->mask + (start - td->y) * s->mask_linesize, s->mask_linesize,
+                      s->mask_w, end - start, 3, 0, td->x, start);
+
+    return 0;
+}
+
+static void draw_mask(AVFilterContext *ctx, AVFrame *frame, FFDrawColor *color,
+                      const uint8_t *mask, int x, int y)
+{
+    DrawTextContext *s = ctx->priv;
+    ThreadData td = { frame, color, mask, x, y };
+    int nb_jobs = av_clip(s->mask_h / 16, 1, ff_filter_get_nb_threads(ctx));
+
+    ctx->internal->execute(ctx, blend_mask_slice, &td, NULL, nb_jobs);
+}
 
 static void update_color_with_alpha(DrawTextContext *s, FFDrawColor *color, const FFDrawColor incolor)
 {
@@ -1359,6 +1474,11 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     if ((ret = update_fontsize(ctx)) < 0)
         return ret;
 
+    /* the layout and the text masks only depend on the text and the font size */
+    if (s->cached_text && s->cached_fontsize == s->fontsize &&
+        !strcmp(s->cached_text, text))
+        goto layout_done;
+
     /* load and cache glyphs */
     for (i = 0, p = text; *p; i++) {
         GET_UTF8(code, *p++, continue;);
@@ -1431,6 +1551,17 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
 
     s->var_values[VAR_LINE_H] = s->var_values[VAR_LH] = s->max_glyph_h;
 
+    s->text_w = max_text_line_w;
+    s->text_h = y + s->max_glyph_h;
+
+    av_freep(&s->cached_text);
+    if ((ret = render_text_masks(s)) < 0)
+        return ret;
+    if (!(s->cached_text = av_strdup(text)))
+        return AVERROR(ENOMEM);
+    s->cached_fontsize = s->fontsize;
+
+layout_done:
     s->x = s->var_values[VAR_X] = av_expr_eval(s->x_pexpr, s->var_values, &s->prng);
     s->y = s->var_values[VAR_Y] = av_expr_eval(s->y_pexpr, s->var_values, &s->prng);
     /* It is necessary if x is expressed from y  */
@@ -1442,8 +1573,8 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     update_color_with_alpha(s, &bordercolor, s->bordercolor);
     update_color_with_alpha(s, &boxcolor   , s->boxcolor   );
 
-    box_w = max_text_line_w;
-    box_h = y + s->max_glyph_h;
+    box_w = s->text_w;
+    box_h = s->text_h;
 
     if (s->fix_bounds) {
 
@@ -1478,20 +1609,19 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
                            s->x - s->boxborderw, s->y - s->boxborderw,
                            box_w + s->boxborderw * 2, box_h + s->boxborderw * 2);
 
-    if (s->shadowx || s->shadowy) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &shadowcolor, s->shadowx, s->shadowy, 0)) < 0)
-            return ret;
-    }
+    if (!s->mask_w)
+        return 0;
 
-    if (s->borderw) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &bordercolor, 0, 0, s->borderw)) < 0)
-            return ret;
-    }
-    if ((ret = draw_glyphs(s, frame, width, height,
-                           &fontcolor, 0, 0, 0)) < 0)
-        return ret;
+    if (s->shadowx || s->shadowy)
+        draw_mask(ctx, frame, &shadowcolor, s->text_mask,
+                  s->x + s->mask_x + s->shadowx, s->y + s->mask_y + s->shadowy);
+
+    if (s->borderw)
+        draw_mask(ctx, frame, &bordercolor, s->border_mask,
+                  s->x + s->mask_x, s->y + s->mask_y);
+
+    draw_mask(ctx, frame, &fontcolor, s->text_mask,
+              s->x + s->mask_x, s->y + s->mask_y);
 
     return 0;
 }
@@ -1567,5 +1697,5 @@ AVFilter ff_vf_drawtext = {
     .inputs        = avfilter_vf_drawtext_inputs,
     .outputs       = avfilter_vf_drawtext_outputs,
     .process_command = command,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
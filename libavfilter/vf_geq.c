@@ -48,6 +48,7 @@ typedef struct GEQContext {
     int planes;                 ///< number of planes
     int is_rgb;
     int bps;
+    int *job_ret;               ///< return value of each slice job
 } GEQContext;
 
 enum { Y = 0, U, V, A, G, B, R };
@@ -231,6 +232,11 @@ static int geq_config_props(AVFilterLink *inlink)
     geq->vsub = desc->log2_chroma_h;
     geq->bps = desc->comp[0].depth;
     geq->planes = desc->nb_components;
+
+    av_freep(&geq->job_ret);
+    geq->job_ret = av_malloc_array(ff_filter_get_nb_threads(inlink->dst), sizeof(*geq->job_ret));
+    if (!geq->job_ret)
+        return AVERROR(ENOMEM);
     return 0;
 }
 
@@ -251,9 +257,11 @@ static int slice_geq_filter(AVFilterContext *ctx, void *arg, int jobnr, int nb_j
     const int linesize = td->linesize;
     const int slice_start = (height *  jobnr) / nb_jobs;
     const int slice_end = (height * (jobnr+1)) / nb_jobs;
-    int x, y;
+    int x, y, i, n, ret;
     uint8_t *ptr;
     uint16_t *ptr16;
+    double xs[64], res[64];
+    const double *arrays[VAR_VARS_NB] = { [VAR_X] = xs };
 
     double values[VAR_VARS_NB];
     values[VAR_W] = geq->values[VAR_W];
@@ -268,20 +276,29 @@ static int slice_geq_filter(AVFilterContext *ctx, void *arg, int jobnr, int nb_j
             ptr = geq->dst + linesize * y;
             values[VAR_Y] = y;
 
-            for (x = 0; x < width; x++) {
-                values[VAR_X] = x;
-                ptr[x] = av_expr_eval(geq->e[plane], values, geq);
+            for (x = 0; x < width; x += n) {
+                n = FFMIN(width - x, FF_ARRAY_ELEMS(xs));
+                for (i = 0; i < n; i++)
+                    xs[i] = x + i;
+                if ((ret = av_expr_eval_batch(geq->e[plane], res, n, values, arrays, geq)) < 0)
+                    return ret;
+                for (i = 0; i < n; i++)
+                    ptr[x + i] = res[i];
             }
-            ptr += linesize;
         }
     }
     else {
         for (y = slice_start; y < slice_end; y++) {
             ptr16 = geq->dst16 + (linesize/2) * y;
             values[VAR_Y] = y;
-            for (x = 0; x < width; x++) {
-                values[VAR_X] = x;
-                ptr16[x] = av_expr_eval(geq->e[plane], values, geq);
+            for (x = 0; x < width; x += n) {
+                n = FFMIN(width - x, FF_ARRAY_ELEMS(xs));
+                for (i = 0; i < n; i++)
+                    xs[i] = x + i;
+                if ((ret = av_expr_eval_batch(geq->e[plane], res, n, values, arrays, geq)) < 0)
+                    return ret;
+                for (i = 0; i < n; i++)
+                    ptr16[x + i] = res[i];
             }
         }
     }
@@ -291,7 +308,7 @@ static int slice_geq_filter(AVFilterContext *ctx, void *arg, int jobnr, int nb_j
 
 static int geq_filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
-    int plane;
+    int plane, nb_jobs, i, ret;
     AVFilterContext *ctx = inlink->dst;
     const int nb_threads = ff_filter_get_nb_threads(ctx);
     GEQContext *geq = ctx->priv;
@@ -328,7 +345,16 @@ static int geq_filter_frame(AVFilterLink *inlink, AVFrame *in)
         td.plane = plane;
         td.linesize = linesize;
 
-        ctx->internal->execute(ctx, slice_geq_filter, &td, NULL, FFMIN(height, nb_threads));
+        nb_jobs = FFMIN(height, nb_threads);
+        ctx->internal->execute(ctx, slice_geq_filter, &td, geq->job_ret, nb_jobs);
+        for (i = 0; i < nb_jobs; i++) {
+            if (geq->job_ret[i] < 0) {
+                ret = geq->job_ret[i];
+                av_frame_free(&out);
+                av_frame_free(&geq->picref);
+                return ret;
+            }
+        }
     }
 
     av_frame_free(&geq->picref);
@@ -342,6 +368,7 @@ static av_cold void geq_uninit(AVFilterContext *ctx)
 
     for (i = 0; i < FF_ARRAY_ELEMS(geq->e); i++)
         av_expr_free(geq->e[i]);
+    av_freep(&geq->job_ret);
 }
 
 static const AVFilterPad geq_inputs[] = {
@@ -36,6 +36,7 @@
 #include "framesync.h"
 #include "internal.h"
 #include "video.h"
+#include "vf_lut3d.h"
 
 #define R 0
 #define G 1
@@ -49,14 +50,6 @@ enum interp_mode {
     NB_INTERP_MODE
 };
 
-struct rgbvec {
-    float r, g, b;
-};
-
-/* 3D LUT don't often go up to level 32, but it is common to have a Hald CLUT
- * of 512x512 (64x64x64) */
-#define MAX_LEVEL 128
-
 typedef struct LUT3DContext {
     const AVClass *class;
     int interpolation;          ///<interp_mode
@@ -64,6 +57,7 @@ typedef struct LUT3DContext {
     uint8_t rgba_map[4];
     int step;
     avfilter_action_func *interp;
+    LUT3DDSPContext dsp;
     struct rgbvec scale;
     struct rgbvec lut[MAX_LEVEL][MAX_LEVEL][MAX_LEVEL];
     int lutsize;
@@ -148,57 +142,52 @@ static inline struct rgbvec interp_trilinear(const LUT3DContext *lut3d,
  * Tetrahedral interpolation. Based on code found in Truelight Software Library paper.
  * @see http://www.filmlight.ltd.uk/pdf/whitepapers/FL-TL-TN-0057-SoftwareLib.pdf
  */
-static inline struct rgbvec interp_tetrahedral(const LUT3DContext *lut3d,
-                                               const struct rgbvec *s)
+static void interp_tetrahedral_c(float *dst_r, float *dst_g, float *dst_b,
+                                 const float *src_r, const float *src_g, const float *src_b,
+                                 const struct rgbvec *lut, int lutsize, int len)
 {
-    const int prev[] = {PREV(s->r), PREV(s->g), PREV(s->b)};
-    const int next[] = {NEXT(s->r), NEXT(s->g), NEXT(s->b)};
-    const struct rgbvec d = {s->r - prev[0], s->g - prev[1], s->b - prev[2]};
-    const struct rgbvec c000 = lut3d->lut[prev[0]][prev[1]][prev[2]];
-    const struct rgbvec c111 = lut3d->lut[next[0]][next[1]][next[2]];
-    struct rgbvec c;
-    if (d.r > d.g) {
-        if (d.g > d.b) {
-            const struct rgbvec c100 = lut3d->lut[next[0]][prev[1]][prev[2]];
-            const struct rgbvec c110 = lut3d->lut[next[0]][next[1]][prev[2]];
-            c.r = (1-d.r) * c000.r + (d.r-d.g) * c100.r + (d.g-d.b) * c110.r + (d.b) * c111.r;
-            c.g = (1-d.r) * c000.g + (d.r-d.g) * c100.g + (d.g-d.b) * c110.g + (d.b) * c111.g;
-            c.b = (1-d.r) * c000.b + (d.r-d.g) * c100.b + (d.g-d.b) * c110.b + (d.b) * c111.b;
-        } else if (d.r > d.b) {
-            const struct rgbvec c100 = lut3d->lut[next[0]][prev[1]][prev[2]];
-            const struct rgbvec c101 = lut3d->lut[next[0]][prev[1]][next[2]];
-            c.r = (1-d.r) * c000.r + (d.r-d.b) * c100.r + (d.b-d.g) * c101.r + (d.g) * c111.r;
-            c.g = (1-d.r) * c000.g + (d.r-d.b) * c100.g + (d.b-d.g) * c101.g + (d.g) * c111.g;
-            c.b = (1-d.r) * c000.b + (d.r-d.b) * c100.b + (d.b-d.g) * c101.b + (d.g) * c111.b;
-        } else {
-            const struct rgbvec c001 = lut3d->lut[prev[0]][prev[1]][next[2]];
-            const struct rgbvec c101 = lut3d->lut[next[0]][prev[1]][next[2]];
-            c.r = (1-d.b) * c000.r + (d.b-d.r) * c001.r + (d.r-d.g) * c101.r + (d.g) * c111.r;
-            c.g = (1-d.b) * c000.g + (d.b-d.r) * c001.g + (d.r-d.g) * c101.g + (d.g) * c111.g;
-            c.b = (1-d.b) * c000.b + (d.b-d.r) * c001.b + (d.r-d.g) * c101.b + (d.g) * c111.b;
-        }
-    } else {
-        if (d.b > d.g) {
-            const struct rgbvec c001 = lut3d->lut[prev[0]][prev[1]][next[2]];
-            const struct rgbvec c011 = lut3d->lut[prev[0]][next[1]][next[2]];
-            c.r = (1-d.b) * c000.r + (d.b-d.g) * c001.r + (d.g-d.r) * c011.r + (d.r) * c111.r;
-            c.g = (1-d.b) * c000.g + (d.b-d.g) * c001.g + (d.g-d.r) * c011.g + (d.r) * c111.g;
-            c.b = (1-d.b) * c000.b + (d.b-d.g) * c001.b + (d.g-d.r) * c011.b + (d.r) * c111.b;
-        } else if (d.b > d.r) {
-            const struct rgbvec c010 = lut3d->lut[prev[0]][next[1]][prev[2]];
-            const struct rgbvec c011 = lut3d->lut[prev[0]][next[1]][next[2]];
-            c.r = (1-d.g) * c000.r + (d.g-d.b) * c010.r + (d.b-d.r) * c011.r + (d.r) * c111.r;
-            c.g = (1-d.g) * c000.g + (d.g-d.b) * c010.g + (d.b-d.r) * c011.g + (d.r) * c111.g;
-            c.b = (1-d.g) * c000.b + (d.g-d.b) * c010.b + (d.b-d.r) * c011.b + (d.r) * c111.b;
+    int x;
+
+    for (x = 0; x < len; x++) {
+        const int prev[] = {PREV(src_r[x]), PREV(src_g[x]), PREV(src_b[x])};
+        const struct rgbvec d = {src_r[x] - prev[0], src_g[x] - prev[1], src_b[x] - prev[2]};
+        const int step_r = (FFMIN(prev[0] + 1, lutsize - 1) - prev[0]) * MAX_LEVEL * MAX_LEVEL;
+        const int step_g = (FFMIN(prev[1] + 1, lutsize - 1) - prev[1]) * MAX_LEVEL;
+        const int step_b =  FFMIN(prev[2] + 1, lutsize - 1) - prev[2];
+        const struct rgbvec *c000 = lut + (prev[0] * MAX_LEVEL + prev[1]) * MAX_LEVEL + prev[2];
+        const struct rgbvec *c111 = c000 + step_r + step_g + step_b;
+        const struct rgbvec *c1, *c2;
+        float d1, d2, d3;
+
+        /* only the vertex selection depends on the ordering of the
+         * fractional parts, the weighted sum is the same for all six */
+        if (d.r > d.g) {
+            if (d.g > d.b) {
+                d1 = d.r; d2 = d.g; d3 = d.b; c1 = c000 + step_r; c2 = c1 + step_g;
+            } else if (d.r > d.b) {
+                d1 = d.r; d2 = d.b; d3 = d.g; c1 = c000 + step_r; c2 = c1 + step_b;
+            } else {
+                d1 = d.b; d2 = d.r; d3 = d.g; c1 = c000 + step_b; c2 = c1 + step_r;
+            }
         } else {
-            const struct rgbvec c010 = lut3d->lut[prev[0]][next[1]][prev[2]];
-            const struct rgbvec c110 = lut3d->lut[next[0]][next[1]][prev[2]];
-            c.r = (1-d.g) * c000.r + (d.g-d.r) * c010.r + (d.r-d.b) * c110.r + (d.b) * c111.r;
-            c.g = (1-d.g) * c000.g + (d.g-d.r) * c010.g + (d.r-d.b) * c110.g + (d.b) * c111.g;
-            c.b = (1-d.g) * c000.b + (d.g-d.r) * c010.b + (d.r-d.b) * c110.b + (d.b) * c111.b;
+            if (d.b > d.g) {
+                d1 = d.b; d2 = d.g; d3 = d.r; c1 = c000 + step_b; c2 = c1 + step_g;
+            } else if (d.b > d.r) {
+                d1 = d.g; d2 = d.b; d3 = d.r; c1 = c000 + step_g; c2 = c1 + step_b;
+            } else {
+                d1 = d.g; d2 = d.r; d3 = d.b; c1 = c000 + step_g; c2 = c1 + step_r;
+            }
         }
+
+        dst_r[x] = (1-d1) * c000->r + (d1-d2) * c1->r + (d2-d3) * c2->r + (d3) * c111->r;
+        dst_g[x] = (1-d1) * c000->g + (d1-d2) * c1->g + (d2-d3) * c2->g + (d3) * c111->g;
+        dst_b[x] = (1-d1) * c000->b + (d1-d2) * c1->b + (d2-d3) * c2->b + (d3) * c111->b;
     }
-    return c;
+}
+
+void ff_lut3d_init(LUT3DDSPContext *dsp)
+{
+    dsp->interp_tetrahedral = interp_tetrahedral_c;
 }
 
 #define DEFINE_INTERP_FUNC_PLANAR(name, nbits, depth)                                                  \
@@ -256,29 +245,95 @@ static int interp_##nbits##_##name##_p##depth(AVFilterContext *ctx, void *arg, i
     return 0;                                                                                          \
 }
 
+#define INTERP_LINE 256
+
+#define DEFINE_INTERP_TETRAHEDRAL_PLANAR(nbits, depth)                                                    \
+static int interp_##nbits##_tetrahedral_p##depth(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs) \
+{                                                                                                      \
+    int x, y, i;                                                                                       \
+    const LUT3DContext *lut3d = ctx->priv;                                                             \
+    const ThreadData *td = arg;                                                                        \
+    const AVFrame *in  = td->in;                                                                       \
+    const AVFrame *out = td->out;                                                                      \
+    const int direct = out == in;                                                                      \
+    const int slice_start = (in->height *  jobnr   ) / nb_jobs;                                        \
+    const int slice_end   = (in->height * (jobnr+1)) / nb_jobs;                                        \
+    uint8_t *grow = out->data[0] + slice_start * out->linesize[0];                                     \
+    uint8_t *brow = out->data[1] + slice_start * out->linesize[1];                                     \
+    uint8_t *rrow = out->data[2] + slice_start * out->linesize[2];                                     \
+    uint8_t *arow = out->data[3] + slice_start * out->linesize[3];                                     \
+    const uint8_t *srcgrow = in->data[0] + slice_start * in->linesize[0];                              \
+    const uint8_t *srcbrow = in->data[1] + slice_start * in->linesize[1];                              \
+    const uint8_t *srcrrow = in->data[2] + slice_start * in->linesize[2];                              \
+    const uint8_t *srcarow = in->data[3] + slice_start * in->linesize[3];                              \
+    const float scale_r = (lut3d->scale.r / ((1<<depth) - 1)) * (lut3d->lutsize - 1);                  \
+    const float scale_g = (lut3d->scale.g / ((1<<depth) - 1)) * (lut3d->lutsize - 1);                  \
+    const float scale_b = (lut3d->scale.b / ((1<<depth) - 1)) * (lut3d->lutsize - 1);                  \
+    LOCAL_ALIGNED_32(float, buf, [6 * INTERP_LINE]);                                                   \
+    float *r = buf, *g = buf + INTERP_LINE, *b = buf + 2 * INTERP_LINE;                                \
+    float *vr = buf + 3 * INTERP_LINE, *vg = buf + 4 * INTERP_LINE, *vb = buf + 5 * INTERP_LINE;       \
+                                                                                                       \
+    for (y = slice_start; y < slice_end; y++) {                                                        \
+        uint##nbits##_t *dstg = (uint##nbits##_t *)grow;                                               \
+        uint##nbits##_t *dstb = (uint##nbits##_t *)brow;                                               \
+        uint##nbits##_t *dstr = (uint##nbits##_t *)rrow;                                               \
+        uint##nbits##_t *dsta = (uint##nbits##_t *)arow;                                               \
+        const uint##nbits##_t *srcg = (const uint##nbits##_t *)srcgrow;                                \
+        const uint##nbits##_t *srcb = (const uint##nbits##_t *)srcbrow;                                \
+        const uint##nbits##_t *srcr = (const uint##nbits##_t *)srcrrow;                                \
+        const uint##nbits##_t *srca = (const uint##nbits##_t *)srcarow;                                \
+        for (x = 0; x < in->width; x += INTERP_LINE) {                                                 \
+            const int len = FFMIN(in->width - x, INTERP_LINE);                                         \
+            for (i = 0; i < len; i++) {                                                                \
+                r[i] = srcr[x + i] * scale_r;                                                          \
+                g[i] = srcg[x + i] * scale_g;                                                          \
+                b[i] = srcb[x + i] * scale_b;                                                          \
+            }                                                                                          \
+            lut3d->dsp.interp_tetrahedral(vr, vg, vb, r, g, b,                                         \
+                                          &lut3d->lut[0][0][0], lut3d->lutsize, len);                  \
+            for (i = 0; i < len; i++) {                                                                \
+                dstr[x + i] = av_clip_uintp2(vr[i] * (float)((1<<depth) - 1), depth);                  \
+                dstg[x + i] = av_clip_uintp2(vg[i] * (float)((1<<depth) - 1), depth);                  \
+                dstb[x + i] = av_clip_uintp2(vb[i] * (float)((1<<depth) - 1), depth);                  \
+            }                                                                                          \
+        }                                                                                              \
+        if (!direct && in->linesize[3])                                                                \
+            memcpy(dsta, srca, in->width * sizeof(*dsta));                                             \
+        grow += out->linesize[0];                                                                      \
+        brow += out->linesize[1];                                                                      \
+        rrow += out->linesize[2];                                                                      \
+        arow += out->linesize[3];                                                                      \
+        srcgrow += in->linesize[0];                                                                    \
+        srcbrow += in->linesize[1];                                                                    \
+        srcrrow += in->linesize[2];                                                                    \
+        srcarow += in->linesize[3];                                                                    \
+    }                                                                                                  \
+    return 0;                                                                                          \
+}
+
 DEFINE_INTERP_FUNC_PLANAR(nearest,     8, 8)
 DEFINE_INTERP_FUNC_PLANAR(trilinear,   8, 8)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 8, 8)
+DEFINE_INTERP_TETRAHEDRAL_PLANAR(      8, 8)
 
 DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 9)
 DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 9)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 9)
+DEFINE_INTERP_TETRAHEDRAL_PLANAR(      16, 9)
 
 DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 10)
 DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 10)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 10)
+DEFINE_INTERP_TETRAHEDRAL_PLANAR(      16, 10)
 
 DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 12)
 DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 12)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 12)
+DEFINE_INTERP_TETRAHEDRAL_PLANAR(      16, 12)
 
 DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 14)
 DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 14)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 14)
+DEFINE_INTERP_TETRAHEDRAL_PLANAR(      16, 14)
 
 DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 16)
 DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 16)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 16)
+DEFINE_INTERP_TETRAHEDRAL_PLANAR(      16, 16)
 
 #define DEFINE_INTERP_FUNC(name, nbits)                                                             \
 static int interp_##nbits##_##name(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)         \
@@ -322,13 +377,66 @@ static int interp_##nbits##_##name(AVFilterContext *ctx, void *arg, int jobnr, i
     return 0;                                                                                       \
 }
 
+#define DEFINE_INTERP_TETRAHEDRAL(nbits)                                                            \
+static int interp_##nbits##_tetrahedral(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)    \
+{                                                                                                   \
+    int x, y, i;                                                                                    \
+    const LUT3DContext *lut3d = ctx->priv;                                                          \
+    const ThreadData *td = arg;                                                                     \
+    const AVFrame *in  = td->in;                                                                    \
+    const AVFrame *out = td->out;                                                                   \
+    const int direct = out == in;                                                                   \
+    const int step = lut3d->step;                                                                   \
+    const uint8_t r = lut3d->rgba_map[R];                                                           \
+    const uint8_t g = lut3d->rgba_map[G];                                                           \
+    const uint8_t b = lut3d->rgba_map[B];                                                           \
+    const uint8_t a = lut3d->rgba_map[A];                                                           \
+    const int slice_start = (in->height *  jobnr   ) / nb_jobs;                                     \
+    const int slice_end   = (in->height * (jobnr+1)) / nb_jobs;                                     \
+    uint8_t       *dstrow = out->data[0] + slice_start * out->linesize[0];                          \
+    const uint8_t *srcrow = in ->data[0] + slice_start * in ->linesize[0];                          \
+    const float scale_r = (lut3d->scale.r / ((1<<nbits) - 1)) * (lut3d->lutsize - 1);               \
+    const float scale_g = (lut3d->scale.g / ((1<<nbits) - 1)) * (lut3d->lutsize - 1);               \
+    const float scale_b = (lut3d->scale.b / ((1<<nbits) - 1)) * (lut3d->lutsize - 1);               \
+    LOCAL_ALIGNED_32(float, buf, [6 * INTERP_LINE]);                                                \
+    float *sr = buf, *sg = buf + INTERP_LINE, *sb = buf + 2 * INTERP_LINE;                          \
+    float *vr = buf + 3 * INTERP_LINE, *vg = buf + 4 * INTERP_LINE, *vb = buf + 5 * INTERP_LINE;    \
+                                                                                                    \
+    for (y = slice_start; y < slice_end; y++) {                                                     \
+        uint##nbits##_t *dst = (uint##nbits##_t *)dstrow;                                           \
+        const uint##nbits##_t *src = (const uint##nbits##_t *)srcrow;                               \
+        for (x = 0; x < in->width; x += INTERP_LINE) {                                              \
+            const int len = FFMIN(in->width - x, INTERP_LINE);                                      \
+            const uint##nbits##_t *s = src + x * step;                                              \
+            uint##nbits##_t *d = dst + x * step;                                                    \
+            for (i = 0; i < len; i++) {                                                             \
+                sr[i] = s[i * step + r] * scale_r;                                                  \
+                sg[i] = s[i * step + g] * scale_g;                                                  \
+                sb[i] = s[i * step + b] * scale_b;                                                  \
+            }                                                                                       \
+            lut3d->dsp.interp_tetrahedral(vr, vg, vb, sr, sg, sb,                                   \
+                                          &lut3d->lut[0][0][0], lut3d->lutsize, len);               \
+            for (i = 0; i < len; i++) {                                                             \
+                d[i * step + r] = av_clip_uint##nbits(vr[i] * (float)((1<<nbits) - 1));             \
+                d[i * step + g] = av_clip_uint##nbits(vg[i] * (float)((1<<nbits) - 1));             \
+                d[i * step + b] = av_clip_uint##nbits(vb[i] * (float)((1<<nbits) - 1));             \
+                if (!direct && step == 4)                                                           \
+                    d[i * step + a] = s[i * step + a];                                              \
+            }                                                                                       \
+        }                                                                                           \
+        dstrow += out->linesize[0];                                                                 \
+        srcrow += in ->linesize[0];                                                                 \
+    }                                                                                               \
+    return 0;                                                                                       \
+}
+
 DEFINE_INTERP_FUNC(nearest,     8)
 DEFINE_INTERP_FUNC(trilinear,   8)
-DEFINE_INTERP_FUNC(tetrahedral, 8)
+DEFINE_INTERP_TETRAHEDRAL(      8)
 
 DEFINE_INTERP_FUNC(nearest,     16)
 DEFINE_INTERP_FUNC(trilinear,   16)
-DEFINE_INTERP_FUNC(tetrahedral, 16)
+DEFINE_INTERP_TETRAHEDRAL(      16)
 
 #define MAX_LINE_SIZE 512
 
@@ -699,6 +807,8 @@ static int config_input(AVFilterLink *inlink)
     ff_fill_rgba_map(lut3d->rgba_map, inlink->format);
     lut3d->step = av_get_padded_bits_per_pixel(desc) >> (3 + is16bit);
 
+    ff_lut3d_init(&lut3d->dsp);
+
 #define SET_FUNC(name) do {                                     \
     if (planar) {                                               \
         switch (depth) {                                        \
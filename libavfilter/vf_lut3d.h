@@ -0,0 +1,45 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_LUT3D_H
+#define AVFILTER_LUT3D_H
+
+struct rgbvec {
+    float r, g, b;
+};
+
+/* 3D LUT don't often go up to level 32, but it is common to have a Hald CLUT
+ * of 512x512 (64x64x64) */
+#define MAX_LEVEL 128
+
+typedef struct LUT3DDSPContext {
+    /**
+     * Tetrahedral interpolation of len pixels.
+     *
+     * @param lut     LUT laid out as lut[MAX_LEVEL][MAX_LEVEL][MAX_LEVEL]
+     * @param lutsize number of used entries per dimension
+     * @param src_r,src_g,src_b input components scaled to [0, lutsize - 1]
+     */
+    void (*interp_tetrahedral)(float *dst_r, float *dst_g, float *dst_b,
+                               const float *src_r, const float *src_g, const float *src_b,
+                               const struct rgbvec *lut, int lutsize, int len);
+} LUT3DDSPContext;
+
+void ff_lut3d_init(LUT3DDSPContext *dsp);
+
+#endif /* AVFILTER_LUT3D_H */
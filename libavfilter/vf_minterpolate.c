@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
 #include "motion_estimation.h"
 #include "libavcodec/mathops.h"
 #include "libavutil/avassert.h"
@@ -26,6 +28,7 @@
 #include "libavutil/motion_vector.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "formats.h"
 #include "internal.h"
@@ -195,8 +198,24 @@ typedef struct MIContext {
     int log2_chroma_w;
     int log2_chroma_h;
     int nb_planes;
+
+    int nb_threads;
+    int next_mb_row;                    ///< next row to search, for wavefront motion estimation
+    atomic_int *mb_row_progress;        ///< searched blocks per row, for wavefront motion estimation
+#if HAVE_THREADS
+    pthread_mutex_t progress_mutex;
+    pthread_cond_t progress_cond;
+#endif
 } MIContext;
 
+typedef struct ThreadData {
+    AVFrame *out;
+    Block *blocks;
+    int dir;
+    int alpha;
+    int pred_x, pred_y;
+} ThreadData;
+
 #define OFFSET(x) offsetof(MIContext, x)
 #define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
 #define CONST(name, help, val, unit) { name, help, 0, AV_OPT_TYPE_CONST, {.i64=val}, 0, 0, FLAGS, unit }
@@ -262,7 +281,7 @@ static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int
     int linesize = me_ctx->linesize;
     int mv_x1 = x_mv - x;
     int mv_y1 = y_mv - y;
-    int mv_x, mv_y, i, j;
+    int mv_x, mv_y, i, j, n;
     uint64_t sbad = 0;
 
     x = av_clip(x, me_ctx->x_min, me_ctx->x_max);
@@ -273,9 +292,13 @@ static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int
     data_cur += (y + mv_y) * linesize;
     data_next += (y - mv_y) * linesize;
 
-    for (j = 0; j < me_ctx->mb_size; j++)
-        for (i = 0; i < me_ctx->mb_size; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + j * linesize] - data_next[x - mv_x + i + j * linesize]);
+    n = av_log2(me_ctx->mb_size);
+    if (me_ctx->sad[n])
+        sbad = me_ctx->sad[n](data_cur + x + mv_x, linesize, data_next + x - mv_x, linesize);
+    else
+        for (j = 0; j < me_ctx->mb_size; j++)
+            for (i = 0; i < me_ctx->mb_size; i++)
+                sbad += FFABS(data_cur[x + mv_x + i + j * linesize] - data_next[x - mv_x + i + j * linesize]);
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -291,7 +314,7 @@ static uint64_t get_sbad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv,
     int y_max = me_ctx->y_max - me_ctx->mb_size / 2;
     int mv_x1 = x_mv - x;
     int mv_y1 = y_mv - y;
-    int mv_x, mv_y, i, j;
+    int mv_x, mv_y, i, j, n;
     uint64_t sbad = 0;
 
     x = av_clip(x, x_min, x_max);
@@ -299,9 +322,15 @@ static uint64_t get_sbad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv,
     mv_x = av_clip(x_mv - x, -FFMIN(x - x_min, x_max - x), FFMIN(x - x_min, x_max - x));
     mv_y = av_clip(y_mv - y, -FFMIN(y - y_min, y_max - y), FFMIN(y - y_min, y_max - y));
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + (y + mv_y + j) * linesize] - data_next[x - mv_x + i + (y - mv_y + j) * linesize]);
+    /* the overlapped window is twice the block size, except for 1x1 blocks */
+    n = av_log2(me_ctx->mb_size) + 1;
+    if (me_ctx->mb_size > 1 && n < FF_ARRAY_ELEMS(me_ctx->sad) && me_ctx->sad[n])
+        sbad = me_ctx->sad[n](data_cur  + x + mv_x - me_ctx->mb_size / 2 + (y + mv_y - me_ctx->mb_size / 2) * linesize, linesize,
+                              data_next + x - mv_x - me_ctx->mb_size / 2 + (y - mv_y - me_ctx->mb_size / 2) * linesize, linesize);
+    else
+        for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
+            for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
+                sbad += FFABS(data_cur[x + mv_x + i + (y + mv_y + j) * linesize] - data_next[x - mv_x + i + (y - mv_y + j) * linesize]);
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -317,7 +346,7 @@ static uint64_t get_sad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv, i
     int y_max = me_ctx->y_max - me_ctx->mb_size / 2;
     int mv_x = x_mv - x;
     int mv_y = y_mv - y;
-    int i, j;
+    int i, j, n;
     uint64_t sad = 0;
 
     x = av_clip(x, x_min, x_max);
@@ -325,9 +354,14 @@ static uint64_t get_sad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv, i
     x_mv = av_clip(x_mv, x_min, x_max);
     y_mv = av_clip(y_mv, y_min, y_max);
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sad += FFABS(data_ref[x_mv + i + (y_mv + j) * linesize] - data_cur[x + i + (y + j) * linesize]);
+    n = av_log2(me_ctx->mb_size) + 1;
+    if (me_ctx->mb_size > 1 && n < FF_ARRAY_ELEMS(me_ctx->sad) && me_ctx->sad[n])
+        sad = me_ctx->sad[n](data_ref + x_mv - me_ctx->mb_size / 2 + (y_mv - me_ctx->mb_size / 2) * linesize, linesize,
+                             data_cur + x    - me_ctx->mb_size / 2 + (y    - me_ctx->mb_size / 2) * linesize, linesize);
+    else
+        for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
+            for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
+                sad += FFABS(data_ref[x_mv + i + (y_mv + j) * linesize] - data_cur[x + i + (y + j) * linesize]);
 
     return sad + (FFABS(mv_x - me_ctx->pred_x) + FFABS(mv_y - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -345,6 +379,7 @@ static int config_input(AVFilterLink *inlink)
     mi_ctx->log2_chroma_w = desc->log2_chroma_w;
 
     mi_ctx->nb_planes = av_pix_fmt_count_planes(inlink->format);
+    mi_ctx->nb_threads = ff_filter_get_nb_threads(inlink->dst);
 
     mi_ctx->log2_mb_size = av_ceil_log2_c(mi_ctx->mb_size);
     mi_ctx->mb_size = 1 << mi_ctx->log2_mb_size;
@@ -373,6 +408,9 @@ static int config_input(AVFilterLink *inlink)
             if (!(mi_ctx->int_blocks = av_mallocz_array(mi_ctx->b_count, sizeof(Block))))
                 return AVERROR(ENOMEM);
 
+        if (!(mi_ctx->mb_row_progress = av_malloc_array(FFMAX(mi_ctx->b_height, 1), sizeof(*mi_ctx->mb_row_progress))))
+            return AVERROR(ENOMEM);
+
         if (mi_ctx->me_method == AV_ME_METHOD_EPZS) {
             for (i = 0; i < 3; i++) {
                 mi_ctx->mv_table[i] = av_mallocz_array(mi_ctx->b_count, sizeof(*mi_ctx->mv_table[0]));
@@ -422,9 +460,8 @@ static int config_output(AVFilterLink *outlink)
         preds.nb++;\
     } while(0)
 
-static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int dir)
+static void search_mv(MIContext *mi_ctx, AVMotionEstContext *me_ctx, Block *blocks, int mb_x, int mb_y, int dir)
 {
-    AVMotionEstContext *me_ctx = &mi_ctx->me_ctx;
     AVMotionEstPredictor *preds = me_ctx->preds;
     Block *block = &blocks[mb_x + mb_y * mi_ctx->b_width];
 
@@ -564,14 +601,52 @@ static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int
     block->mvs[dir][1] = mv[1] - y_mb;
 }
 
-static void bilateral_me(MIContext *mi_ctx)
+#if HAVE_THREADS
+static void report_progress(MIContext *mi_ctx, int mb_y, int n)
 {
-    Block *block;
-    int mb_x, mb_y;
+    pthread_mutex_lock(&mi_ctx->progress_mutex);
+    atomic_store_explicit(&mi_ctx->mb_row_progress[mb_y], n, memory_order_release);
+    pthread_cond_broadcast(&mi_ctx->progress_cond);
+    pthread_mutex_unlock(&mi_ctx->progress_mutex);
+}
 
-    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-            block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+static void await_progress(MIContext *mi_ctx, int mb_y, int n)
+{
+    if (atomic_load_explicit(&mi_ctx->mb_row_progress[mb_y], memory_order_acquire) >= n)
+        return;
+
+    pthread_mutex_lock(&mi_ctx->progress_mutex);
+    while (atomic_load_explicit(&mi_ctx->mb_row_progress[mb_y], memory_order_relaxed) < n)
+        pthread_cond_wait(&mi_ctx->progress_cond, &mi_ctx->progress_mutex);
+    pthread_mutex_unlock(&mi_ctx->progress_mutex);
+}
+
+static int next_mb_row(MIContext *mi_ctx)
+{
+    int mb_y;
+
+    pthread_mutex_lock(&mi_ctx->progress_mutex);
+    mb_y = mi_ctx->next_mb_row++;
+    pthread_mutex_unlock(&mi_ctx->progress_mutex);
+    return mb_y;
+}
+#else
+static void report_progress(MIContext *mi_ctx, int mb_y, int n) { }
+static void await_progress(MIContext *mi_ctx, int mb_y, int n) { }
+static int next_mb_row(MIContext *mi_ctx) { return mi_ctx->next_mb_row++; }
+#endif
+
+static void search_mv_row(MIContext *mi_ctx, AVMotionEstContext *me_ctx,
+                          ThreadData *td, int mb_y, int wavefront)
+{
+    int mb_x;
+
+    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+        if (wavefront && mb_y > 0)
+            await_progress(mi_ctx, mb_y - 1, FFMIN(mb_x + 2, mi_ctx->b_width));
+
+        if (mi_ctx->me_mode == ME_MODE_BILAT) {
+            Block *block = &td->blocks[mb_x + mb_y * mi_ctx->b_width];
 
             block->cid = 0;
             block->sb = 0;
@@ -580,9 +655,84 @@ static void bilateral_me(MIContext *mi_ctx)
             block->mvs[0][1] = 0;
         }
 
-    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-            search_mv(mi_ctx, mi_ctx->int_blocks, mb_x, mb_y, 0);
+        search_mv(mi_ctx, me_ctx, td->blocks, mb_x, mb_y, td->dir);
+
+        if (wavefront)
+            report_progress(mi_ctx, mb_y, mb_x + 1);
+    }
+
+    /* later costs are computed with the predictor of the last block */
+    if (mb_y == mi_ctx->b_height - 1) {
+        td->pred_x = me_ctx->pred_x;
+        td->pred_y = me_ctx->pred_y;
+    }
+}
+
+static int search_mv_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    AVMotionEstContext me_ctx = mi_ctx->me_ctx;
+    int mb_y;
+
+    if (mi_ctx->me_method == AV_ME_METHOD_EPZS || mi_ctx->me_method == AV_ME_METHOD_UMH) {
+        /* EPZS and UMH predict from the left, top and top-right blocks, so
+         * rows are searched as a wavefront, each row trailing the one above
+         * by two blocks. Rows are taken in order by whichever job is free,
+         * so a row only waits on rows already taken by running jobs and
+         * the search also completes when the jobs run one after another. */
+        while ((mb_y = next_mb_row(mi_ctx)) < mi_ctx->b_height)
+            search_mv_row(mi_ctx, &me_ctx, td, mb_y, nb_jobs > 1);
+    } else {
+        const int slice_start = (mi_ctx->b_height *  jobnr     ) / nb_jobs;
+        const int slice_end   = (mi_ctx->b_height * (jobnr + 1)) / nb_jobs;
+
+        for (mb_y = slice_start; mb_y < slice_end; mb_y++)
+            search_mv_row(mi_ctx, &me_ctx, td, mb_y, 0);
+    }
+
+    emms_c();
+    return 0;
+}
+
+static void motion_search(AVFilterContext *ctx, Block *blocks, int dir)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData td;
+    int i;
+
+    td.blocks = blocks;
+    td.dir = dir;
+    td.pred_x = mi_ctx->me_ctx.pred_x;
+    td.pred_y = mi_ctx->me_ctx.pred_y;
+
+    mi_ctx->next_mb_row = 0;
+    for (i = 0; i < mi_ctx->b_height; i++)
+        atomic_init(&mi_ctx->mb_row_progress[i], 0);
+    ctx->internal->execute(ctx, search_mv_slice, &td, NULL, av_clip(mi_ctx->b_height, 1, mi_ctx->nb_threads));
+
+    mi_ctx->me_ctx.pred_x = td.pred_x;
+    mi_ctx->me_ctx.pred_y = td.pred_y;
+}
+
+static int block_sbad_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    const int slice_start = (mi_ctx->b_height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (mi_ctx->b_height * (jobnr + 1)) / nb_jobs;
+    int mb_x, mb_y;
+
+    for (mb_y = slice_start; mb_y < slice_end; mb_y++)
+        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+            int x_mb = mb_x << mi_ctx->log2_mb_size;
+            int y_mb = mb_y << mi_ctx->log2_mb_size;
+            Block *block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+
+            block->sbad = get_sbad(&mi_ctx->me_ctx, x_mb, y_mb, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1]);
+        }
+
+    emms_c();
+    return 0;
 }
 
 static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n)
@@ -765,9 +915,7 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
                     mi_ctx->me_ctx.data_cur = mi_ctx->frames[2].avf->data[0];
                     mi_ctx->me_ctx.data_ref = mi_ctx->frames[dir ? 3 : 1].avf->data[0];
 
-                    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-                            search_mv(mi_ctx, mi_ctx->frames[2].blocks, mb_x, mb_y, dir);
+                    motion_search(ctx, mi_ctx->frames[2].blocks, dir);
                 }
             }
 
@@ -782,19 +930,11 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
             mi_ctx->me_ctx.data_cur = mi_ctx->frames[1].avf->data[0];
             mi_ctx->me_ctx.data_ref = mi_ctx->frames[2].avf->data[0];
 
-            bilateral_me(mi_ctx);
+            motion_search(ctx, mi_ctx->int_blocks, 0);
 
-            if (mi_ctx->mc_mode == MC_MODE_AOBMC) {
-
-                for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-                        int x_mb = mb_x << mi_ctx->log2_mb_size;
-                        int y_mb = mb_y << mi_ctx->log2_mb_size;
-                        block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
-
-                        block->sbad = get_sbad(&mi_ctx->me_ctx, x_mb, y_mb, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1]);
-                    }
-            }
+            if (mi_ctx->mc_mode == MC_MODE_AOBMC)
+                ctx->internal->execute(ctx, block_sbad_slice, NULL, NULL,
+                                       av_clip(mi_ctx->b_height, 1, mi_ctx->nb_threads));
 
             if (mi_ctx->vsbmc) {
 
@@ -814,7 +954,9 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
 
                 mi_ctx->clusters[0].nb = mi_ctx->b_count;
 
-                if (ret = cluster_mvs(mi_ctx))
+                ret = cluster_mvs(mi_ctx);
+                emms_c();
+                if (ret)
                     return ret;
             }
         }
@@ -863,17 +1005,13 @@ static int detect_scene_change(MIContext *mi_ctx)
         pixel_refs->nb++;\
     } while(0)
 
-static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
+static void bidirectional_obmc(MIContext *mi_ctx, int alpha, int slice_start, int slice_end)
 {
     int x, y;
     int width = mi_ctx->frames[0].avf->width;
     int height = mi_ctx->frames[0].avf->height;
     int mb_y, mb_x, dir;
 
-    for (y = 0; y < height; y++)
-        for (x = 0; x < width; x++)
-            mi_ctx->pixel_refs[x + y * width].nb = 0;
-
     for (dir = 0; dir < 2; dir++)
         for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
             for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
@@ -887,9 +1025,9 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
                 start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2 + mv_y * a / ALPHA_MAX;
 
                 startc_x = av_clip(start_x, 0, width - 1);
-                startc_y = av_clip(start_y, 0, height - 1);
+                startc_y = av_clip(start_y, slice_start, slice_end);
                 endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
-                endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
+                endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), slice_start, FFMIN(slice_end, height - 1));
 
                 if (dir) {
                     mv_x = -mv_x;
@@ -913,16 +1051,15 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
             }
 }
 
-static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out)
+static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out, int slice_start, int slice_end)
 {
     int x, y, plane;
 
     for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
         int width = avf_out->width;
-        int height = avf_out->height;
         int chroma = plane == 1 || plane == 2;
 
-        for (y = 0; y < height; y++)
+        for (y = slice_start; y < slice_end; y++)
             for (x = 0; x < width; x++) {
                 int x_mv, y_mv;
                 int weight_sum = 0;
@@ -971,7 +1108,8 @@ static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out)
     }
 }
 
-static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n, int alpha)
+static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n, int alpha,
+                         int slice_start, int slice_end)
 {
     int sb_x, sb_y;
     int width = mi_ctx->frames[0].avf->width;
@@ -982,16 +1120,17 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
             Block *sb = &block->subs[sb_x + sb_y * 2];
 
             if (sb->sb)
-                var_size_bmc(mi_ctx, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha);
+                var_size_bmc(mi_ctx, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha,
+                             slice_start, slice_end);
             else {
                 int x, y;
                 int mv_x = sb->mvs[0][0] * 2;
                 int mv_y = sb->mvs[0][1] * 2;
 
                 int start_x = x_mb + (sb_x << (n - 1));
-                int start_y = y_mb + (sb_y << (n - 1));
+                int start_y = FFMAX(y_mb + (sb_y << (n - 1)), slice_start);
                 int end_x = start_x + (1 << (n - 1));
-                int end_y = start_y + (1 << (n - 1));
+                int end_y = FFMIN(y_mb + (sb_y << (n - 1)) + (1 << (n - 1)), slice_end);
 
                 for (y = start_y; y < end_y; y++)  {
                     int y_min = -y;
@@ -1010,7 +1149,8 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
         }
 }
 
-static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y, int alpha)
+static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y, int alpha,
+                           int slice_start, int slice_end)
 {
     int x, y;
     int width = mi_ctx->frames[0].avf->width;
@@ -1039,9 +1179,9 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
 
     startc_x = av_clip(start_x, 0, width - 1);
-    startc_y = av_clip(start_y, 0, height - 1);
+    startc_y = av_clip(start_y, slice_start, slice_end);
     endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
-    endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
+    endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), slice_start, FFMIN(slice_end, height - 1));
 
     for (y = startc_y; y < endc_y; y++) {
         int y_min = -y;
@@ -1074,13 +1214,97 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     }
 }
 
+static int blend_frames_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *avf_out = td->out;
+    int alpha = td->alpha;
+    int x, y, plane;
+
+    for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
+        int width = avf_out->width;
+        int height = avf_out->height;
+        int slice_start, slice_end;
+
+        if (plane == 1 || plane == 2) {
+            width = AV_CEIL_RSHIFT(width, mi_ctx->log2_chroma_w);
+            height = AV_CEIL_RSHIFT(height, mi_ctx->log2_chroma_h);
+        }
+
+        slice_start = (height *  jobnr     ) / nb_jobs;
+        slice_end   = (height * (jobnr + 1)) / nb_jobs;
+
+        for (y = slice_start; y < slice_end; y++) {
+            for (x = 0; x < width; x++) {
+                avf_out->data[plane][x + y * avf_out->linesize[plane]] =
+                    (alpha  * mi_ctx->frames[2].avf->data[plane][x + y * mi_ctx->frames[2].avf->linesize[plane]] +
+                     (ALPHA_MAX - alpha) * mi_ctx->frames[1].avf->data[plane][x + y * mi_ctx->frames[1].avf->linesize[plane]] + 512) >> 10;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int mci_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *avf_out = td->out;
+    int width = avf_out->width;
+    int height = avf_out->height;
+    /* chroma samples are written from every luma row they cover,
+     * keep those rows in the same slice */
+    const int slice_start = (height * jobnr / nb_jobs) >> mi_ctx->log2_chroma_h << mi_ctx->log2_chroma_h;
+    const int slice_end   = jobnr == nb_jobs - 1 ? height :
+                            (height * (jobnr + 1) / nb_jobs) >> mi_ctx->log2_chroma_h << mi_ctx->log2_chroma_h;
+    int x, y;
+
+    for (y = slice_start; y < slice_end; y++)
+        for (x = 0; x < width; x++)
+            mi_ctx->pixel_refs[x + y * width].nb = 0;
+
+    /* every slice walks all blocks in the same order and only adds the
+     * pixels in its rows, the output does not depend on the slicing */
+    if (mi_ctx->me_mode == ME_MODE_BIDIR) {
+        bidirectional_obmc(mi_ctx, td->alpha, slice_start, slice_end);
+
+    } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
+        int mb_x, mb_y;
+        Block *block;
+
+        for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++) {
+            int y_mb = mb_y << mi_ctx->log2_mb_size;
+
+            if (y_mb + mi_ctx->mb_size * 3 / 2 <= slice_start || y_mb - mi_ctx->mb_size / 2 >= slice_end)
+                continue;
+
+            for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+                block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+
+                if (block->sb)
+                    var_size_bmc(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, y_mb, mi_ctx->log2_mb_size, td->alpha,
+                                 slice_start, slice_end);
+
+                bilateral_obmc(mi_ctx, block, mb_x, mb_y, td->alpha, slice_start, slice_end);
+            }
+        }
+    }
+
+    set_frame_data(mi_ctx, td->alpha, avf_out, slice_start, slice_end);
+
+    emms_c();
+    return 0;
+}
+
 static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
 {
     AVFilterContext *ctx = inlink->dst;
     AVFilterLink *outlink = ctx->outputs[0];
     MIContext *mi_ctx = ctx->priv;
-    int x, y;
-    int plane, alpha;
+    ThreadData td;
+    int alpha;
     int64_t pts;
 
     pts = av_rescale(avf_out->pts, (int64_t) ALPHA_MAX * outlink->time_base.num * inlink->time_base.den,
@@ -1100,57 +1324,22 @@ static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
         return;
     }
 
+    td.out = avf_out;
+    td.alpha = alpha;
+
     switch(mi_ctx->mi_mode) {
         case MI_MODE_DUP:
             av_frame_copy(avf_out, alpha > ALPHA_MAX / 2 ? mi_ctx->frames[2].avf : mi_ctx->frames[1].avf);
 
             break;
         case MI_MODE_BLEND:
-            for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
-                int width = avf_out->width;
-                int height = avf_out->height;
-
-                if (plane == 1 || plane == 2) {
-                    width = AV_CEIL_RSHIFT(width, mi_ctx->log2_chroma_w);
-                    height = AV_CEIL_RSHIFT(height, mi_ctx->log2_chroma_h);
-                }
-
-                for (y = 0; y < height; y++) {
-                    for (x = 0; x < width; x++) {
-                        avf_out->data[plane][x + y * avf_out->linesize[plane]] =
-                            (alpha  * mi_ctx->frames[2].avf->data[plane][x + y * mi_ctx->frames[2].avf->linesize[plane]] +
-                             (ALPHA_MAX - alpha) * mi_ctx->frames[1].avf->data[plane][x + y * mi_ctx->frames[1].avf->linesize[plane]] + 512) >> 10;
-                    }
-                }
-            }
+            ctx->internal->execute(ctx, blend_frames_slice, &td, NULL,
+                                   FFMIN(AV_CEIL_RSHIFT(avf_out->height, mi_ctx->log2_chroma_h), mi_ctx->nb_threads));
 
             break;
         case MI_MODE_MCI:
-            if (mi_ctx->me_mode == ME_MODE_BIDIR) {
-                bidirectional_obmc(mi_ctx, alpha);
-                set_frame_data(mi_ctx, alpha, avf_out);
-
-            } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
-                int mb_x, mb_y;
-                Block *block;
-
-                for (y = 0; y < mi_ctx->frames[0].avf->height; y++)
-                    for (x = 0; x < mi_ctx->frames[0].avf->width; x++)
-                        mi_ctx->pixel_refs[x + y * mi_ctx->frames[0].avf->width].nb = 0;
-
-                for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-                        block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
-
-                        if (block->sb)
-                            var_size_bmc(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size, alpha);
-
-                        bilateral_obmc(mi_ctx, block, mb_x, mb_y, alpha);
-
-                    }
-
-                set_frame_data(mi_ctx, alpha, avf_out);
-            }
+            ctx->internal->execute(ctx, mci_slice, &td, NULL,
+                                   av_clip(avf_out->height >> mi_ctx->log2_chroma_h, 1, mi_ctx->nb_threads));
 
             break;
     }
@@ -1206,6 +1395,23 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *avf_in)
     return 0;
 }
 
+static av_cold int init(AVFilterContext *ctx)
+{
+#if HAVE_THREADS
+    MIContext *mi_ctx = ctx->priv;
+    int ret;
+
+    if ((ret = pthread_mutex_init(&mi_ctx->progress_mutex, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&mi_ctx->progress_cond, NULL))) {
+        pthread_mutex_destroy(&mi_ctx->progress_mutex);
+        return AVERROR(ret);
+    }
+#endif
+
+    return 0;
+}
+
 static av_cold void free_blocks(Block *block, int sb)
 {
     if (block->subs)
@@ -1235,6 +1441,12 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     for (i = 0; i < 3; i++)
         av_freep(&mi_ctx->mv_table[i]);
+
+    av_freep(&mi_ctx->mb_row_progress);
+#if HAVE_THREADS
+    pthread_mutex_destroy(&mi_ctx->progress_mutex);
+    pthread_cond_destroy(&mi_ctx->progress_cond);
+#endif
 }
 
 static const AVFilterPad minterpolate_inputs[] = {
@@ -1261,8 +1473,10 @@ AVFilter ff_vf_minterpolate = {
     .description   = NULL_IF_CONFIG_SMALL("Frame rate conversion using Motion Interpolation."),
     .priv_size     = sizeof(MIContext),
     .priv_class    = &minterpolate_class,
+    .init          = init,
     .uninit        = uninit,
     .query_formats = query_formats,
     .inputs        = minterpolate_inputs,
     .outputs       = minterpolate_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -0,0 +1,351 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * video scene change detection filter
+ *
+ * The luma plane of every frame is box filtered down to a small plane. The
+ * score of a frame is computed from the SAD against the downscaled previous
+ * frame and from the difference of the luma histograms of both.
+ *
+ * Frames are analyzed in batches, one frame per slice thread job, and are
+ * output in their original order.
+ */
+
+#include "libavutil/opt.h"
+#include "libavutil/timestamp.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "scene_sad.h"
+#include "video.h"
+
+#define MAX_BATCH 64
+
+typedef struct SCDetContext {
+    const AVClass *class;
+
+    double threshold;
+    int sc_pass;
+    int downscale;
+    int batch;
+
+    int nb_batch;                   ///< number of frames analyzed together
+    int shift;                      ///< log2 of the downscaling factor in use
+    int width, height;              ///< size of the downscaled luma plane
+    ff_scene_sad_fn sad;
+
+    /* slot 0 of planes and hist holds the last frame of the previous batch */
+    AVFrame *frames[MAX_BATCH + 1];
+    uint8_t *planes;                ///< downscaled luma planes, one per slot
+    uint32_t (*hist)[256];          ///< luma histograms, one per slot
+    uint64_t sads[MAX_BATCH];
+    uint64_t hist_diffs[MAX_BATCH];
+    int nb_frames;
+    int has_prev;
+    double prev_mafd;
+
+    int eof;
+    int64_t eof_pts;
+} SCDetContext;
+
+#define OFFSET(x) offsetof(SCDetContext, x)
+#define V AV_OPT_FLAG_VIDEO_PARAM
+#define F AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption scdet_options[] = {
+    { "threshold", "set the scene change threshold", OFFSET(threshold), AV_OPT_TYPE_DOUBLE, {.dbl=0.3}, 0, 1, V|F },
+    { "t",         "set the scene change threshold", OFFSET(threshold), AV_OPT_TYPE_DOUBLE, {.dbl=0.3}, 0, 1, V|F },
+    { "sc_pass",   "only pass scene change frames",  OFFSET(sc_pass),   AV_OPT_TYPE_BOOL,   {.i64=0},   0, 1, V|F },
+    { "s",         "only pass scene change frames",  OFFSET(sc_pass),   AV_OPT_TYPE_BOOL,   {.i64=0},   0, 1, V|F },
+    { "downscale", "set log2 of the luma downscaling factor", OFFSET(downscale), AV_OPT_TYPE_INT, {.i64=2}, 0, 4, V|F },
+    { "batch",     "set the number of frames analyzed in parallel", OFFSET(batch), AV_OPT_TYPE_INT, {.i64=0}, 0, MAX_BATCH, V|F },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(scdet);
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_GRAY8,
+        AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P,
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
+        AV_PIX_FMT_YUV440P, AV_PIX_FMT_YUV444P,
+        AV_PIX_FMT_YUVJ411P, AV_PIX_FMT_YUVJ420P,
+        AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ440P,
+        AV_PIX_FMT_YUVJ444P,
+        AV_PIX_FMT_YUVA420P, AV_PIX_FMT_YUVA422P,
+        AV_PIX_FMT_YUVA444P,
+        AV_PIX_FMT_NV12, AV_PIX_FMT_NV21,
+        AV_PIX_FMT_NONE
+    };
+
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+    if (!fmts_list)
+        return AVERROR(ENOMEM);
+    return ff_set_common_formats(ctx, fmts_list);
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    SCDetContext *s = ctx->priv;
+
+    s->shift = s->downscale;
+    while (s->shift && (inlink->w >> s->shift < 1 || inlink->h >> s->shift < 1))
+        s->shift--;
+    s->width  = inlink->w >> s->shift;
+    s->height = inlink->h >> s->shift;
+
+    s->nb_batch = s->batch ? s->batch : FFMIN(ff_filter_get_nb_threads(ctx), MAX_BATCH);
+
+    s->sad = ff_scene_sad_get_fn(8);
+    if (!s->sad)
+        return AVERROR(EINVAL);
+
+    av_freep(&s->planes);
+    av_freep(&s->hist);
+    s->planes = av_malloc_array(s->nb_batch + 1, s->width * s->height);
+    s->hist   = av_malloc_array(s->nb_batch + 1, sizeof(*s->hist));
+    if (!s->planes || !s->hist)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    SCDetContext *s = ctx->priv;
+    int i;
+
+    for (i = 1; i <= s->nb_frames; i++)
+        av_frame_free(&s->frames[i]);
+    av_freep(&s->planes);
+    av_freep(&s->hist);
+}
+
+/**
+ * Downscale the luma plane of one frame of the batch into its slot and
+ * build its histogram.
+ */
+static int analyze_frame(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SCDetContext *s = ctx->priv;
+    const AVFrame *frame = s->frames[jobnr + 1];
+    const ptrdiff_t linesize = frame->linesize[0];
+    const int shift = s->shift;
+    const int block = 1 << shift;
+    const int round = (1 << 2 * shift) >> 1;
+    uint8_t *dst = s->planes + (jobnr + 1) * s->width * s->height;
+    uint32_t *hist = s->hist[jobnr + 1];
+    int x, y, i, j;
+
+    memset(hist, 0, sizeof(s->hist[0]));
+
+    for (y = 0; y < s->height; y++) {
+        const uint8_t *src = frame->data[0] + (y << shift) * linesize;
+
+        if (!shift) {
+            memcpy(dst, src, s->width);
+        } else {
+            for (x = 0; x < s->width; x++) {
+                const uint8_t *p = src + (x << shift);
+                unsigned sum = 0;
+
+                for (i = 0; i < block; i++, p += linesize)
+                    for (j = 0; j < block; j++)
+                        sum += p[j];
+                dst[x] = (sum + round) >> 2 * shift;
+            }
+        }
+        for (x = 0; x < s->width; x++)
+            hist[dst[x]]++;
+        dst += s->width;
+    }
+
+    return 0;
+}
+
+/**
+ * Compare one frame of the batch against the frame before it.
+ */
+static int compare_frame(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SCDetContext *s = ctx->priv;
+    const int size = s->width * s->height;
+    const uint32_t *hist1 = s->hist[jobnr];
+    const uint32_t *hist2 = s->hist[jobnr + 1];
+    uint64_t hist_diff = 0;
+    int i;
+
+    if (!jobnr && !s->has_prev)
+        return 0;
+
+    s->sad(s->planes + jobnr * size, s->width,
+           s->planes + (jobnr + 1) * size, s->width,
+           s->width, s->height, &s->sads[jobnr]);
+    emms_c();
+
+    for (i = 0; i < 256; i++)
+        hist_diff += FFABS((int64_t)hist1[i] - hist2[i]);
+    s->hist_diffs[jobnr] = hist_diff;
+
+    return 0;
+}
+
+static int set_meta(AVFrame *frame, const char *key, double value)
+{
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "%f", value);
+    return av_dict_set(&frame->metadata, key, buf, 0);
+}
+
+static int filter_batch(AVFilterContext *ctx)
+{
+    SCDetContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    const int size = s->width * s->height;
+    const int nb_frames = s->nb_frames;
+    int i, ret = 0;
+
+    ctx->internal->execute(ctx, analyze_frame, NULL, NULL, nb_frames);
+    ctx->internal->execute(ctx, compare_frame, NULL, NULL, nb_frames);
+
+    for (i = 0; i < nb_frames; i++) {
+        AVFrame *frame = s->frames[i + 1];
+        double mafd = 0, hist = 0, score = 0;
+
+        s->frames[i + 1] = NULL;
+        if (ret < 0) {
+            av_frame_free(&frame);
+            continue;
+        }
+
+        if (i || s->has_prev) {
+            double diff;
+
+            mafd  = (double)s->sads[i] * 100. / size / 256;
+            diff  = fabs(mafd - s->prev_mafd);
+            hist  = (double)s->hist_diffs[i] / (2 * size);
+            score = (av_clipf(FFMIN(mafd, diff) / 100., 0, 1) + hist) / 2;
+            s->prev_mafd = mafd;
+        }
+
+        set_meta(frame, "lavfi.scd.mafd", mafd);
+        set_meta(frame, "lavfi.scd.hist", hist);
+        set_meta(frame, "lavfi.scd.score", score);
+
+        if (score >= s->threshold && (i || s->has_prev)) {
+            av_dict_set(&frame->metadata, "lavfi.scd.time",
+                        av_ts2timestr(frame->pts, &inlink->time_base), 0);
+            av_log(ctx, AV_LOG_INFO, "lavfi.scd.score: %.3f, lavfi.scd.time: %s\n",
+                   score, av_ts2timestr(frame->pts, &inlink->time_base));
+        } else if (s->sc_pass) {
+            av_frame_free(&frame);
+            continue;
+        }
+
+        ret = ff_filter_frame(outlink, frame);
+    }
+
+    memcpy(s->planes, s->planes + nb_frames * size, size);
+    memcpy(s->hist[0], s->hist[nb_frames], sizeof(s->hist[0]));
+    s->has_prev  = 1;
+    s->nb_frames = 0;
+
+    return ret;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    SCDetContext *s = ctx->priv;
+    AVFrame *frame;
+    int64_t pts;
+    int ret, status;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    while (s->nb_frames < s->nb_batch) {
+        ret = ff_inlink_consume_frame(inlink, &frame);
+        if (ret < 0)
+            return ret;
+        if (!ret)
+            break;
+        s->frames[++s->nb_frames] = frame;
+    }
+
+    if (!s->eof && ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        s->eof     = status;
+        s->eof_pts = pts;
+    }
+
+    if (s->nb_frames == s->nb_batch || (s->eof && s->nb_frames)) {
+        ret = filter_batch(ctx);
+        if (ret < 0)
+            return ret;
+        ff_filter_set_ready(ctx, 100);
+        return 0;
+    }
+
+    if (s->eof) {
+        ff_outlink_set_status(outlink, s->eof, s->eof_pts);
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+
+static const AVFilterPad scdet_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+    },
+    { NULL }
+};
+
+static const AVFilterPad scdet_outputs[] = {
+    {
+        .name = "default",
+        .type = AVMEDIA_TYPE_VIDEO,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_scdet = {
+    .name          = "scdet",
+    .description   = NULL_IF_CONFIG_SMALL("Detect video scene change."),
+    .priv_size     = sizeof(SCDetContext),
+    .priv_class    = &scdet_class,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = scdet_inputs,
+    .outputs       = scdet_outputs,
+    .activate      = activate,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
+};
@@ -35,6 +35,7 @@
 #include "internal.h"
 #include "signature.h"
 #include "signature_lookup.c"
+#include "signature_index.c"
 
 #define OFFSET(x) offsetof(SignatureContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM
@@ -64,6 +65,14 @@ static const AVOption signature_options[] = {
         OFFSET(thdi),         AV_OPT_TYPE_INT,    {.i64 = 0},        0, INT_MAX,          FLAGS },
     { "th_it",      "threshold for relation of good to all frames",
         OFFSET(thit),         AV_OPT_TYPE_DOUBLE, {.dbl = 0.5},    0.0, 1.0,              FLAGS },
+    { "index",      "coarse signature index file",
+        OFFSET(index_filename), AV_OPT_TYPE_STRING, {.str = ""},     0, 0,                FLAGS },
+    { "index_add",  "add the signatures to the index",
+        OFFSET(index_add),    AV_OPT_TYPE_BOOL,   {.i64 = 0},        0, 1,                FLAGS },
+    { "index_name", "name of the videos in the index",
+        OFFSET(index_name),   AV_OPT_TYPE_STRING, {.str = ""},       0, 0,                FLAGS },
+    { "th_index",   "threshold to detect coarse signatures in the index as similar",
+        OFFSET(thindex),      AV_OPT_TYPE_DOUBLE, {.dbl = 0.3},    0.0, 1.0,              FLAGS },
     { NULL }
 };
 
@@ -92,6 +101,7 @@ static int config_input(AVFilterLink *inlink)
     AVFilterContext *ctx = inlink->dst;
     SignatureContext *sic = ctx->priv;
     StreamContext *sc = &(sic->streamcontexts[FF_INLINK_IDX(inlink)]);
+    int i;
 
     sc->time_base = inlink->time_base;
     /* test for overflow */
@@ -101,6 +111,9 @@ static int config_input(AVFilterLink *inlink)
     }
     sc->w = inlink->w;
     sc->h = inlink->h;
+    /* first column of each of the 32 block columns */
+    for (i = 0; i <= 32; i++)
+        sc->colstart[i] = (i * inlink->w + 31) / 32;
     return 0;
 }
 
@@ -137,6 +150,45 @@ static int cmp(const uint64_t *a, const uint64_t *b)
     return *a < *b ? -1 : ( *a > *b ? 1 : 0 );
 }
 
+typedef struct ThreadData {
+    const StreamContext *sc;
+    const AVFrame *in;
+    uint64_t (*intpic)[32];
+} ThreadData;
+
+/**
+ * Sum up the luma values of the 32x32 blocks of one band of block rows.
+ * Every job writes its own rows of intpic, so no reduction is needed.
+ */
+static int sum_blocks_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThreadData *td = arg;
+    const StreamContext *sc = td->sc;
+    const int slice_start = (32 *  jobnr     ) / nb_jobs;
+    const int slice_end   = (32 * (jobnr + 1)) / nb_jobs;
+    int i, j, x, y;
+
+    for (i = slice_start; i < slice_end; i++) {
+        const int y0 = (i * sc->h + 31) / 32;
+        const int y1 = ((i + 1) * sc->h + 31) / 32;
+        uint64_t *row = td->intpic[i];
+
+        for (y = y0; y < y1; y++) {
+            const uint8_t *p = td->in->data[0] + y * td->in->linesize[0];
+
+            for (j = 0; j < 32; j++) {
+                unsigned sum = 0;
+
+                for (x = sc->colstart[j]; x < sc->colstart[j + 1]; x++)
+                    sum += p[x];
+                row[j] += sum;
+            }
+        }
+    }
+
+    return 0;
+}
+
 /**
  * sets the bit at position pos to 1 in data
  */
@@ -163,9 +215,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     uint8_t wordt2b[5] = { 0, 0, 0, 0, 0 }; /* word ternary to binary */
     uint64_t intpic[32][32];
     uint64_t rowcount;
-    uint8_t *p = picref->data[0];
-    int inti, intj;
-    int *intjlut;
+    ThreadData td;
 
     uint64_t conflist[DIFFELEM_SIZE];
     int f = 0, g = 0, w = 0;
@@ -196,22 +246,11 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     fs->index = sc->lastindex++;
 
     memset(intpic, 0, sizeof(uint64_t)*32*32);
-    intjlut = av_malloc_array(inlink->w, sizeof(int));
-    if (!intjlut)
-        return AVERROR(ENOMEM);
-    for (i = 0; i < inlink->w; i++) {
-        intjlut[i] = (i*32)/inlink->w;
-    }
-
-    for (i = 0; i < inlink->h; i++) {
-        inti = (i*32)/inlink->h;
-        for (j = 0; j < inlink->w; j++) {
-            intj = intjlut[j];
-            intpic[inti][intj] += p[j];
-        }
-        p += picref->linesize[0];
-    }
-    av_freep(&intjlut);
+    td.sc = sc;
+    td.in = picref;
+    td.intpic = intpic;
+    ctx->internal->execute(ctx, sum_blocks_slice, &td, NULL,
+                           FFMIN(32, ff_filter_get_nb_threads(ctx)));
 
     /* The following calculates a summed area table (intpic) and brings the numbers
      * in intpic to the same denominator.
@@ -567,18 +606,28 @@ static int binary_export(AVFilterContext *ctx, StreamContext *sc, const char* fi
     return 0;
 }
 
-static int export(AVFilterContext *ctx, StreamContext *sc, int input)
+static int get_filename(AVFilterContext *ctx, char *filename, int size, const char *pattern, int input)
 {
     SignatureContext* sic = ctx->priv;
-    char filename[1024];
 
     if (sic->nb_inputs > 1) {
         /* error already handled */
-        av_assert0(av_get_frame_filename(filename, sizeof(filename), sic->filename, input) == 0);
+        av_assert0(av_get_frame_filename(filename, size, pattern, input) == 0);
     } else {
-        if (av_strlcpy(filename, sic->filename, sizeof(filename)) >= sizeof(filename))
+        if (av_strlcpy(filename, pattern, size) >= size)
             return AVERROR(EINVAL);
     }
+    return 0;
+}
+
+static int export(AVFilterContext *ctx, StreamContext *sc, int input)
+{
+    SignatureContext* sic = ctx->priv;
+    char filename[1024];
+    int ret;
+
+    if ((ret = get_filename(ctx, filename, sizeof(filename), sic->filename, input)) < 0)
+        return ret;
     if (sic->format == FORMAT_XML) {
         return xml_export(ctx, sc, filename);
     } else {
@@ -612,6 +661,18 @@ static int request_frame(AVFilterLink *outlink)
                 if (export(ctx, sc, i) < 0)
                     return ret;
             }
+            if (strlen(sic->index_filename) > 0) {
+                char name[1024];
+                int err;
+
+                if ((err = index_lookup(ctx, sic, sc, i)) < 0)
+                    return err;
+                if (sic->index_add) {
+                    if ((err = get_filename(ctx, name, sizeof(name), sic->index_name, i)) < 0 ||
+                        (err = index_append(ctx, sc, sic->index_filename, name)) < 0)
+                        return err;
+                }
+            }
             sc->exported = 1;
         }
         lookup &= sc->exported;
@@ -693,6 +754,19 @@ static av_cold int init(AVFilterContext *ctx)
         return AVERROR(EINVAL);
     }
 
+    if (strlen(sic->index_filename) > 0) {
+        if (sic->index_add && !strlen(sic->index_name)) {
+            av_log(ctx, AV_LOG_ERROR, "The index_name must be set to add signatures to the index.\n");
+            return AVERROR(EINVAL);
+        }
+        if (sic->index_add && sic->nb_inputs > 1 && av_get_frame_filename(tmp, sizeof(tmp), sic->index_name, 0) == -1) {
+            av_log(ctx, AV_LOG_ERROR, "The index_name must contain %%d or %%0nd, if you have more than one input.\n");
+            return AVERROR(EINVAL);
+        }
+        if ((ret = index_load(ctx, &sic->index, sic->index_filename)) < 0)
+            return ret;
+    }
+
     return 0;
 }
 
@@ -731,6 +805,7 @@ static av_cold void uninit(AVFilterContext *ctx)
         }
         av_freep(&sic->streamcontexts);
     }
+    index_free(&sic->index);
 }
 
 static int config_output(AVFilterLink *outlink)
@@ -767,5 +842,5 @@ AVFilter ff_vf_signature = {
     .query_formats = query_formats,
     .outputs       = signature_outputs,
     .inputs        = NULL,
-    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
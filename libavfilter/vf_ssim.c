@@ -59,13 +59,12 @@ typedef struct SSIMContext {
     uint8_t rgba_map[4];
     int planewidth[4];
     int planeheight[4];
-    int *temp;
+    int nb_threads;
+    void **temp;
+    double *score[4];
     int is_rgb;
-    float (*ssim_plane)(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max);
+    int (*ssim_plane)(AVFilterContext *ctx, void *arg,
+                      int jobnr, int nb_jobs);
     SSIMDSPContext dsp;
 } SSIMContext;
 
@@ -219,62 +218,103 @@ static float ssim_endn_8bit(const int (*sum0)[4], const int (*sum1)[4], int widt
     return ssim;
 }
 
+void ff_ssim_init(SSIMDSPContext *dsp)
+{
+    dsp->ssim_4x4_line = ssim_4x4xn_8bit;
+    dsp->ssim_end_line = ssim_endn_8bit;
+    if (ARCH_X86)
+        ff_ssim_init_x86(dsp);
+}
+
 #define SUM_LEN(w) (((w) >> 2) + 3)
 
-static float ssim_plane_16bit(SSIMDSPContext *dsp,
-                              uint8_t *main, int main_stride,
-                              uint8_t *ref, int ref_stride,
-                              int width, int height, void *temp,
-                              int max)
+typedef struct ThreadData {
+    const uint8_t *main_data[4];
+    const uint8_t *ref_data[4];
+    int main_linesize[4];
+    int ref_linesize[4];
+    int planewidth[4];
+    int planeheight[4];
+    double **score;
+    void **temp;
+    int nb_components;
+    int max;
+    SSIMDSPContext *dsp;
+} ThreadData;
+
+static int ssim_plane_16bit(AVFilterContext *ctx, void *arg,
+                            int jobnr, int nb_jobs)
 {
-    int z = 0, y;
-    float ssim = 0.0;
-    int64_t (*sum0)[4] = temp;
-    int64_t (*sum1)[4] = sum0 + SUM_LEN(width);
-
-    width >>= 2;
-    height >>= 2;
-
-    for (y = 1; y < height; y++) {
-        for (; z <= y; z++) {
-            FFSWAP(void*, sum0, sum1);
-            ssim_4x4xn_16bit(&main[4 * z * main_stride], main_stride,
-                             &ref[4 * z * ref_stride], ref_stride,
-                             sum0, width);
-        }
+    ThreadData *td = arg;
+    void *temp = td->temp[jobnr];
+
+    for (int c = 0; c < td->nb_components; c++) {
+        const uint8_t *main = td->main_data[c];
+        const uint8_t *ref = td->ref_data[c];
+        const int main_stride = td->main_linesize[c];
+        const int ref_stride = td->ref_linesize[c];
+        int width = td->planewidth[c];
+        int height = td->planeheight[c];
+        const int slice_start = ((height >> 2) - 1) * jobnr / nb_jobs;
+        const int slice_end = ((height >> 2) - 1) * (jobnr + 1) / nb_jobs;
+        double *score = td->score[c];
+        int64_t (*sum0)[4] = temp;
+        int64_t (*sum1)[4] = sum0 + SUM_LEN(width);
+        int z = slice_start, y;
+
+        width >>= 2;
+
+        for (y = slice_start + 1; y <= slice_end; y++) {
+            for (; z <= y; z++) {
+                FFSWAP(void*, sum0, sum1);
+                ssim_4x4xn_16bit(&main[4 * z * main_stride], main_stride,
+                                 &ref[4 * z * ref_stride], ref_stride,
+                                 sum0, width);
+            }
 
-        ssim += ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
+            score[y - 1] = ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, td->max);
+        }
     }
 
-    return ssim / ((height - 1) * (width - 1));
+    return 0;
 }
 
-static float ssim_plane(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max)
+static int ssim_plane(AVFilterContext *ctx, void *arg,
+                      int jobnr, int nb_jobs)
 {
-    int z = 0, y;
-    float ssim = 0.0;
-    int (*sum0)[4] = temp;
-    int (*sum1)[4] = sum0 + SUM_LEN(width);
-
-    width >>= 2;
-    height >>= 2;
-
-    for (y = 1; y < height; y++) {
-        for (; z <= y; z++) {
-            FFSWAP(void*, sum0, sum1);
-            dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
-                               &ref[4 * z * ref_stride], ref_stride,
-                               sum0, width);
-        }
+    ThreadData *td = arg;
+    void *temp = td->temp[jobnr];
+    SSIMDSPContext *dsp = td->dsp;
+
+    for (int c = 0; c < td->nb_components; c++) {
+        const uint8_t *main = td->main_data[c];
+        const uint8_t *ref = td->ref_data[c];
+        const int main_stride = td->main_linesize[c];
+        const int ref_stride = td->ref_linesize[c];
+        int width = td->planewidth[c];
+        int height = td->planeheight[c];
+        const int slice_start = ((height >> 2) - 1) * jobnr / nb_jobs;
+        const int slice_end = ((height >> 2) - 1) * (jobnr + 1) / nb_jobs;
+        double *score = td->score[c];
+        int (*sum0)[4] = temp;
+        int (*sum1)[4] = sum0 + SUM_LEN(width);
+        int z = slice_start, y;
+
+        width >>= 2;
+
+        for (y = slice_start + 1; y <= slice_end; y++) {
+            for (; z <= y; z++) {
+                FFSWAP(void*, sum0, sum1);
+                dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
+                                   &ref[4 * z * ref_stride], ref_stride,
+                                   sum0, width);
+            }
 
-        ssim += dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+            score[y - 1] = dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+        }
     }
 
-    return ssim / ((height - 1) * (width - 1));
+    return 0;
 }
 
 static double ssim_db(double ssim, double weight)
@@ -288,8 +328,9 @@ static int do_ssim(FFFrameSync *fs)
     SSIMContext *s = ctx->priv;
     AVFrame *master, *ref;
     AVDictionary **metadata;
-    float c[4], ssimv = 0.0;
-    int ret, i;
+    double c[4] = { 0 }, ssimv = 0.0;
+    ThreadData td;
+    int ret, i, y, nb_jobs;
 
     ret = ff_framesync_dualinput_get(fs, &master, &ref);
     if (ret < 0)
@@ -300,11 +341,33 @@ static int do_ssim(FFFrameSync *fs)
 
     s->nb_frames++;
 
+    td.nb_components = s->nb_components;
+    td.dsp = &s->dsp;
+    td.score = s->score;
+    td.temp = s->temp;
+    td.max = s->max;
+
+    for (i = 0; i < s->nb_components; i++) {
+        td.main_data[i] = master->data[i];
+        td.ref_data[i] = ref->data[i];
+        td.main_linesize[i] = master->linesize[i];
+        td.ref_linesize[i] = ref->linesize[i];
+        td.planewidth[i] = s->planewidth[i];
+        td.planeheight[i] = s->planeheight[i];
+    }
+
+    nb_jobs = FFMIN((s->planeheight[1] + 3) >> 2, s->nb_threads);
+    ctx->internal->execute(ctx, s->ssim_plane, &td, NULL, nb_jobs);
+
+    /* sum the row scores in row order so the result does not depend on
+     * how the rows were split into slices */
+    for (i = 0; i < s->nb_components; i++) {
+        for (y = 0; y < (s->planeheight[i] >> 2) - 1; y++)
+            c[i] += s->score[i][y];
+        c[i] /= ((s->planeheight[i] >> 2) - 1) * ((s->planewidth[i] >> 2) - 1);
+    }
+
     for (i = 0; i < s->nb_components; i++) {
-        c[i] = s->ssim_plane(&s->dsp, master->data[i], master->linesize[i],
-                             ref->data[i], ref->linesize[i],
-                             s->planewidth[i], s->planeheight[i], s->temp,
-                             s->max);
         ssimv += s->coefs[i] * c[i];
         s->ssim[i] += c[i];
     }
@@ -410,16 +473,25 @@ static int config_input_ref(AVFilterLink *inlink)
     for (i = 0; i < s->nb_components; i++)
         s->coefs[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
 
-    s->temp = av_mallocz_array(2 * SUM_LEN(inlink->w), (desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    s->temp = av_mallocz_array(s->nb_threads, sizeof(*s->temp));
     if (!s->temp)
         return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->nb_threads; i++) {
+        s->temp[i] = av_mallocz_array(2 * SUM_LEN(inlink->w), (desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+        if (!s->temp[i])
+            return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < s->nb_components; i++) {
+        s->score[i] = av_mallocz_array(FFMAX(s->planeheight[i] >> 2, 1), sizeof(*s->score[i]));
+        if (!s->score[i])
+            return AVERROR(ENOMEM);
+    }
     s->max = (1 << desc->comp[0].depth) - 1;
 
     s->ssim_plane = desc->comp[0].depth > 8 ? ssim_plane_16bit : ssim_plane;
-    s->dsp.ssim_4x4_line = ssim_4x4xn_8bit;
-    s->dsp.ssim_end_line = ssim_endn_8bit;
-    if (ARCH_X86)
-        ff_ssim_init_x86(&s->dsp);
+    ff_ssim_init(&s->dsp);
 
     return 0;
 }
@@ -474,6 +546,10 @@ static av_cold void uninit(AVFilterContext *ctx)
     if (s->stats_file && s->stats_file != stdout)
         fclose(s->stats_file);
 
+    for (int t = 0; t < s->nb_threads && s->temp; t++)
+        av_freep(&s->temp[t]);
+    for (int c = 0; c < 4; c++)
+        av_freep(&s->score[c]);
     av_freep(&s->temp);
 }
 
@@ -510,4 +586,5 @@ AVFilter ff_vf_ssim = {
     .priv_class    = &ssim_class,
     .inputs        = ssim_inputs,
     .outputs       = ssim_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
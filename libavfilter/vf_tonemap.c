@@ -38,17 +38,7 @@
 #include "formats.h"
 #include "internal.h"
 #include "video.h"
-
-enum TonemapAlgorithm {
-    TONEMAP_NONE,
-    TONEMAP_LINEAR,
-    TONEMAP_GAMMA,
-    TONEMAP_CLIP,
-    TONEMAP_REINHARD,
-    TONEMAP_HABLE,
-    TONEMAP_MOBIUS,
-    TONEMAP_MAX,
-};
+#include "vf_tonemap.h"
 
 static const struct LumaCoefficients luma_coefficients[AVCOL_SPC_NB] = {
     [AVCOL_SPC_FCC]        = { 0.30,   0.59,   0.11   },
@@ -69,6 +59,8 @@ typedef struct TonemapContext {
     double peak;
 
     const struct LumaCoefficients *coeffs;
+
+    TonemapDSPContext dsp;
 } TonemapContext;
 
 static const enum AVPixelFormat pix_fmts[] = {
@@ -104,6 +96,8 @@ static av_cold int init(AVFilterContext *ctx)
     if (isnan(s->param))
         s->param = 1.0f;
 
+    ff_tonemap_init(&s->dsp, s->tonemap);
+
     return 0;
 }
 
@@ -113,87 +107,110 @@ static float hable(float in)
     return (in * (in * a + b * c) + d * e) / (in * (in * a + b) + d * f) - e / f;
 }
 
-static float mobius(float in, float j, double peak)
+#define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
+static av_always_inline void tonemap_line(float *dst_r, float *dst_g, float *dst_b,
+                                          const float *src_r, const float *src_g, const float *src_b,
+                                          const float *coeffs, float desat, float param, float peak,
+                                          int width, enum TonemapAlgorithm algorithm)
 {
-    float a, b;
-
-    if (in <= j)
-        return in;
+    const float hable_peak = hable(peak);
+    const float linear_scale = param / peak;
+    const float reinhard_scale = (peak + param) / peak;
+    const float gamma_exp = 1.0f / param;
+    const float gamma_toe = algorithm == TONEMAP_GAMMA ? powf(0.05f / peak, gamma_exp) / 0.05f : 0;
+    const float j = param;
+    const float mobius_a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
+    const float mobius_b = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6f);
+    const float mobius_scale = (mobius_b * mobius_b + 2.0f * mobius_b * j + j * j) / (mobius_b - mobius_a);
+    int x;
+
+    for (x = 0; x < width; x++) {
+        float r = src_r[x], g = src_g[x], b = src_b[x];
+        float sig, sig_orig;
+
+        /* desaturate to prevent unnatural colors */
+        if (desat > 0) {
+            float luma = coeffs[0] * r + coeffs[1] * g + coeffs[2] * b;
+            float overbright = FFMAX(luma - desat, 1e-6f) / FFMAX(luma, 1e-6f);
+            r = MIX(r, luma, overbright);
+            g = MIX(g, luma, overbright);
+            b = MIX(b, luma, overbright);
+        }
 
-    a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
-    b = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6);
+        /* pick the brightest component, reducing the value range as necessary
+         * to keep the entire signal in range and preventing discoloration due to
+         * out-of-bounds clipping */
+        sig = FFMAX(FFMAX3(r, g, b), 1e-6f);
+        sig_orig = sig;
+
+        switch (algorithm) {
+        default:
+        case TONEMAP_NONE:
+            // do nothing
+            break;
+        case TONEMAP_LINEAR:
+            sig = sig * linear_scale;
+            break;
+        case TONEMAP_GAMMA:
+            sig = sig > 0.05f ? powf(sig / peak, gamma_exp)
+                              : sig * gamma_toe;
+            break;
+        case TONEMAP_CLIP:
+            sig = av_clipf(sig * param, 0, 1.0f);
+            break;
+        case TONEMAP_HABLE:
+            sig = hable(sig) / hable_peak;
+            break;
+        case TONEMAP_REINHARD:
+            sig = sig / (sig + param) * reinhard_scale;
+            break;
+        case TONEMAP_MOBIUS:
+            sig = sig <= j ? sig : mobius_scale * (sig + mobius_a) / (sig + mobius_b);
+            break;
+        }
 
-    return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
+        /* apply the computed scale factor to the color,
+         * linearly to prevent discoloration */
+        dst_r[x] = r * (sig / sig_orig);
+        dst_g[x] = g * (sig / sig_orig);
+        dst_b[x] = b * (sig / sig_orig);
+    }
 }
 
-#define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
-static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
-                    const AVPixFmtDescriptor *desc, int x, int y, double peak)
-{
-    const float *r_in = (const float *)(in->data[0] + x * desc->comp[0].step + y * in->linesize[0]);
-    const float *b_in = (const float *)(in->data[1] + x * desc->comp[1].step + y * in->linesize[1]);
-    const float *g_in = (const float *)(in->data[2] + x * desc->comp[2].step + y * in->linesize[2]);
-    float *r_out = (float *)(out->data[0] + x * desc->comp[0].step + y * out->linesize[0]);
-    float *b_out = (float *)(out->data[1] + x * desc->comp[1].step + y * out->linesize[1]);
-    float *g_out = (float *)(out->data[2] + x * desc->comp[2].step + y * out->linesize[2]);
-    float sig, sig_orig;
-
-    /* load values */
-    *r_out = *r_in;
-    *b_out = *b_in;
-    *g_out = *g_in;
-
-    /* desaturate to prevent unnatural colors */
-    if (s->desat > 0) {
-        float luma = s->coeffs->cr * *r_in + s->coeffs->cg * *g_in + s->coeffs->cb * *b_in;
-        float overbright = FFMAX(luma - s->desat, 1e-6) / FFMAX(luma, 1e-6);
-        *r_out = MIX(*r_in, luma, overbright);
-        *g_out = MIX(*g_in, luma, overbright);
-        *b_out = MIX(*b_in, luma, overbright);
-    }
+#define DEFINE_TONEMAP_LINE(name, algorithm)                                                     \
+static void tonemap_##name##_c(float *dst_r, float *dst_g, float *dst_b,                         \
+                               const float *src_r, const float *src_g, const float *src_b,       \
+                               const float *coeffs, float desat, float param, float peak,        \
+                               int width)                                                        \
+{                                                                                                \
+    tonemap_line(dst_r, dst_g, dst_b, src_r, src_g, src_b,                                       \
+                 coeffs, desat, param, peak, width, algorithm);                                  \
+}
 
-    /* pick the brightest component, reducing the value range as necessary
-     * to keep the entire signal in range and preventing discoloration due to
-     * out-of-bounds clipping */
-    sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
-    sig_orig = sig;
+DEFINE_TONEMAP_LINE(none,     TONEMAP_NONE)
+DEFINE_TONEMAP_LINE(linear,   TONEMAP_LINEAR)
+DEFINE_TONEMAP_LINE(gamma,    TONEMAP_GAMMA)
+DEFINE_TONEMAP_LINE(clip,     TONEMAP_CLIP)
+DEFINE_TONEMAP_LINE(reinhard, TONEMAP_REINHARD)
+DEFINE_TONEMAP_LINE(hable,    TONEMAP_HABLE)
+DEFINE_TONEMAP_LINE(mobius,   TONEMAP_MOBIUS)
 
-    switch(s->tonemap) {
+void ff_tonemap_init(TonemapDSPContext *dsp, enum TonemapAlgorithm algorithm)
+{
+    switch (algorithm) {
     default:
-    case TONEMAP_NONE:
-        // do nothing
-        break;
-    case TONEMAP_LINEAR:
-        sig = sig * s->param / peak;
-        break;
-    case TONEMAP_GAMMA:
-        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
-                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
-        break;
-    case TONEMAP_CLIP:
-        sig = av_clipf(sig * s->param, 0, 1.0f);
-        break;
-    case TONEMAP_HABLE:
-        sig = hable(sig) / hable(peak);
-        break;
-    case TONEMAP_REINHARD:
-        sig = sig / (sig + s->param) * (peak + s->param) / peak;
-        break;
-    case TONEMAP_MOBIUS:
-        sig = mobius(sig, s->param, peak);
-        break;
+    case TONEMAP_NONE:     dsp->tonemap_line = tonemap_none_c;     break;
+    case TONEMAP_LINEAR:   dsp->tonemap_line = tonemap_linear_c;   break;
+    case TONEMAP_GAMMA:    dsp->tonemap_line = tonemap_gamma_c;    break;
+    case TONEMAP_CLIP:     dsp->tonemap_line = tonemap_clip_c;     break;
+    case TONEMAP_REINHARD: dsp->tonemap_line = tonemap_reinhard_c; break;
+    case TONEMAP_HABLE:    dsp->tonemap_line = tonemap_hable_c;    break;
+    case TONEMAP_MOBIUS:   dsp->tonemap_line = tonemap_mobius_c;   break;
     }
-
-    /* apply the computed scale factor to the color,
-     * linearly to prevent discoloration */
-    *r_out *= sig / sig_orig;
-    *g_out *= sig / sig_orig;
-    *b_out *= sig / sig_orig;
 }
 
 typedef struct ThreadData {
     AVFrame *in, *out;
-    const AVPixFmtDescriptor *desc;
     double peak;
 } ThreadData;
 
@@ -203,14 +220,21 @@ static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs
     ThreadData *td = arg;
     AVFrame *in = td->in;
     AVFrame *out = td->out;
-    const AVPixFmtDescriptor *desc = td->desc;
     const int slice_start = (in->height * jobnr) / nb_jobs;
     const int slice_end = (in->height * (jobnr+1)) / nb_jobs;
-    double peak = td->peak;
-
-    for (int y = slice_start; y < slice_end; y++)
-        for (int x = 0; x < out->width; x++)
-            tonemap(s, out, in, desc, x, y, peak);
+    const float coeffs[3] = { s->coeffs->cr, s->coeffs->cg, s->coeffs->cb };
+
+    for (int y = slice_start; y < slice_end; y++) {
+        const float *r_in = (const float *)(in->data[0] + y * in->linesize[0]);
+        const float *b_in = (const float *)(in->data[1] + y * in->linesize[1]);
+        const float *g_in = (const float *)(in->data[2] + y * in->linesize[2]);
+        float *r_out = (float *)(out->data[0] + y * out->linesize[0]);
+        float *b_out = (float *)(out->data[1] + y * out->linesize[1]);
+        float *g_out = (float *)(out->data[2] + y * out->linesize[2]);
+
+        s->dsp.tonemap_line(r_out, g_out, b_out, r_in, g_in, b_in,
+                            coeffs, s->desat, s->param, td->peak, out->width);
+    }
 
     return 0;
 }
@@ -273,7 +297,6 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     /* do the tone map */
     td.out = out;
     td.in = in;
-    td.desc = desc;
     td.peak = peak;
     ctx->internal->execute(ctx, tonemap_slice, &td, NULL, FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
 
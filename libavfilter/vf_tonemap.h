@@ -0,0 +1,50 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_TONEMAP_H
+#define AVFILTER_TONEMAP_H
+
+enum TonemapAlgorithm {
+    TONEMAP_NONE,
+    TONEMAP_LINEAR,
+    TONEMAP_GAMMA,
+    TONEMAP_CLIP,
+    TONEMAP_REINHARD,
+    TONEMAP_HABLE,
+    TONEMAP_MOBIUS,
+    TONEMAP_MAX,
+};
+
+typedef struct TonemapDSPContext {
+    /**
+     * Tonemap width pixels of planar float linear light.
+     *
+     * @param coeffs r, g and b luma coefficients used for desaturation
+     * @param desat  desaturation strength, disabled if not positive
+     * @param param  algorithm parameter, as set up by the filter init
+     * @param peak   signal peak
+     */
+    void (*tonemap_line)(float *dst_r, float *dst_g, float *dst_b,
+                         const float *src_r, const float *src_g, const float *src_b,
+                         const float *coeffs, float desat, float param, float peak,
+                         int width);
+} TonemapDSPContext;
+
+void ff_tonemap_init(TonemapDSPContext *dsp, enum TonemapAlgorithm algorithm);
+
+#endif /* AVFILTER_TONEMAP_H */
@@ -44,6 +44,8 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/avassert.h"
 
+#define MAX_THREADS 32
+
 static const char *const var_names[] = {
     "in_w",   "iw",
     "in_h",   "ih",
@@ -110,13 +112,20 @@ typedef struct ZScaleContext {
 
     int force_original_aspect_ratio;
 
-    void *tmp;
-    size_t tmp_size;
+    void *tmp[MAX_THREADS];
+    size_t tmp_size[MAX_THREADS];
+
+    int nb_slices;
+    int slice_unscaled;             ///< bands are converted as standalone images
+    int out_slice_start[MAX_THREADS];
+    int out_slice_end[MAX_THREADS];
+    double in_slice_start[MAX_THREADS];
+    double in_slice_end[MAX_THREADS];
 
     zimg_image_format src_format, dst_format;
     zimg_image_format alpha_src_format, alpha_dst_format;
     zimg_graph_builder_params alpha_params, params;
-    zimg_filter_graph *alpha_graph, *graph;
+    zimg_filter_graph *alpha_graph[MAX_THREADS], *graph[MAX_THREADS];
 
     enum AVColorSpace in_colorspace, out_colorspace;
     enum AVColorTransferCharacteristic in_trc, out_trc;
@@ -502,16 +511,116 @@ static int graph_build(zimg_filter_graph **graph, zimg_graph_builder_params *par
     return 0;
 }
 
+/**
+ * Split the output into horizontal bands, one per job. Band boundaries
+ * are kept on chroma rows of the output; the matching input region is
+ * fractional and zimg reads whatever rows around it the filter taps need.
+ */
+static void slice_params(ZScaleContext *s, int nb_slices, int out_h, int in_h, int vsub)
+{
+    int i;
+
+    s->nb_slices = nb_slices;
+    s->out_slice_start[0] = 0;
+    for (i = 1; i < nb_slices; i++) {
+        int slice_end = (out_h * i / nb_slices) & ~((1 << vsub) - 1);
+
+        s->out_slice_start[i] = s->out_slice_end[i - 1] = slice_end;
+    }
+    s->out_slice_end[nb_slices - 1] = out_h;
+
+    for (i = 0; i < nb_slices; i++) {
+        s->in_slice_start[i] = s->out_slice_start[i] * in_h / (double)out_h;
+        s->in_slice_end[i]   = s->out_slice_end[i]   * in_h / (double)out_h;
+    }
+}
+
+static int slice_graph_build(ZScaleContext *s, zimg_filter_graph **graph, zimg_graph_builder_params *params,
+                             const zimg_image_format *src_format, const zimg_image_format *dst_format,
+                             int jobnr)
+{
+    zimg_image_format src = *src_format;
+    zimg_image_format dst = *dst_format;
+
+    dst.height = s->out_slice_end[jobnr] - s->out_slice_start[jobnr];
+    if (s->slice_unscaled) {
+        /* nothing is resampled vertically, so the input band is a
+         * standalone image too and no resize pass is added */
+        src.height = dst.height;
+    } else {
+        /* the input band is given as the active region of the whole input
+         * image, the output band is a standalone image of its own height */
+        src.active_region.left   = 0;
+        src.active_region.top    = s->in_slice_start[jobnr];
+        src.active_region.width  = src.width;
+        src.active_region.height = s->in_slice_end[jobnr] - s->in_slice_start[jobnr];
+    }
+
+    return graph_build(graph, params, &src, &dst, &s->tmp[jobnr], &s->tmp_size[jobnr]);
+}
+
+typedef struct ThreadData {
+    const AVPixFmtDescriptor *desc, *odesc;
+    AVFrame *in, *out;
+} ThreadData;
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ZScaleContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const AVPixFmtDescriptor *desc = td->desc;
+    const AVPixFmtDescriptor *odesc = td->odesc;
+    AVFrame *in = td->in, *out = td->out;
+    zimg_image_buffer_const src_buf = { ZIMG_API_VERSION };
+    zimg_image_buffer dst_buf = { ZIMG_API_VERSION };
+    int out_slice_start = s->out_slice_start[jobnr];
+    int in_slice_start = s->slice_unscaled ? out_slice_start : 0;
+    int ret, plane;
+
+    for (plane = 0; plane < 3; plane++) {
+        int vsub = plane ? odesc->log2_chroma_h : 0;
+        int p = desc->comp[plane].plane;
+
+        src_buf.plane[plane].data   = in->data[p] + (in_slice_start >> vsub) * in->linesize[p];
+        src_buf.plane[plane].stride = in->linesize[p];
+        src_buf.plane[plane].mask   = -1;
+
+        p = odesc->comp[plane].plane;
+        dst_buf.plane[plane].data   = out->data[p] + (out_slice_start >> vsub) * out->linesize[p];
+        dst_buf.plane[plane].stride = out->linesize[p];
+        dst_buf.plane[plane].mask   = -1;
+    }
+
+    ret = zimg_filter_graph_process(s->graph[jobnr], &src_buf, &dst_buf, s->tmp[jobnr], 0, 0, 0, 0);
+    if (ret)
+        return print_zimg_error(ctx);
+
+    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
+        src_buf.plane[0].data   = in->data[3] + in_slice_start * in->linesize[3];
+        src_buf.plane[0].stride = in->linesize[3];
+        src_buf.plane[0].mask   = -1;
+
+        dst_buf.plane[0].data   = out->data[3] + out_slice_start * out->linesize[3];
+        dst_buf.plane[0].stride = out->linesize[3];
+        dst_buf.plane[0].mask   = -1;
+
+        ret = zimg_filter_graph_process(s->alpha_graph[jobnr], &src_buf, &dst_buf, s->tmp[jobnr], 0, 0, 0, 0);
+        if (ret)
+            return print_zimg_error(ctx);
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     ZScaleContext *s = link->dst->priv;
     AVFilterLink *outlink = link->dst->outputs[0];
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     const AVPixFmtDescriptor *odesc = av_pix_fmt_desc_get(outlink->format);
-    zimg_image_buffer_const src_buf = { ZIMG_API_VERSION };
-    zimg_image_buffer dst_buf = { ZIMG_API_VERSION };
+    ThreadData td;
     char buf[32];
-    int ret = 0, plane;
+    int ret = 0, i;
     AVFrame *out;
 
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
@@ -536,7 +645,11 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
        || s->out_primaries != out->color_primaries
        || s->out_range != out->color_range
        || s->in_chromal != in->chroma_location
-       || s->out_chromal != out->chroma_location) {
+       || s->out_chromal != out->chroma_location
+       || !s->nb_slices
+       || s->out_slice_end[s->nb_slices - 1] != out->height) {
+        int nb_slices = FFMIN(ff_filter_get_nb_threads(link->dst), MAX_THREADS);
+
         snprintf(buf, sizeof(buf)-1, "%d", outlink->w);
         av_opt_set(s, "w", buf, 0);
         snprintf(buf, sizeof(buf)-1, "%d", outlink->h);
@@ -583,11 +696,6 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         if (s->chromal != -1)
             out->chroma_location = (int)s->dst_format.chroma_location - 1;
 
-        ret = graph_build(&s->graph, &s->params, &s->src_format, &s->dst_format,
-                          &s->tmp, &s->tmp_size);
-        if (ret < 0)
-            goto fail;
-
         s->in_colorspace  = in->colorspace;
         s->in_trc         = in->color_trc;
         s->in_primaries   = in->color_primaries;
@@ -617,12 +725,39 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
             s->alpha_dst_format.depth = odesc->comp[0].depth;
             s->alpha_dst_format.pixel_type = (odesc->flags & AV_PIX_FMT_FLAG_FLOAT) ? ZIMG_PIXEL_FLOAT : odesc->comp[0].depth > 8 ? ZIMG_PIXEL_WORD : ZIMG_PIXEL_BYTE;
             s->alpha_dst_format.color_family = ZIMG_COLOR_GREY;
+        }
+
+        /* keep the bands tall enough for the resampler setup to pay off;
+         * every graph restarts the dither pattern, so dithered output is
+         * converted in one band to keep it independent of the thread count */
+        nb_slices = av_clip(out->height / 16, 1, nb_slices);
+        if (s->dither != ZIMG_DITHER_NONE)
+            nb_slices = 1;
+        slice_params(s, nb_slices, out->height, in->height, odesc->log2_chroma_h);
+
+        s->slice_unscaled = s->src_format.width           == s->dst_format.width       &&
+                            s->src_format.height          == s->dst_format.height      &&
+                            s->src_format.subsample_w     == s->dst_format.subsample_w &&
+                            s->src_format.subsample_h     == s->dst_format.subsample_h &&
+                            s->src_format.chroma_location == s->dst_format.chroma_location;
+
+        for (i = 0; i < MAX_THREADS; i++) {
+            zimg_filter_graph_free(s->graph[i]);
+            zimg_filter_graph_free(s->alpha_graph[i]);
+            s->graph[i] = s->alpha_graph[i] = NULL;
+        }
 
-            zimg_filter_graph_free(s->alpha_graph);
-            s->alpha_graph = zimg_filter_graph_build(&s->alpha_src_format, &s->alpha_dst_format, &s->alpha_params);
-            if (!s->alpha_graph) {
-                ret = print_zimg_error(link->dst);
+        for (i = 0; i < nb_slices; i++) {
+            ret = slice_graph_build(s, &s->graph[i], &s->params,
+                                    &s->src_format, &s->dst_format, i);
+            if (ret < 0)
                 goto fail;
+
+            if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
+                ret = slice_graph_build(s, &s->alpha_graph[i], &s->alpha_params,
+                                        &s->alpha_src_format, &s->alpha_dst_format, i);
+                if (ret < 0)
+                    goto fail;
             }
         }
     }
@@ -644,39 +779,15 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
               (int64_t)in->sample_aspect_ratio.den * outlink->w * link->h,
               INT_MAX);
 
-    for (plane = 0; plane < 3; plane++) {
-        int p = desc->comp[plane].plane;
-        src_buf.plane[plane].data   = in->data[p];
-        src_buf.plane[plane].stride = in->linesize[p];
-        src_buf.plane[plane].mask   = -1;
-
-        p = odesc->comp[plane].plane;
-        dst_buf.plane[plane].data   = out->data[p];
-        dst_buf.plane[plane].stride = out->linesize[p];
-        dst_buf.plane[plane].mask   = -1;
-    }
-
-    ret = zimg_filter_graph_process(s->graph, &src_buf, &dst_buf, s->tmp, 0, 0, 0, 0);
-    if (ret) {
-        ret = print_zimg_error(link->dst);
+    td.desc  = desc;
+    td.odesc = odesc;
+    td.in    = in;
+    td.out   = out;
+    ret = link->dst->internal->execute(link->dst, filter_slice, &td, NULL, s->nb_slices);
+    if (ret < 0)
         goto fail;
-    }
 
-    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
-        src_buf.plane[0].data   = in->data[3];
-        src_buf.plane[0].stride = in->linesize[3];
-        src_buf.plane[0].mask   = -1;
-
-        dst_buf.plane[0].data   = out->data[3];
-        dst_buf.plane[0].stride = out->linesize[3];
-        dst_buf.plane[0].mask   = -1;
-
-        ret = zimg_filter_graph_process(s->alpha_graph, &src_buf, &dst_buf, s->tmp, 0, 0, 0, 0);
-        if (ret) {
-            ret = print_zimg_error(link->dst);
-            goto fail;
-        }
-    } else if (odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
+    if (!(desc->flags & AV_PIX_FMT_FLAG_ALPHA) && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
         int x, y;
 
         if (odesc->flags & AV_PIX_FMT_FLAG_FLOAT) {
@@ -706,10 +817,14 @@ static void uninit(AVFilterContext *ctx)
 {
     ZScaleContext *s = ctx->priv;
 
-    zimg_filter_graph_free(s->graph);
-    zimg_filter_graph_free(s->alpha_graph);
-    av_freep(&s->tmp);
-    s->tmp_size = 0;
+    int i;
+
+    for (i = 0; i < MAX_THREADS; i++) {
+        zimg_filter_graph_free(s->graph[i]);
+        zimg_filter_graph_free(s->alpha_graph[i]);
+        av_freep(&s->tmp[i]);
+        s->tmp_size[i] = 0;
+    }
 }
 
 static int process_command(AVFilterContext *ctx, const char *cmd, const char *args,
@@ -890,4 +1005,5 @@ AVFilter ff_vf_zscale = {
     .inputs          = avfilter_vf_zscale_inputs,
     .outputs         = avfilter_vf_zscale_outputs,
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -1501,6 +1501,7 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
 #define AVFMT_FLAG_SHORTEST   0x100000 ///< Stop muxing when the shortest stream stops.
 #define AVFMT_FLAG_AUTO_BSF   0x200000 ///< Add bitstream filters as requested by the muxer
+#define AVFMT_FLAG_FAST_PROBE 0x400000 ///< Trust complete container parameters and decode the other streams concurrently in avformat_find_stream_info()
 
     /**
      * Maximum size of the data read from input for determining
@@ -1951,6 +1952,23 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int skip_estimate_duration_from_pts;
+
+    /**
+     * Directory of the stream info cache. If set, the result of
+     * avformat_find_stream_info() and the index entries of local input
+     * files are stored there and reused by later opens of the same file.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *probe_cache;
+
+    /**
+     * Build an index of the keyframes of the stream on the first seek by
+     * reading the whole input, if the demuxer provides no index of its own.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int build_index;
 } AVFormatContext;
 
 #if FF_API_FORMAT_GET_SET
@@ -224,6 +224,17 @@ void avio_write(AVIOContext *s, const unsigned char *buf, int size)
     }
     while (size > 0) {
         int len = FFMIN(s->buf_end - s->buf_ptr, size);
+
+        /* write whole buffers directly instead of copying them through an
+         * empty buffer, the protocol sees the same writes either way */
+        if (len == s->buffer_size && s->buf_ptr_max == s->buffer &&
+            !s->update_checksum) {
+            writeout(s, buf, len);
+            buf  += len;
+            size -= len;
+            continue;
+        }
+
         memcpy(s->buf_ptr, buf, len);
         s->buf_ptr += len;
 
@@ -24,6 +24,7 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 #include "libavutil/timestamp.h"
 #include "avformat.h"
 #include "internal.h"
@@ -34,6 +35,12 @@ typedef enum ConcatMatchMode {
     MATCH_EXACT_ID,
 } ConcatMatchMode;
 
+typedef enum ConcatPreopenState {
+    PREOPEN_NONE,
+    PREOPEN_OPENING,
+    PREOPEN_DONE,
+} ConcatPreopenState;
+
 typedef struct ConcatStream {
     AVBSFContext *bsf;
     int out_stream_index;
@@ -52,6 +59,9 @@ typedef struct {
     int64_t outpoint;
     AVDictionary *metadata;
     int nb_streams;
+    AVFormatContext *preopened;
+    ConcatPreopenState preopen_state;
+    int preopen_ret;
 } ConcatFile;
 
 typedef struct {
@@ -66,6 +76,18 @@ typedef struct {
     ConcatMatchMode stream_match_mode;
     unsigned auto_convert;
     int segment_time_metadata;
+    int preopen;
+#if HAVE_THREADS
+    /* The preopen thread opens the files after preopen_cur, up to preopen
+     * of them. Everything below and the preopen fields of the files are
+     * protected by preopen_lock. */
+    pthread_t preopen_thread;
+    pthread_mutex_t preopen_lock;
+    pthread_cond_t preopen_cond;
+    int preopen_started;
+    int preopen_quit;
+    unsigned preopen_cur;
+#endif
 } ConcatContext;
 
 static int concat_probe(const AVProbeData *probe)
@@ -329,31 +351,171 @@ static int64_t get_best_effort_duration(ConcatFile *file, AVFormatContext *avf)
     return AV_NOPTS_VALUE;
 }
 
-static int open_file(AVFormatContext *avf, unsigned fileno)
+static int open_input(AVFormatContext *avf, ConcatFile *file,
+                      AVFormatContext **ctx)
 {
-    ConcatContext *cat = avf->priv_data;
-    ConcatFile *file = &cat->files[fileno];
     int ret;
 
-    if (cat->avf)
-        avformat_close_input(&cat->avf);
-
-    cat->avf = avformat_alloc_context();
-    if (!cat->avf)
+    *ctx = avformat_alloc_context();
+    if (!*ctx)
         return AVERROR(ENOMEM);
 
-    cat->avf->flags |= avf->flags & ~AVFMT_FLAG_CUSTOM_IO;
-    cat->avf->interrupt_callback = avf->interrupt_callback;
+    (*ctx)->flags |= avf->flags & ~AVFMT_FLAG_CUSTOM_IO;
+    (*ctx)->interrupt_callback = avf->interrupt_callback;
 
-    if ((ret = ff_copy_whiteblacklists(cat->avf, avf)) < 0)
+    if ((ret = ff_copy_whiteblacklists(*ctx, avf)) < 0) {
+        avformat_free_context(*ctx);
+        *ctx = NULL;
         return ret;
+    }
 
-    if ((ret = avformat_open_input(&cat->avf, file->url, NULL, NULL)) < 0 ||
-        (ret = avformat_find_stream_info(cat->avf, NULL)) < 0) {
+    if ((ret = avformat_open_input(ctx, file->url, NULL, NULL)) < 0 ||
+        (ret = avformat_find_stream_info(*ctx, NULL)) < 0) {
         av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
-        avformat_close_input(&cat->avf);
+        avformat_close_input(ctx);
+        return ret;
+    }
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *preopen_thread(void *arg)
+{
+    AVFormatContext *avf = arg;
+    ConcatContext *cat = avf->priv_data;
+
+    pthread_mutex_lock(&cat->preopen_lock);
+    while (!cat->preopen_quit) {
+        ConcatFile *file = NULL;
+        AVFormatContext *ctx;
+        unsigned i;
+        int ret;
+
+        for (i = cat->preopen_cur + 1;
+             i < cat->nb_files && i - cat->preopen_cur <= cat->preopen; i++) {
+            if (cat->files[i].preopen_state == PREOPEN_NONE) {
+                file = &cat->files[i];
+                break;
+            }
+        }
+        if (!file) {
+            pthread_cond_wait(&cat->preopen_cond, &cat->preopen_lock);
+            continue;
+        }
+
+        file->preopen_state = PREOPEN_OPENING;
+        pthread_mutex_unlock(&cat->preopen_lock);
+        ret = open_input(avf, file, &ctx);
+        pthread_mutex_lock(&cat->preopen_lock);
+
+        file->preopened    = ctx;
+        file->preopen_ret  = ret;
+        file->preopen_state = PREOPEN_DONE;
+        pthread_cond_broadcast(&cat->preopen_cond);
+    }
+    pthread_mutex_unlock(&cat->preopen_lock);
+    return NULL;
+}
+
+static int preopen_start(AVFormatContext *avf)
+{
+    ConcatContext *cat = avf->priv_data;
+    int ret;
+
+    if ((ret = AVERROR(pthread_mutex_init(&cat->preopen_lock, NULL))) < 0)
+        return ret;
+    if ((ret = AVERROR(pthread_cond_init(&cat->preopen_cond, NULL))) < 0) {
+        pthread_mutex_destroy(&cat->preopen_lock);
         return ret;
     }
+    if ((ret = AVERROR(pthread_create(&cat->preopen_thread, NULL,
+                                      preopen_thread, avf))) < 0) {
+        pthread_cond_destroy(&cat->preopen_cond);
+        pthread_mutex_destroy(&cat->preopen_lock);
+        return ret;
+    }
+    cat->preopen_started = 1;
+    return 0;
+}
+
+static void preopen_stop(AVFormatContext *avf)
+{
+    ConcatContext *cat = avf->priv_data;
+    unsigned i;
+
+    if (!cat->preopen_started)
+        return;
+
+    pthread_mutex_lock(&cat->preopen_lock);
+    cat->preopen_quit = 1;
+    pthread_cond_broadcast(&cat->preopen_cond);
+    pthread_mutex_unlock(&cat->preopen_lock);
+    pthread_join(cat->preopen_thread, NULL);
+
+    for (i = 0; i < cat->nb_files; i++)
+        if (cat->files[i].preopened)
+            avformat_close_input(&cat->files[i].preopened);
+    pthread_cond_destroy(&cat->preopen_cond);
+    pthread_mutex_destroy(&cat->preopen_lock);
+    cat->preopen_started = 0;
+}
+
+/**
+ * Take the preopened context of a file and move the preopen window behind
+ * it. Contexts preopened for files outside the new window are closed.
+ *
+ * @return 1 if the file was not preopened, the result of opening it otherwise
+ */
+static int preopen_take(AVFormatContext *avf, unsigned fileno,
+                        AVFormatContext **ctx)
+{
+    ConcatContext *cat = avf->priv_data;
+    ConcatFile *file = &cat->files[fileno];
+    unsigned i;
+    int ret = 1;
+
+    pthread_mutex_lock(&cat->preopen_lock);
+    while (file->preopen_state == PREOPEN_OPENING)
+        pthread_cond_wait(&cat->preopen_cond, &cat->preopen_lock);
+    if (file->preopen_state == PREOPEN_DONE) {
+        *ctx = file->preopened;
+        ret  = file->preopen_ret;
+        file->preopened     = NULL;
+        file->preopen_state = PREOPEN_NONE;
+    }
+
+    cat->preopen_cur = fileno;
+    for (i = 0; i < cat->nb_files; i++) {
+        if (cat->files[i].preopen_state == PREOPEN_DONE &&
+            (i <= fileno || i - fileno > cat->preopen)) {
+            avformat_close_input(&cat->files[i].preopened);
+            cat->files[i].preopen_state = PREOPEN_NONE;
+        }
+    }
+    pthread_cond_signal(&cat->preopen_cond);
+    pthread_mutex_unlock(&cat->preopen_lock);
+    return ret;
+}
+#endif
+
+static int open_file(AVFormatContext *avf, unsigned fileno)
+{
+    ConcatContext *cat = avf->priv_data;
+    ConcatFile *file = &cat->files[fileno];
+    int ret = 1;
+
+    if (cat->avf)
+        avformat_close_input(&cat->avf);
+
+#if HAVE_THREADS
+    if (cat->preopen_started)
+        ret = preopen_take(avf, fileno, &cat->avf);
+#endif
+    if (ret > 0)
+        ret = open_input(avf, file, &cat->avf);
+    if (ret < 0)
+        return ret;
+
     cat->cur_file = file;
     file->start_time = !fileno ? 0 :
                        cat->files[fileno - 1].start_time +
@@ -382,6 +544,9 @@ static int concat_read_close(AVFormatContext *avf)
     ConcatContext *cat = avf->priv_data;
     unsigned i, j;
 
+#if HAVE_THREADS
+    preopen_stop(avf);
+#endif
     for (i = 0; i < cat->nb_files; i++) {
         av_freep(&cat->files[i].url);
         for (j = 0; j < cat->files[i].nb_streams; j++) {
@@ -512,6 +677,10 @@ static int concat_read_header(AVFormatContext *avf)
 
     cat->stream_match_mode = avf->nb_streams ? MATCH_EXACT_ID :
                                                MATCH_ONE_TO_ONE;
+#if HAVE_THREADS
+    if (cat->preopen && cat->nb_files > 1 && (ret = preopen_start(avf)) < 0)
+        goto fail;
+#endif
     if ((ret = open_file(avf, 0)) < 0)
         goto fail;
     av_bprint_finalize(&bp, NULL);
@@ -771,6 +940,8 @@ static const AVOption options[] = {
       OFFSET(auto_convert), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, DEC },
     { "segment_time_metadata", "output file segment start time and duration as packet metadata",
       OFFSET(segment_time_metadata), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
+    { "preopen", "number of files to open ahead on a background thread",
+      OFFSET(preopen), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, DEC },
     { NULL }
 };
 
@@ -49,6 +49,7 @@
 #include "url.h"
 #include "vpcc.h"
 #include "dash.h"
+#include "writequeue.h"
 
 typedef enum {
     SEGMENT_TYPE_AUTO = 0,
@@ -136,6 +137,8 @@ typedef struct DASHContext {
     const char *user_agent;
     int hls_playlist;
     int http_persistent;
+    int http_write_queue;
+    FFWriteQueue *write_queue;
     int master_playlist_created;
     AVIOContext *mpd_out;
     AVIOContext *m3u8_out;
@@ -179,7 +182,11 @@ static int dashenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     DASHContext *c = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
-    if (!*pb || !http_base_proto || !c->http_persistent) {
+    if (c->write_queue && http_base_proto) {
+        if (ff_write_queue_owns(c->write_queue, *pb))
+            ff_write_queue_close(c->write_queue, pb);
+        err = ff_write_queue_open(c->write_queue, pb, filename, options);
+    } else if (!*pb || !http_base_proto || !c->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -200,7 +207,12 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     if (!*pb)
         return;
 
-    if (!http_base_proto || !c->http_persistent) {
+    if (c->write_queue && ff_write_queue_owns(c->write_queue, *pb)) {
+        int ret = ff_write_queue_close(c->write_queue, pb);
+        if (ret < 0)
+            av_log(s, c->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                   "Failed to queue output for writing: %s\n", av_err2str(ret));
+    } else if (!http_base_proto || !c->http_persistent) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -212,6 +224,16 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     }
 }
 
+/* Close an output for good, handing it to the write queue if it owns it. */
+static void dashenc_io_free(AVFormatContext *s, AVIOContext **pb, char *filename)
+{
+    DASHContext *c = s->priv_data;
+
+    if (c->write_queue && ff_write_queue_owns(c->write_queue, *pb))
+        dashenc_io_close(s, pb, filename);
+    ff_format_io_close(s, pb);
+}
+
 static const char *get_format_str(SegmentType segment_type) {
     int i;
     for (i = 0; i < SEGMENT_TYPE_NB; i++)
@@ -587,7 +609,7 @@ static void dash_free(AVFormatContext *s)
             else
                 avio_close(os->ctx->pb);
         }
-        ff_format_io_close(s, &os->out);
+        dashenc_io_free(s, &os->out, os->temp_path);
         if (os->ctx)
             avformat_free_context(os->ctx);
         for (j = 0; j < os->nb_segments; j++)
@@ -599,8 +621,9 @@ static void dash_free(AVFormatContext *s)
     }
     av_freep(&c->streams);
 
-    ff_format_io_close(s, &c->mpd_out);
-    ff_format_io_close(s, &c->m3u8_out);
+    dashenc_io_free(s, &c->mpd_out, s->url);
+    dashenc_io_free(s, &c->m3u8_out, NULL);
+    ff_write_queue_free(&c->write_queue);
 }
 
 static void output_segment_list(OutputStream *os, AVIOContext *out, AVFormatContext *s,
@@ -1181,6 +1204,18 @@ static int dash_init(AVFormatContext *s)
         c->global_sidx = 0;
     }
 
+    if (c->http_write_queue > 0 && ff_is_http_proto(s->url)) {
+        if (c->streaming)
+            av_log(s, AV_LOG_WARNING, "Segments are only uploaded once complete when "
+                   "http_write_queue is used in streaming mode\n");
+        ret = ff_write_queue_alloc(&c->write_queue, s, c->http_write_queue,
+                                   c->http_persistent);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Failed to start the HTTP write queue\n");
+            return ret;
+        }
+    }
+
     av_strlcpy(c->dirname, s->url, sizeof(c->dirname));
     ptr = strrchr(c->dirname, '/');
     if (ptr) {
@@ -1294,7 +1329,7 @@ static int dash_init(AVFormatContext *s)
         if (!c->single_file) {
             if ((ret = avio_open_dyn_buf(&ctx->pb)) < 0)
                 return ret;
-            ret = s->io_open(s, &os->out, filename, AVIO_FLAG_WRITE, &opts);
+            ret = dashenc_io_open(s, &os->out, filename, &opts);
         } else {
             ctx->url = av_strdup(filename);
             ret = avio_open2(&ctx->pb, filename, AVIO_FLAG_WRITE, NULL, &opts);
@@ -1510,7 +1545,7 @@ static void dashenc_delete_file(AVFormatContext *s, char *filename) {
         }
 
         av_dict_free(&http_opts);
-        ff_format_io_close(s, &out);
+        dashenc_io_free(s, &out, filename);
     } else {
         int res = avpriv_io_delete(filename);
         if (res < 0) {
@@ -1845,7 +1880,7 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
 static int dash_write_trailer(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
-    int i;
+    int i, ret;
 
     if (s->nb_streams > 0) {
         OutputStream *os = &c->streams[0];
@@ -1881,6 +1916,13 @@ static int dash_write_trailer(AVFormatContext *s)
         }
     }
 
+    ret = ff_write_queue_free(&c->write_queue);
+    if (ret < 0) {
+        av_log(s, c->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+               "Some queued outputs could not be written\n");
+        return c->ignore_io_errors ? 0 : ret;
+    }
+
     return 0;
 }
 
@@ -1928,6 +1970,7 @@ static const AVOption options[] = {
     { "method", "set the HTTP method", OFFSET(method), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, E },
     { "http_user_agent", "override User-Agent field in HTTP header", OFFSET(user_agent), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, E},
     { "http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    { "http_write_queue", "Upload segments and playlists from a background thread, queueing up to this many files (0 disables)", OFFSET(http_write_queue), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
     { "hls_playlist", "Generate HLS playlist files(master.m3u8, media_%d.m3u8)", OFFSET(hls_playlist), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "streaming", "Enable/Disable streaming mode of output. Each frame will be moof fragment", OFFSET(streaming), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
@@ -51,6 +51,7 @@
 #include "hlsplaylist.h"
 #include "internal.h"
 #include "os_support.h"
+#include "writequeue.h"
 
 typedef enum {
   HLS_START_SEQUENCE_AS_START_NUMBER = 0,
@@ -233,6 +234,8 @@ typedef struct HLSContext {
     char *master_pl_name;
     unsigned int master_publish_rate;
     int http_persistent;
+    int http_write_queue;
+    FFWriteQueue *write_queue;
     AVIOContext *m3u8_out;
     AVIOContext *sub_m3u8_out;
     int64_t timeout;
@@ -247,7 +250,11 @@ static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     HLSContext *hls = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
-    if (!*pb || !http_base_proto || !hls->http_persistent) {
+    if (hls->write_queue && http_base_proto) {
+        if (ff_write_queue_owns(hls->write_queue, *pb))
+            ff_write_queue_close(hls->write_queue, pb);
+        err = ff_write_queue_open(hls->write_queue, pb, filename, options);
+    } else if (!*pb || !http_base_proto || !hls->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -267,7 +274,12 @@ static void hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     if (!*pb)
         return;
-    if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
+    if (hls->write_queue && ff_write_queue_owns(hls->write_queue, *pb)) {
+        int ret = ff_write_queue_close(hls->write_queue, pb);
+        if (ret < 0)
+            av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                   "Failed to queue output for writing: %s\n", av_err2str(ret));
+    } else if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -279,6 +291,16 @@ static void hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename
     }
 }
 
+/* Close an output for good, handing it to the write queue if it owns it. */
+static void hlsenc_io_free(AVFormatContext *s, AVIOContext **pb, char *filename)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (hls->write_queue && ff_write_queue_owns(hls->write_queue, *pb))
+        hlsenc_io_close(s, pb, filename);
+    ff_format_io_close(s, pb);
+}
+
 static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSContext *c)
 {
     int http_base_proto = ff_is_http_proto(s->url);
@@ -559,12 +581,12 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         proto = avio_find_protocol_name(s->url);
         if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
             av_dict_set(&options, "method", "DELETE", 0);
-            if ((ret = vs->avf->io_open(vs->avf, &out, path, AVIO_FLAG_WRITE, &options)) < 0) {
+            if ((ret = hlsenc_io_open(s, &out, path, &options)) < 0) {
                 if (hls->ignore_io_errors)
                     ret = 0;
                 goto fail;
             }
-            ff_format_io_close(vs->avf, &out);
+            hlsenc_io_free(s, &out, path);
         } else if (unlink(path) < 0) {
             av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
                                      path, strerror(errno));
@@ -590,13 +612,13 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
 
             if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
                 av_dict_set(&options, "method", "DELETE", 0);
-                if ((ret = vs->vtt_avf->io_open(vs->vtt_avf, &out, sub_path, AVIO_FLAG_WRITE, &options)) < 0) {
+                if ((ret = hlsenc_io_open(s, &out, sub_path, &options)) < 0) {
                     if (hls->ignore_io_errors)
                         ret = 0;
                     av_free(sub_path);
                     goto fail;
                 }
-                ff_format_io_close(vs->vtt_avf, &out);
+                hlsenc_io_free(s, &out, sub_path);
             } else if (unlink(sub_path) < 0) {
                 av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
                                          sub_path, strerror(errno));
@@ -2365,7 +2387,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                 vs->packets_written = 0;
                 vs->start_pos = range_length;
                 if (!byterange_mode) {
-                    ff_format_io_close(s, &vs->out);
+                    hlsenc_io_free(s, &vs->out, vs->base_output_dirname);
                     hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
                 }
             }
@@ -2412,7 +2434,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
                 if (ret < 0) {
                     return ret;
                 }
-                ff_format_io_close(s, &vs->out);
+                hlsenc_io_free(s, &vs->out, vs->avf->url);
             }
         }
 
@@ -2559,7 +2581,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 vs->start_pos = range_length;
                 byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
                 if (!byterange_mode) {
-                    ff_format_io_close(s, &vs->out);
+                    hlsenc_io_free(s, &vs->out, vs->base_output_dirname);
                     hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
                 }
             }
@@ -2576,7 +2598,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 goto failed;
             }
             vs->size = range_length;
-            ff_format_io_close(s, &vs->out);
+            hlsenc_io_free(s, &vs->out, vs->avf->url);
         }
 
 failed:
@@ -2614,7 +2636,7 @@ failed:
             if (vtt_oc->pb)
                 av_write_trailer(vtt_oc);
             vs->size = avio_tell(vs->vtt_avf->pb) - vs->start_pos;
-            ff_format_io_close(s, &vtt_oc->pb);
+            hlsenc_io_free(s, &vtt_oc->pb, vtt_oc->url);
             avformat_free_context(vtt_oc);
         }
         hls_window(s, 1, vs);
@@ -2633,15 +2655,29 @@ failed:
         av_freep(&ccs->language);
     }
 
-    ff_format_io_close(s, &hls->m3u8_out);
-    ff_format_io_close(s, &hls->sub_m3u8_out);
+    hlsenc_io_free(s, &hls->m3u8_out, NULL);
+    hlsenc_io_free(s, &hls->sub_m3u8_out, NULL);
     av_freep(&hls->key_basename);
     av_freep(&hls->var_streams);
     av_freep(&hls->cc_streams);
     av_freep(&hls->master_m3u8_url);
+
+    ret = ff_write_queue_free(&hls->write_queue);
+    if (ret < 0) {
+        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+               "Some queued outputs could not be written\n");
+        return hls->ignore_io_errors ? 0 : ret;
+    }
     return 0;
 }
 
+static void hls_deinit(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+
+    /* only set when the trailer was never written */
+    ff_write_queue_free(&hls->write_queue);
+}
 
 static int hls_init(AVFormatContext *s)
 {
@@ -2689,6 +2725,15 @@ static int hls_init(AVFormatContext *s)
             goto fail;
     }
 
+    if (hls->http_write_queue > 0 && ff_is_http_proto(s->url)) {
+        ret = ff_write_queue_alloc(&hls->write_queue, s, hls->http_write_queue,
+                                   hls->http_persistent);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Failed to start the HTTP write queue\n");
+            goto fail;
+        }
+    }
+
     if (hls->subtitle_filename) {
         ret = validate_name(hls->nb_varstreams, hls->subtitle_filename);
         if (ret < 0)
@@ -2949,6 +2994,7 @@ static int hls_init(AVFormatContext *s)
 
 fail:
     if (ret < 0) {
+        ff_write_queue_free(&hls->write_queue);
         av_freep(&hls->key_basename);
         for (i = 0; i < hls->nb_varstreams && hls->var_streams; i++) {
             vs = &hls->var_streams[i];
@@ -3047,6 +3093,7 @@ static const AVOption options[] = {
     {"master_pl_name", "Create HLS master playlist with this name", OFFSET(master_pl_name), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
     {"master_pl_publish_rate", "Publish master play list every after this many segment intervals", OFFSET(master_publish_rate), AV_OPT_TYPE_INT, {.i64 = 0}, 0, UINT_MAX, E},
     {"http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    {"http_write_queue", "Upload segments and playlists from a background thread, queueing up to this many files (0 disables)", OFFSET(http_write_queue), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, INT_MAX, E },
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
@@ -3074,5 +3121,6 @@ AVOutputFormat ff_hls_muxer = {
     .write_header   = hls_write_header,
     .write_packet   = hls_write_packet,
     .write_trailer  = hls_write_trailer,
+    .deinit         = hls_deinit,
     .priv_class     = &hls_class,
 };
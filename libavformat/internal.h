@@ -144,6 +144,19 @@ struct AVFormatInternal {
      * Prefer the codec framerate for avg_frame_rate computation.
      */
     int prefer_codec_framerate;
+
+    /**
+     * Set if the stream info matches the stream info cache, and the
+     * number of index entries the cache holds.
+     */
+    int probe_cache_valid;
+    int probe_cache_entries;
+
+    /**
+     * Set by demuxers that cannot be sought by bytes with their current
+     * options, e.g. because a thread of their own reads from the AVIOContext.
+     */
+    int no_byte_seek;
 };
 
 struct AVStreamInternal {
@@ -192,6 +205,18 @@ struct AVStreamInternal {
     int need_context_update;
 
     FFFrac *priv_pts;
+
+    /**
+     * Set if the demuxer built the index while reading the header, the
+     * stream info cache does not store it then.
+     */
+    int header_index;
+
+    /**
+     * Set if the index holds every keyframe of the stream, seeks then jump
+     * to the index entry directly.
+     */
+    int index_complete;
 };
 
 #ifdef __GNUC__
@@ -792,6 +817,24 @@ int ff_packet_list_get(AVPacketList **head, AVPacketList **tail,
  */
 void ff_packet_list_free(AVPacketList **head, AVPacketList **tail);
 
+/**
+ * Restore the stream info and the index entries from the stream info cache.
+ *
+ * @return 0 if the cache matched the input, AVERROR_xxx otherwise
+ */
+int ff_probe_cache_load(AVFormatContext *s);
+
+/**
+ * Store the stream info and the index entries in the stream info cache.
+ */
+int ff_probe_cache_save(AVFormatContext *s);
+
+/**
+ * Store the stream info cache again if index entries were added since it
+ * was loaded or saved.
+ */
+int ff_probe_cache_update(AVFormatContext *s);
+
 void avpriv_register_devices(const AVOutputFormat * const o[], const AVInputFormat * const i[]);
 
 #endif /* AVFORMAT_INTERNAL_H */
@@ -44,6 +44,8 @@
 #include "libavutil/opt.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/spherical.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 
 #include "libavcodec/bytestream.h"
 #include "libavcodec/flac.h"
@@ -246,12 +248,19 @@ typedef struct MatroskaTrack {
     uint64_t codec_delay_in_track_tb;
 
     AVStream *stream;
+    int stream_index;
     int64_t end_timecode;
     int ms_compat;
     uint64_t max_block_additional_id;
 
     uint32_t palette[AVPALETTE_COUNT];
     int has_palette;
+
+    /* Stream fields read while parsing blocks. The prefetch thread does not
+     * access the stream, it uses these copies made when it was started. */
+    enum AVDiscard prefetch_discard;
+    int prefetch_skip_to_keyframe;
+    AVCodecParameters *prefetch_par;
 } MatroskaTrack;
 
 typedef struct MatroskaAttachment {
@@ -335,6 +344,13 @@ typedef struct MatroskaLevel1Element {
     int parsed;
 } MatroskaLevel1Element;
 
+typedef struct MatroskaIndexEntry {
+    AVStream *st;
+    int64_t pos;
+    int64_t timestamp;
+    int reduce;
+} MatroskaIndexEntry;
+
 typedef struct MatroskaDemuxContext {
     const AVClass *class;
     AVFormatContext *ctx;
@@ -385,6 +401,16 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    /* Number of packets to read ahead on a background thread */
+    int prefetch;
+#if HAVE_THREADS
+    AVThreadMessageQueue *prefetch_queue;
+    pthread_t prefetch_thread;
+#endif
+    /* Index entries found by the prefetch thread, not yet added by the caller */
+    MatroskaIndexEntry *index_entries;
+    int nb_index_entries;
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -1870,6 +1896,43 @@ static void matroska_execute_seekhead(MatroskaDemuxContext *matroska)
     }
 }
 
+static int matroska_prefetching(MatroskaDemuxContext *matroska)
+{
+#if HAVE_THREADS
+    return !!matroska->prefetch_queue;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * The index is used by the caller while the prefetch thread runs, so the
+ * entries the thread finds are passed to the caller with the next packet.
+ */
+static void matroska_add_index_entry(MatroskaDemuxContext *matroska, AVStream *st,
+                                     int64_t pos, int64_t timestamp, int reduce)
+{
+    if (matroska_prefetching(matroska)) {
+        MatroskaIndexEntry *entries;
+
+        entries = av_realloc_array(matroska->index_entries, matroska->nb_index_entries + 1,
+                                   sizeof(*entries));
+        if (!entries)
+            return;
+        matroska->index_entries = entries;
+        entries += matroska->nb_index_entries++;
+        entries->st        = st;
+        entries->pos       = pos;
+        entries->timestamp = timestamp;
+        entries->reduce    = reduce;
+        return;
+    }
+
+    if (reduce)
+        ff_reduce_index(matroska->ctx, st->index);
+    av_add_index_entry(st, pos, timestamp, 0, 0, AVINDEX_KEYFRAME);
+}
+
 static void matroska_add_index_entries(MatroskaDemuxContext *matroska)
 {
     EbmlList *index_list;
@@ -1895,10 +1958,9 @@ static void matroska_add_index_entries(MatroskaDemuxContext *matroska)
             MatroskaTrack *track = matroska_find_track_by_num(matroska,
                                                               pos[j].track);
             if (track && track->stream)
-                av_add_index_entry(track->stream,
-                                   pos[j].pos + matroska->segment_start,
-                                   index[i].time / index_scale, 0, 0,
-                                   AVINDEX_KEYFRAME);
+                matroska_add_index_entry(matroska, track->stream,
+                                         pos[j].pos + matroska->segment_start,
+                                         index[i].time / index_scale, 0);
         }
     }
 }
@@ -2416,6 +2478,7 @@ static int matroska_parse_tracks(AVFormatContext *s)
             av_free(key_id_base64);
             return AVERROR(ENOMEM);
         }
+        track->stream_index = st->index;
 
         if (key_id_base64) {
             /* export encryption key id as base64 metadata tag */
@@ -2953,6 +3016,12 @@ static int matroska_read_header(AVFormatContext *s)
 
     matroska_convert_tags(s);
 
+#if HAVE_THREADS
+    /* byte seeks would move the AVIOContext under the prefetch thread */
+    if (matroska->prefetch)
+        s->internal->no_byte_seek = 1;
+#endif
+
     return 0;
 fail:
     matroska_read_close(s);
@@ -3107,11 +3176,11 @@ static int matroska_parse_laces(MatroskaDemuxContext *matroska, uint8_t **buf,
 }
 
 static int matroska_parse_rm_audio(MatroskaDemuxContext *matroska,
-                                   MatroskaTrack *track, AVStream *st,
+                                   MatroskaTrack *track, const AVCodecParameters *par,
                                    uint8_t *data, int size, uint64_t timecode,
                                    int64_t pos)
 {
-    int a = st->codecpar->block_align;
+    int a = par->block_align;
     int sps = track->audio.sub_packet_size;
     int cfs = track->audio.coded_framesize;
     int h   = track->audio.sub_packet_h;
@@ -3122,7 +3191,7 @@ static int matroska_parse_rm_audio(MatroskaDemuxContext *matroska,
     if (!track->audio.pkt_cnt) {
         if (track->audio.sub_packet_cnt == 0)
             track->audio.buf_timecode = timecode;
-        if (st->codecpar->codec_id == AV_CODEC_ID_RA_288) {
+        if (par->codec_id == AV_CODEC_ID_RA_288) {
             if (size < cfs * h / 2) {
                 av_log(matroska->ctx, AV_LOG_ERROR,
                        "Corrupt int4 RM-style audio packet size\n");
@@ -3131,7 +3200,7 @@ static int matroska_parse_rm_audio(MatroskaDemuxContext *matroska,
             for (x = 0; x < h / 2; x++)
                 memcpy(track->audio.buf + x * 2 * w + y * cfs,
                        data + x * cfs, cfs);
-        } else if (st->codecpar->codec_id == AV_CODEC_ID_SIPR) {
+        } else if (par->codec_id == AV_CODEC_ID_SIPR) {
             if (size < w) {
                 av_log(matroska->ctx, AV_LOG_ERROR,
                        "Corrupt sipr RM-style audio packet size\n");
@@ -3151,7 +3220,7 @@ static int matroska_parse_rm_audio(MatroskaDemuxContext *matroska,
         }
 
         if (++track->audio.sub_packet_cnt >= h) {
-            if (st->codecpar->codec_id == AV_CODEC_ID_SIPR)
+            if (par->codec_id == AV_CODEC_ID_SIPR)
                 ff_rm_reorder_sipr_data(track->audio.buf, h, w);
             track->audio.sub_packet_cnt = 0;
             track->audio.pkt_cnt        = h * w / a;
@@ -3172,7 +3241,7 @@ static int matroska_parse_rm_audio(MatroskaDemuxContext *matroska,
         pkt->pts                  = track->audio.buf_timecode;
         track->audio.buf_timecode = AV_NOPTS_VALUE;
         pkt->pos                  = pos;
-        pkt->stream_index         = st->index;
+        pkt->stream_index         = track->stream_index;
         ret = ff_packet_list_put(&matroska->queue, &matroska->queue_end, pkt, 0);
         if (ret < 0) {
             av_packet_unref(pkt);
@@ -3184,7 +3253,7 @@ static int matroska_parse_rm_audio(MatroskaDemuxContext *matroska,
 }
 
 /* reconstruct full wavpack blocks from mangled matroska ones */
-static int matroska_parse_wavpack(MatroskaTrack *track, uint8_t *src,
+static int matroska_parse_wavpack(const AVCodecParameters *par, uint8_t *src,
                                   uint8_t **pdst, int *size)
 {
     uint8_t *dst = NULL;
@@ -3194,10 +3263,10 @@ static int matroska_parse_wavpack(MatroskaTrack *track, uint8_t *src,
     uint16_t ver;
     int ret, offset = 0;
 
-    if (srclen < 12 || track->stream->codecpar->extradata_size < 2)
+    if (srclen < 12 || par->extradata_size < 2)
         return AVERROR_INVALIDDATA;
 
-    ver = AV_RL16(track->stream->codecpar->extradata);
+    ver = AV_RL16(par->extradata);
 
     samples = AV_RL32(src);
     src    += 4;
@@ -3292,7 +3361,6 @@ static int matroska_parse_prores(MatroskaTrack *track, uint8_t *src,
 
 static int matroska_parse_webvtt(MatroskaDemuxContext *matroska,
                                  MatroskaTrack *track,
-                                 AVStream *st,
                                  uint8_t *data, int data_len,
                                  uint64_t timecode,
                                  uint64_t duration,
@@ -3387,7 +3455,7 @@ static int matroska_parse_webvtt(MatroskaDemuxContext *matroska,
     // Do we need this for subtitles?
     // pkt->flags = AV_PKT_FLAG_KEY;
 
-    pkt->stream_index = st->index;
+    pkt->stream_index = track->stream_index;
     pkt->pts = timecode;
 
     // Do we need this for subtitles?
@@ -3406,7 +3474,7 @@ static int matroska_parse_webvtt(MatroskaDemuxContext *matroska,
 }
 
 static int matroska_parse_frame(MatroskaDemuxContext *matroska,
-                                MatroskaTrack *track, AVStream *st,
+                                MatroskaTrack *track, const AVCodecParameters *par,
                                 AVBufferRef *buf, uint8_t *data, int pkt_size,
                                 uint64_t timecode, uint64_t lace_duration,
                                 int64_t pos, int is_keyframe,
@@ -3424,9 +3492,9 @@ static int matroska_parse_frame(MatroskaDemuxContext *matroska,
             return res;
     }
 
-    if (st->codecpar->codec_id == AV_CODEC_ID_WAVPACK) {
+    if (par->codec_id == AV_CODEC_ID_WAVPACK) {
         uint8_t *wv_data;
-        res = matroska_parse_wavpack(track, pkt_data, &wv_data, &pkt_size);
+        res = matroska_parse_wavpack(par, pkt_data, &wv_data, &pkt_size);
         if (res < 0) {
             av_log(matroska->ctx, AV_LOG_ERROR,
                    "Error parsing a wavpack block.\n");
@@ -3437,7 +3505,7 @@ static int matroska_parse_frame(MatroskaDemuxContext *matroska,
         pkt_data = wv_data;
     }
 
-    if (st->codecpar->codec_id == AV_CODEC_ID_PRORES) {
+    if (par->codec_id == AV_CODEC_ID_PRORES) {
         uint8_t *pr_data;
         res = matroska_parse_prores(track, pkt_data, &pr_data, &pkt_size);
         if (res < 0) {
@@ -3465,7 +3533,7 @@ static int matroska_parse_frame(MatroskaDemuxContext *matroska,
     pkt->data         = pkt_data;
     pkt->size         = pkt_size;
     pkt->flags        = is_keyframe;
-    pkt->stream_index = st->index;
+    pkt->stream_index = track->stream_index;
 
     if (additional_size > 0) {
         uint8_t *side_data = av_packet_new_side_data(pkt,
@@ -3489,7 +3557,7 @@ static int matroska_parse_frame(MatroskaDemuxContext *matroska,
         }
         discard_padding = av_rescale_q(discard_padding,
                                             (AVRational){1, 1000000000},
-                                            (AVRational){1, st->codecpar->sample_rate});
+                                            (AVRational){1, par->sample_rate});
         if (discard_padding > 0) {
             AV_WL32(side_data + 4, discard_padding);
         } else {
@@ -3506,7 +3574,7 @@ static int matroska_parse_frame(MatroskaDemuxContext *matroska,
 
 #if FF_API_CONVERGENCE_DURATION
 FF_DISABLE_DEPRECATION_WARNINGS
-    if (st->codecpar->codec_id == AV_CODEC_ID_SUBRIP) {
+    if (par->codec_id == AV_CODEC_ID_SUBRIP) {
         pkt->convergence_duration = lace_duration;
     }
 FF_ENABLE_DEPRECATION_WARNINGS
@@ -3536,6 +3604,9 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
     MatroskaTrack *track;
     int res = 0;
     AVStream *st;
+    const AVCodecParameters *par;
+    enum AVDiscard discard;
+    int skip_to_keyframe;
     int16_t block_time;
     uint32_t *lace_size = NULL;
     int n, flags, laces = 0;
@@ -3556,7 +3627,16 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
     } else if (size <= 3)
         return 0;
     st = track->stream;
-    if (st->discard >= AVDISCARD_ALL)
+    if (matroska_prefetching(matroska)) {
+        par              = track->prefetch_par;
+        discard          = track->prefetch_discard;
+        skip_to_keyframe = track->prefetch_skip_to_keyframe;
+    } else {
+        par              = st->codecpar;
+        discard          = st->discard;
+        skip_to_keyframe = st->skip_to_keyframe;
+    }
+    if (discard >= AVDISCARD_ALL)
         return res;
     av_assert1(block_duration != AV_NOPTS_VALUE);
 
@@ -3573,11 +3653,8 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
         if (track->type == MATROSKA_TRACK_TYPE_SUBTITLE &&
             timecode < track->end_timecode)
             is_keyframe = 0;  /* overlapping subtitles are not key frame */
-        if (is_keyframe) {
-            ff_reduce_index(matroska->ctx, st->index);
-            av_add_index_entry(st, cluster_pos, timecode, 0, 0,
-                               AVINDEX_KEYFRAME);
-        }
+        if (is_keyframe)
+            matroska_add_index_entry(matroska, st, cluster_pos, timecode, 1);
     }
 
     if (matroska->skip_to_keyframe &&
@@ -3589,7 +3666,7 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
             return res;
         if (is_keyframe)
             matroska->skip_to_keyframe = 0;
-        else if (!st->skip_to_keyframe) {
+        else if (!skip_to_keyframe) {
             av_log(matroska->ctx, AV_LOG_ERROR, "File is broken, keyframes not correctly marked!\n");
             matroska->skip_to_keyframe = 0;
         }
@@ -3603,8 +3680,8 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
 
     if (track->audio.samplerate == 8000) {
         // If this is needed for more codecs, then add them here
-        if (st->codecpar->codec_id == AV_CODEC_ID_AC3) {
-            if (track->audio.samplerate != st->codecpar->sample_rate || !st->codecpar->frame_size)
+        if (par->codec_id == AV_CODEC_ID_AC3) {
+            if (track->audio.samplerate != par->sample_rate || !par->frame_size)
                 trust_default_duration = 0;
         }
     }
@@ -3624,26 +3701,26 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
             break;
         }
 
-        if ((st->codecpar->codec_id == AV_CODEC_ID_RA_288 ||
-             st->codecpar->codec_id == AV_CODEC_ID_COOK   ||
-             st->codecpar->codec_id == AV_CODEC_ID_SIPR   ||
-             st->codecpar->codec_id == AV_CODEC_ID_ATRAC3) &&
-            st->codecpar->block_align && track->audio.sub_packet_size) {
-            res = matroska_parse_rm_audio(matroska, track, st, data,
+        if ((par->codec_id == AV_CODEC_ID_RA_288 ||
+             par->codec_id == AV_CODEC_ID_COOK   ||
+             par->codec_id == AV_CODEC_ID_SIPR   ||
+             par->codec_id == AV_CODEC_ID_ATRAC3) &&
+            par->block_align && track->audio.sub_packet_size) {
+            res = matroska_parse_rm_audio(matroska, track, par, data,
                                           lace_size[n],
                                           timecode, pos);
             if (res)
                 goto end;
 
-        } else if (st->codecpar->codec_id == AV_CODEC_ID_WEBVTT) {
-            res = matroska_parse_webvtt(matroska, track, st,
+        } else if (par->codec_id == AV_CODEC_ID_WEBVTT) {
+            res = matroska_parse_webvtt(matroska, track,
                                         data, lace_size[n],
                                         timecode, lace_duration,
                                         pos);
             if (res)
                 goto end;
         } else {
-            res = matroska_parse_frame(matroska, track, st, buf, data, lace_size[n],
+            res = matroska_parse_frame(matroska, track, par, buf, data, lace_size[n],
                                        timecode, lace_duration, pos,
                                        !n ? is_keyframe : 0,
                                        additional, additional_id, additional_size,
@@ -3719,14 +3796,14 @@ static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
     return res;
 }
 
-static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
+static int matroska_read_packet_internal(MatroskaDemuxContext *matroska,
+                                        AVPacket *pkt)
 {
-    MatroskaDemuxContext *matroska = s->priv_data;
     int ret = 0;
 
     if (matroska->resync_pos == -1) {
         // This can only happen if generic seeking has been used.
-        matroska->resync_pos = avio_tell(s->pb);
+        matroska->resync_pos = avio_tell(matroska->ctx->pb);
     }
 
     while (matroska_deliver_packet(matroska, pkt)) {
@@ -3739,6 +3816,198 @@ static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
     return 0;
 }
 
+#if HAVE_THREADS
+static void matroska_add_queued_index_entries(MatroskaDemuxContext *matroska,
+                                              MatroskaIndexEntry *entries, int nb_entries)
+{
+    int i;
+
+    for (i = 0; i < nb_entries; i++) {
+        if (entries[i].reduce)
+            ff_reduce_index(matroska->ctx, entries[i].st->index);
+        av_add_index_entry(entries[i].st, entries[i].pos, entries[i].timestamp,
+                           0, 0, AVINDEX_KEYFRAME);
+    }
+}
+
+typedef struct MatroskaPrefetchMessage {
+    AVPacket pkt;
+    MatroskaIndexEntry *index_entries;
+    int nb_index_entries;
+} MatroskaPrefetchMessage;
+
+/*
+ * While the prefetch thread runs, it owns the AVIOContext and the parsing
+ * state. Everything else must stop it first. The thread does not access the
+ * streams, they are updated by the caller meanwhile.
+ */
+static void *matroska_prefetch_thread(void *arg)
+{
+    MatroskaDemuxContext *matroska = arg;
+    AVIOContext *pb = matroska->ctx->pb;
+    MatroskaPrefetchMessage msg;
+    int ret;
+
+    while ((ret = matroska_read_packet_internal(matroska, &msg.pkt)) >= 0) {
+        msg.index_entries    = matroska->index_entries;
+        msg.nb_index_entries = matroska->nb_index_entries;
+        matroska->index_entries    = NULL;
+        matroska->nb_index_entries = 0;
+
+        ret = av_thread_message_queue_send(matroska->prefetch_queue, &msg, 0);
+        if (ret < 0) {
+            /* keep the entries for matroska_prefetch_stop() */
+            matroska->index_entries    = msg.index_entries;
+            matroska->nb_index_entries = msg.nb_index_entries;
+            av_packet_unref(&msg.pkt);
+            break;
+        }
+
+        /* Load deferred cues between clusters once enough packets are
+         * queued, so that a later seek does not have to wait for them. */
+        if (matroska->cues_parsing_deferred > 0 && matroska->num_levels == 1 &&
+            (pb->seekable & AVIO_SEEKABLE_NORMAL) &&
+            av_thread_message_queue_nb_elems(matroska->prefetch_queue) >= matroska->prefetch / 2) {
+            matroska->cues_parsing_deferred = 0;
+            matroska_parse_cues(matroska);
+        }
+    }
+
+    av_thread_message_queue_set_err_recv(matroska->prefetch_queue, ret);
+    return NULL;
+}
+
+static void matroska_free_prefetch_message(void *arg)
+{
+    MatroskaPrefetchMessage *msg = arg;
+
+    av_packet_unref(&msg->pkt);
+    av_freep(&msg->index_entries);
+}
+
+static void matroska_prefetch_free_tracks(MatroskaDemuxContext *matroska)
+{
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    int i;
+
+    for (i = 0; i < matroska->tracks.nb_elem; i++)
+        avcodec_parameters_free(&tracks[i].prefetch_par);
+}
+
+static int matroska_prefetch_start(MatroskaDemuxContext *matroska)
+{
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    int i, ret;
+
+    for (i = 0; i < matroska->tracks.nb_elem; i++) {
+        MatroskaTrack *track = &tracks[i];
+        AVStream *st = track->stream;
+
+        if (!st)
+            continue;
+        track->prefetch_discard          = st->discard;
+        track->prefetch_skip_to_keyframe = st->skip_to_keyframe;
+        if (!(track->prefetch_par = avcodec_parameters_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        if ((ret = avcodec_parameters_copy(track->prefetch_par, st->codecpar)) < 0)
+            goto fail;
+    }
+
+    ret = av_thread_message_queue_alloc(&matroska->prefetch_queue,
+                                        matroska->prefetch, sizeof(MatroskaPrefetchMessage));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(matroska->prefetch_queue,
+                                          matroska_free_prefetch_message);
+
+    ret = AVERROR(pthread_create(&matroska->prefetch_thread, NULL,
+                                 matroska_prefetch_thread, matroska));
+    if (ret < 0) {
+        av_log(matroska->ctx, AV_LOG_ERROR, "Failed to start the prefetch thread\n");
+        av_thread_message_queue_free(&matroska->prefetch_queue);
+        goto fail;
+    }
+    return 0;
+fail:
+    matroska_prefetch_free_tracks(matroska);
+    return ret;
+}
+
+static void matroska_prefetch_stop(MatroskaDemuxContext *matroska)
+{
+    MatroskaPrefetchMessage msg;
+
+    if (!matroska->prefetch_queue)
+        return;
+
+    av_thread_message_queue_set_err_send(matroska->prefetch_queue, AVERROR_EXIT);
+    pthread_join(matroska->prefetch_thread, NULL);
+
+    /* drop the queued packets, but keep the index entries found with them */
+    while (av_thread_message_queue_recv(matroska->prefetch_queue, &msg,
+                                        AV_THREAD_MESSAGE_NONBLOCK) >= 0) {
+        matroska_add_queued_index_entries(matroska, msg.index_entries, msg.nb_index_entries);
+        matroska_free_prefetch_message(&msg);
+    }
+    av_thread_message_queue_free(&matroska->prefetch_queue);
+
+    matroska_add_queued_index_entries(matroska, matroska->index_entries,
+                                      matroska->nb_index_entries);
+    av_freep(&matroska->index_entries);
+    matroska->nb_index_entries = 0;
+
+    matroska_prefetch_free_tracks(matroska);
+}
+
+static int matroska_prefetch_read_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    MatroskaDemuxContext *matroska = s->priv_data;
+    MatroskaPrefetchMessage msg;
+    int ret;
+
+    if (!matroska->prefetch_queue &&
+        (ret = matroska_prefetch_start(matroska)) < 0)
+        return ret;
+
+    for (;;) {
+        ret = av_thread_message_queue_recv(matroska->prefetch_queue, &msg, 0);
+        if (ret < 0) {
+            /* the thread has ended, add the entries it found last */
+            matroska_prefetch_stop(matroska);
+            return ret;
+        }
+
+        matroska_add_queued_index_entries(matroska, msg.index_entries, msg.nb_index_entries);
+        av_freep(&msg.index_entries);
+
+        /* streams discarded after the thread was started are dropped here */
+        if (s->streams[msg.pkt.stream_index]->discard < AVDISCARD_ALL) {
+            av_packet_move_ref(pkt, &msg.pkt);
+            return 0;
+        }
+        av_packet_unref(&msg.pkt);
+    }
+}
+#else
+static void matroska_prefetch_stop(MatroskaDemuxContext *matroska)
+{
+}
+#endif
+
+static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    MatroskaDemuxContext *matroska = s->priv_data;
+
+#if HAVE_THREADS
+    if (matroska->prefetch)
+        return matroska_prefetch_read_packet(s, pkt);
+#endif
+
+    return matroska_read_packet_internal(matroska, pkt);
+}
+
 static int matroska_read_seek(AVFormatContext *s, int stream_index,
                               int64_t timestamp, int flags)
 {
@@ -3747,6 +4016,8 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     AVStream *st = s->streams[stream_index];
     int i, index;
 
+    matroska_prefetch_stop(matroska);
+
     /* Parse the CUES now since we need the index data to seek. */
     if (matroska->cues_parsing_deferred > 0) {
         matroska->cues_parsing_deferred = 0;
@@ -3809,6 +4080,7 @@ static int matroska_read_close(AVFormatContext *s)
     MatroskaTrack *tracks = matroska->tracks.elem;
     int n;
 
+    matroska_prefetch_stop(matroska);
     matroska_clear_queue(matroska);
 
     for (n = 0; n < matroska->tracks.nb_elem; n++)
@@ -4219,6 +4491,18 @@ static const AVOption options[] = {
     { NULL },
 };
 
+static const AVOption matroska_options[] = {
+    { "prefetch", "number of packets to read ahead on a background thread", OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX / sizeof(AVPacket), AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 static const AVClass webm_dash_class = {
     .class_name = "WebM DASH Manifest demuxer",
     .item_name  = av_default_item_name,
@@ -4236,7 +4520,8 @@ AVInputFormat ff_matroska_demuxer = {
     .read_packet    = matroska_read_packet,
     .read_close     = matroska_read_close,
     .read_seek      = matroska_read_seek,
-    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska"
+    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska",
+    .priv_class     = &matroska_class,
 };
 
 AVInputFormat ff_webm_dash_manifest_demuxer = {
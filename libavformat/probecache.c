@@ -0,0 +1,528 @@
+/*
+ * Stream info cache
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Stream info cache
+ *
+ * The result of avformat_find_stream_info() and the index entries of the
+ * streams are stored in a file of the AVFormatContext.probe_cache directory,
+ * so that later opens of the same local file can skip probing, duration
+ * estimation and the timestamp scanning needed to rebuild the index.
+ *
+ * Index entries built by the demuxer while reading the header, e.g. from
+ * the mov sample tables, are not stored as they are rebuilt anyway.
+ *
+ * A cache file is only used if the absolute path, device, inode, size and
+ * modification time (in nanoseconds where available) of the input, the input
+ * format and the libavformat version all match. Formats which may add streams
+ * after the header (AVFMTCTX_NOHEADER) are not cached while that flag is set.
+ *
+ * File layout, all numbers little endian:
+ *   header:  "FFPC", cache version, LIBAVFORMAT_VERSION_INT, path, device,
+ *            inode, size, mtime, input format name
+ *   format:  start_time, duration, bit_rate, duration_estimation_method,
+ *            nb_streams
+ *   stream:  stream and codec parameters, extradata, index entries
+ * Strings and extradata are stored with a 32 bit length prefix.
+ */
+
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "os_support.h"
+#include "version.h"
+
+#define CACHE_VERSION 3
+#define CACHE_MAX_STRING 4096
+
+typedef struct CacheKey {
+    char path[CACHE_MAX_STRING];
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime;              ///< in nanoseconds
+    char filename[1024];
+} CacheKey;
+
+/**
+ * Stream info read from a cache file, applied to the stream only once the
+ * whole file has been read and found to match the input.
+ */
+typedef struct CacheStream {
+    AVRational time_base;
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+    int disposition;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+    AVRational sample_aspect_ratio;
+    AVCodecParameters *par;
+
+    /* fields of the codec context unavailable in AVCodecParameters */
+    AVRational avctx_time_base;
+    AVRational framerate;
+    int ticks_per_frame;
+    int coded_width;
+    int coded_height;
+    unsigned properties;
+
+    AVIndexEntry *index_entries;
+    int nb_index_entries;
+    unsigned index_entries_allocated_size;
+    int index_complete;
+} CacheStream;
+
+/**
+ * Make path absolute and resolve symbolic links, so that the same relative
+ * url opened from different directories does not share a cache file.
+ */
+static int resolve_path(char *dst, size_t dst_size, const char *path)
+{
+#ifdef _WIN32
+    char *abs_path = _fullpath(NULL, path, 0);
+#else
+    char *abs_path = realpath(path, NULL);
+#endif
+    size_t len;
+
+    if (!abs_path)
+        return AVERROR(ENOSYS);
+    len = av_strlcpy(dst, abs_path, dst_size);
+    free(abs_path);
+    return len < dst_size ? 0 : AVERROR(ENOSYS);
+}
+
+/**
+ * Identify the input and derive the name of its cache file.
+ * Only local files are cached, as their identity can be checked cheaply.
+ */
+static int get_cache_key(AVFormatContext *s, CacheKey *key)
+{
+    const char *proto, *path;
+    struct stat st;
+    uint32_t crc0, crc1;
+    int ret;
+
+    if (!s->probe_cache || !*s->probe_cache || !s->url || !s->iformat ||
+        (s->flags & AVFMT_FLAG_CUSTOM_IO))
+        return AVERROR(ENOSYS);
+
+    /* streams may still be added while reading packets, e.g. in MPEG-PS,
+     * so the stream count stored in the cache cannot be checked */
+    if (s->ctx_flags & AVFMTCTX_NOHEADER)
+        return AVERROR(ENOSYS);
+
+    proto = avio_find_protocol_name(s->url);
+    if (!proto || strcmp(proto, "file"))
+        return AVERROR(ENOSYS);
+    path = s->url;
+    av_strstart(path, "file:", &path);
+
+    if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+        return AVERROR(ENOSYS);
+    if ((ret = resolve_path(key->path, sizeof(key->path), path)) < 0)
+        return ret;
+    key->dev   = st.st_dev;
+    key->ino   = st.st_ino;
+    key->size  = st.st_size;
+    key->mtime = st.st_mtime * INT64_C(1000000000);
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    key->mtime += st.st_mtim.tv_nsec;
+#endif
+
+    crc0 = av_crc(av_crc_get_table(AV_CRC_32_IEEE),    0, key->path, strlen(key->path));
+    crc1 = av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), 0, key->path, strlen(key->path));
+    snprintf(key->filename, sizeof(key->filename), "%s/%08"PRIx32"%08"PRIx32".ffpc",
+             s->probe_cache, crc0, crc1);
+    return 0;
+}
+
+static void put_str(AVIOContext *pb, const char *str)
+{
+    size_t len = strlen(str);
+    avio_wl32(pb, len);
+    avio_write(pb, str, len);
+}
+
+static void put_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wl32(pb, q.num);
+    avio_wl32(pb, q.den);
+}
+
+static int check_str(AVIOContext *pb, const char *str)
+{
+    char buf[CACHE_MAX_STRING];
+    unsigned len = avio_rl32(pb);
+
+    if (len != strlen(str) || len >= sizeof(buf) || avio_read(pb, buf, len) != len)
+        return 0;
+    return !memcmp(buf, str, len);
+}
+
+static AVRational get_rational(AVIOContext *pb)
+{
+    AVRational q;
+    q.num = avio_rl32(pb);
+    q.den = avio_rl32(pb);
+    return q;
+}
+
+static void write_stream(AVIOContext *pb, AVStream *st)
+{
+    AVCodecParameters *par = st->codecpar;
+    AVCodecContext  *avctx = st->internal->avctx;
+    int i, nb_entries;
+
+    avio_wl32(pb, st->id);
+    put_rational(pb, st->time_base);
+    avio_wl64(pb, st->start_time);
+    avio_wl64(pb, st->duration);
+    avio_wl64(pb, st->nb_frames);
+    avio_wl32(pb, st->disposition);
+    put_rational(pb, st->avg_frame_rate);
+    put_rational(pb, st->r_frame_rate);
+    put_rational(pb, st->sample_aspect_ratio);
+
+    avio_wl32(pb, par->codec_type);
+    avio_wl32(pb, par->codec_id);
+    avio_wl32(pb, par->codec_tag);
+    avio_wl32(pb, par->format);
+    avio_wl64(pb, par->bit_rate);
+    avio_wl32(pb, par->bits_per_coded_sample);
+    avio_wl32(pb, par->bits_per_raw_sample);
+    avio_wl32(pb, par->profile);
+    avio_wl32(pb, par->level);
+    avio_wl32(pb, par->width);
+    avio_wl32(pb, par->height);
+    put_rational(pb, par->sample_aspect_ratio);
+    avio_wl32(pb, par->field_order);
+    avio_wl32(pb, par->color_range);
+    avio_wl32(pb, par->color_primaries);
+    avio_wl32(pb, par->color_trc);
+    avio_wl32(pb, par->color_space);
+    avio_wl32(pb, par->chroma_location);
+    avio_wl32(pb, par->video_delay);
+    avio_wl64(pb, par->channel_layout);
+    avio_wl32(pb, par->channels);
+    avio_wl32(pb, par->sample_rate);
+    avio_wl32(pb, par->block_align);
+    avio_wl32(pb, par->frame_size);
+    avio_wl32(pb, par->initial_padding);
+    avio_wl32(pb, par->trailing_padding);
+    avio_wl32(pb, par->seek_preroll);
+    avio_wl32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+
+    /* fields of the codec context unavailable in AVCodecParameters */
+    put_rational(pb, avctx->time_base);
+    put_rational(pb, avctx->framerate);
+    avio_wl32(pb, avctx->ticks_per_frame);
+    avio_wl32(pb, avctx->coded_width);
+    avio_wl32(pb, avctx->coded_height);
+    avio_wl32(pb, avctx->properties);
+
+    nb_entries = st->internal->header_index ? 0 : st->nb_index_entries;
+    avio_wl32(pb, nb_entries);
+    for (i = 0; i < nb_entries; i++) {
+        AVIndexEntry *e = &st->index_entries[i];
+        avio_wl64(pb, e->pos);
+        avio_wl64(pb, e->timestamp);
+        avio_wl32(pb, e->flags);
+        avio_wl32(pb, e->size);
+        avio_wl32(pb, e->min_distance);
+    }
+    avio_wl32(pb, nb_entries ? st->internal->index_complete : 0);
+}
+
+static int read_stream(AVFormatContext *s, AVIOContext *pb, AVStream *st, CacheStream *cst)
+{
+    AVCodecParameters *par;
+    unsigned size, nb_entries;
+    int i, ret;
+
+    if (avio_rl32(pb) != st->id)
+        return AVERROR_INVALIDDATA;
+    cst->time_base           = get_rational(pb);
+    cst->start_time          = avio_rl64(pb);
+    cst->duration            = avio_rl64(pb);
+    cst->nb_frames           = avio_rl64(pb);
+    cst->disposition         = avio_rl32(pb);
+    cst->avg_frame_rate      = get_rational(pb);
+    cst->r_frame_rate        = get_rational(pb);
+    cst->sample_aspect_ratio = get_rational(pb);
+
+    /* the demuxer set up the stream while reading the header, but the
+     * codec id may be refined by probing, e.g. mp3 to mp2 */
+    if (avio_rl32(pb) != st->codecpar->codec_type)
+        return AVERROR_INVALIDDATA;
+
+    if (!(cst->par = par = avcodec_parameters_alloc()))
+        return AVERROR(ENOMEM);
+    par->codec_type            = st->codecpar->codec_type;
+    par->codec_id              = avio_rl32(pb);
+    par->codec_tag             = avio_rl32(pb);
+    par->format                = avio_rl32(pb);
+    par->bit_rate              = avio_rl64(pb);
+    par->bits_per_coded_sample = avio_rl32(pb);
+    par->bits_per_raw_sample   = avio_rl32(pb);
+    par->profile               = avio_rl32(pb);
+    par->level                 = avio_rl32(pb);
+    par->width                 = avio_rl32(pb);
+    par->height                = avio_rl32(pb);
+    par->sample_aspect_ratio   = get_rational(pb);
+    par->field_order           = avio_rl32(pb);
+    par->color_range           = avio_rl32(pb);
+    par->color_primaries       = avio_rl32(pb);
+    par->color_trc             = avio_rl32(pb);
+    par->color_space           = avio_rl32(pb);
+    par->chroma_location       = avio_rl32(pb);
+    par->video_delay           = avio_rl32(pb);
+    par->channel_layout        = avio_rl64(pb);
+    par->channels              = avio_rl32(pb);
+    par->sample_rate           = avio_rl32(pb);
+    par->block_align           = avio_rl32(pb);
+    par->frame_size            = avio_rl32(pb);
+    par->initial_padding       = avio_rl32(pb);
+    par->trailing_padding      = avio_rl32(pb);
+    par->seek_preroll          = avio_rl32(pb);
+
+    size = avio_rl32(pb);
+    if (size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR_INVALIDDATA;
+    if (size && (ret = ff_get_extradata(s, par, pb, size)) < 0)
+        return ret;
+
+    cst->avctx_time_base = get_rational(pb);
+    cst->framerate       = get_rational(pb);
+    cst->ticks_per_frame = avio_rl32(pb);
+    cst->coded_width     = avio_rl32(pb);
+    cst->coded_height    = avio_rl32(pb);
+    cst->properties      = avio_rl32(pb);
+
+    nb_entries = avio_rl32(pb);
+    if (nb_entries > INT_MAX / sizeof(*cst->index_entries))
+        return AVERROR_INVALIDDATA;
+    for (i = 0; i < nb_entries && !avio_feof(pb); i++) {
+        int64_t pos       = avio_rl64(pb);
+        int64_t timestamp = avio_rl64(pb);
+        int flags         = avio_rl32(pb);
+        int size          = avio_rl32(pb);
+        int distance      = avio_rl32(pb);
+
+        if (st->internal->header_index || (s->flags & AVFMT_FLAG_IGNIDX))
+            continue;
+        if (ff_add_index_entry(&cst->index_entries, &cst->nb_index_entries,
+                               &cst->index_entries_allocated_size,
+                               pos, timestamp, size, distance, flags) < 0)
+            return AVERROR(ENOMEM);
+    }
+    cst->index_complete = avio_rl32(pb) && cst->nb_index_entries;
+
+    return avio_feof(pb) ? AVERROR_INVALIDDATA : 0;
+}
+
+static int apply_stream(AVStream *st, CacheStream *cst)
+{
+    AVCodecContext *avctx = st->internal->avctx;
+    int ret;
+
+    if ((ret = avcodec_parameters_copy(st->codecpar, cst->par)) < 0 ||
+        (ret = avcodec_parameters_to_context(avctx, st->codecpar)) < 0)
+        return ret;
+    avctx->time_base       = cst->avctx_time_base;
+    avctx->framerate       = cst->framerate;
+    avctx->ticks_per_frame = cst->ticks_per_frame;
+    avctx->coded_width     = cst->coded_width;
+    avctx->coded_height    = cst->coded_height;
+    avctx->properties      = cst->properties;
+
+    st->time_base           = cst->time_base;
+    st->start_time          = cst->start_time;
+    st->duration            = cst->duration;
+    st->nb_frames           = cst->nb_frames;
+    st->disposition         = cst->disposition;
+    st->avg_frame_rate      = cst->avg_frame_rate;
+    st->r_frame_rate        = cst->r_frame_rate;
+    st->sample_aspect_ratio = cst->sample_aspect_ratio;
+
+    if (!st->internal->header_index) {
+        av_freep(&st->index_entries);
+        st->index_entries                = cst->index_entries;
+        st->nb_index_entries             = cst->nb_index_entries;
+        st->index_entries_allocated_size = cst->index_entries_allocated_size;
+        st->internal->index_complete     = cst->index_complete;
+        cst->index_entries               = NULL;
+    }
+
+    return 0;
+}
+
+static int count_index_entries(AVFormatContext *s)
+{
+    int i, nb = 0;
+
+    for (i = 0; i < s->nb_streams; i++)
+        if (!s->streams[i]->internal->header_index)
+            nb += s->streams[i]->nb_index_entries;
+    return nb;
+}
+
+int ff_probe_cache_load(AVFormatContext *s)
+{
+    AVIOContext *pb = NULL;
+    CacheStream *streams = NULL;
+    CacheKey key;
+    int64_t start_time, duration, bit_rate;
+    int duration_estimation_method;
+    int i, ret;
+
+    for (i = 0; i < s->nb_streams; i++)
+        s->streams[i]->internal->header_index = s->streams[i]->nb_index_entries > 0;
+
+    if ((ret = get_cache_key(s, &key)) < 0)
+        return ret;
+    if (avio_open(&pb, key.filename, AVIO_FLAG_READ) < 0)
+        return AVERROR(ENOENT);
+
+    ret = AVERROR_INVALIDDATA;
+    if (avio_rl32(pb) != MKTAG('F','F','P','C')   ||
+        avio_rl32(pb) != CACHE_VERSION            ||
+        avio_rl32(pb) != LIBAVFORMAT_VERSION_INT  ||
+        !check_str(pb, key.path)                  ||
+        avio_rl64(pb) != key.dev                  ||
+        avio_rl64(pb) != key.ino                  ||
+        avio_rl64(pb) != key.size                 ||
+        avio_rl64(pb) != key.mtime                ||
+        !check_str(pb, s->iformat->name))
+        goto end;
+
+    start_time                 = avio_rl64(pb);
+    duration                   = avio_rl64(pb);
+    bit_rate                   = avio_rl64(pb);
+    duration_estimation_method = avio_rl32(pb);
+    if (avio_rl32(pb) != s->nb_streams || avio_feof(pb))
+        goto end;
+
+    if (!(streams = av_mallocz_array(s->nb_streams, sizeof(*streams)))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < s->nb_streams; i++) {
+        if ((ret = read_stream(s, pb, s->streams[i], &streams[i])) < 0)
+            goto end;
+    }
+
+    /* the whole file matches, nothing was changed before this point */
+    s->start_time                 = start_time;
+    s->duration                   = duration;
+    s->bit_rate                   = bit_rate;
+    s->duration_estimation_method = duration_estimation_method;
+    for (i = 0; i < s->nb_streams; i++) {
+        if ((ret = apply_stream(s->streams[i], &streams[i])) < 0)
+            goto end;
+    }
+
+    s->internal->probe_cache_entries = count_index_entries(s);
+    s->internal->probe_cache_valid   = 1;
+    av_log(s, AV_LOG_VERBOSE, "Stream info loaded from %s\n", key.filename);
+    ret = 0;
+end:
+    if (ret < 0)
+        av_log(s, AV_LOG_VERBOSE, "Stream info cache %s does not match the input\n",
+               key.filename);
+    if (streams) {
+        for (i = 0; i < s->nb_streams; i++) {
+            avcodec_parameters_free(&streams[i].par);
+            av_freep(&streams[i].index_entries);
+        }
+        av_freep(&streams);
+    }
+    avio_closep(&pb);
+    return ret;
+}
+
+int ff_probe_cache_save(AVFormatContext *s)
+{
+    AVIOContext *pb = NULL;
+    CacheKey key;
+    char tmpname[sizeof(key.filename) + 4];
+    int i, ret;
+
+    if ((ret = get_cache_key(s, &key)) < 0)
+        return ret;
+
+    snprintf(tmpname, sizeof(tmpname), "%s.tmp", key.filename);
+    if ((ret = avio_open(&pb, tmpname, AVIO_FLAG_WRITE)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not create stream info cache %s\n", tmpname);
+        return ret;
+    }
+
+    avio_wl32(pb, MKTAG('F','F','P','C'));
+    avio_wl32(pb, CACHE_VERSION);
+    avio_wl32(pb, LIBAVFORMAT_VERSION_INT);
+    put_str(pb, key.path);
+    avio_wl64(pb, key.dev);
+    avio_wl64(pb, key.ino);
+    avio_wl64(pb, key.size);
+    avio_wl64(pb, key.mtime);
+    put_str(pb, s->iformat->name);
+
+    avio_wl64(pb, s->start_time);
+    avio_wl64(pb, s->duration);
+    avio_wl64(pb, s->bit_rate);
+    avio_wl32(pb, s->duration_estimation_method);
+    avio_wl32(pb, s->nb_streams);
+    for (i = 0; i < s->nb_streams; i++)
+        write_stream(pb, s->streams[i]);
+
+    avio_flush(pb);
+    ret = pb->error;
+    avio_closep(&pb);
+    if (ret >= 0)
+        ret = ff_rename(tmpname, key.filename, s);
+    if (ret < 0) {
+        avpriv_io_delete(tmpname);
+        return ret;
+    }
+
+    s->internal->probe_cache_entries = count_index_entries(s);
+    s->internal->probe_cache_valid   = 1;
+    av_log(s, AV_LOG_VERBOSE, "Stream info saved to %s\n", key.filename);
+    return 0;
+}
+
+int ff_probe_cache_update(AVFormatContext *s)
+{
+    if (!s->internal->probe_cache_valid ||
+        count_index_entries(s) <= s->internal->probe_cache_entries)
+        return 0;
+    return ff_probe_cache_save(s);
+}
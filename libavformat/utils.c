@@ -26,6 +26,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/cpu.h"
 #include "libavutil/dict.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
@@ -2459,6 +2460,69 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     return 0;
 }
 
+/**
+ * Read the whole input once and index the keyframes of a stream, so that
+ * later seeks can jump to a keyframe directly.
+ */
+static int build_keyframe_index(AVFormatContext *s, int stream_index)
+{
+    AVStream *st = s->streams[stream_index];
+    /* streams may be added while reading, only these are restored */
+    unsigned int nb_streams = s->nb_streams;
+    enum AVDiscard *discard;
+    int64_t start_time = av_gettime_relative();
+    AVPacket pkt;
+    int i, ret;
+
+    discard = av_malloc_array(nb_streams, sizeof(*discard));
+    if (!discard)
+        return AVERROR(ENOMEM);
+
+    /* the other streams are skipped by demuxers that honor discard */
+    for (i = 0; i < nb_streams; i++) {
+        discard[i] = s->streams[i]->discard;
+        if (i != stream_index)
+            s->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    ff_read_frame_flush(s);
+    if ((ret = avio_seek(s->pb, s->internal->data_offset, SEEK_SET)) < 0)
+        goto end;
+
+    /* drop the entries left by timestamp bisection, they may not be keyframes */
+    av_freep(&st->index_entries);
+    st->nb_index_entries = 0;
+    st->index_entries_allocated_size = 0;
+
+    for (;;) {
+        ret = read_frame_internal(s, &pkt);
+        if (ret == AVERROR(EAGAIN))
+            continue;
+        if (ret < 0)
+            break;
+        if (pkt.stream_index == stream_index && pkt.flags & AV_PKT_FLAG_KEY &&
+            pkt.dts != AV_NOPTS_VALUE && pkt.pos >= 0) {
+            ff_reduce_index(s, stream_index);
+            av_add_index_entry(st, pkt.pos, pkt.dts, 0, 0, AVINDEX_KEYFRAME);
+        }
+        av_packet_unref(&pkt);
+    }
+    ret = ret == AVERROR_EOF ? 0 : ret;
+    if (ret >= 0) {
+        st->internal->index_complete = 1;
+        av_log(s, AV_LOG_VERBOSE, "Built index of stream %d with %d keyframes in %.1f ms\n",
+               stream_index, st->nb_index_entries,
+               (av_gettime_relative() - start_time) / 1000.0);
+    }
+
+end:
+    for (i = 0; i < nb_streams; i++)
+        s->streams[i]->discard = discard[i];
+    av_free(discard);
+    ff_read_frame_flush(s);
+    return ret;
+}
+
 static int seek_frame_internal(AVFormatContext *s, int stream_index,
                                int64_t timestamp, int flags)
 {
@@ -2466,7 +2530,7 @@ static int seek_frame_internal(AVFormatContext *s, int stream_index,
     AVStream *st;
 
     if (flags & AVSEEK_FLAG_BYTE) {
-        if (s->iformat->flags & AVFMT_NO_BYTE_SEEK)
+        if (s->iformat->flags & AVFMT_NO_BYTE_SEEK || s->internal->no_byte_seek)
             return -1;
         ff_read_frame_flush(s);
         return seek_frame_byte(s, stream_index, timestamp, flags);
@@ -2482,6 +2546,30 @@ static int seek_frame_internal(AVFormatContext *s, int stream_index,
         timestamp = av_rescale(timestamp, st->time_base.den,
                                AV_TIME_BASE * (int64_t) st->time_base.num);
     }
+    st = s->streams[stream_index];
+
+    if (s->build_index && !s->iformat->read_seek && !st->internal->index_complete &&
+        s->pb && (s->pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+        ret = build_keyframe_index(s, stream_index);
+        if (ret < 0)
+            av_log(s, AV_LOG_WARNING, "Could not build the index of stream %d\n", stream_index);
+    }
+
+    /* a complete keyframe index allows jumping to the keyframe directly,
+     * and when it has no matching entry there is no keyframe to seek to */
+    if (st->internal->index_complete) {
+        int index = av_index_search_timestamp(st, timestamp, flags);
+        AVIndexEntry *ie;
+
+        if (index < 0)
+            return -1;
+        ie = &st->index_entries[index];
+        ff_read_frame_flush(s);
+        if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
+            return ret;
+        ff_update_cur_dts(s, st, ie->timestamp);
+        return 0;
+    }
 
     /* first, we try the format specific seek */
     if (s->iformat->read_seek) {
@@ -3564,6 +3652,112 @@ static int extract_extradata(AVStream *st, AVPacket *pkt)
     return 0;
 }
 
+/* Packets of one stream queued for decoding in fast probe mode. */
+typedef struct ProbeDecodeJob {
+    AVFormatContext *ic;
+    AVStream *st;
+    AVDictionary **options;
+    struct {
+        AVPacket *pkt;
+        int codec_info_nb_frames;
+    } *pkts;
+    unsigned pkts_size;
+    int nb_pkts;
+} ProbeDecodeJob;
+
+#define FAST_PROBE_MAX_PENDING 32
+
+static int probe_queue_packet(ProbeDecodeJob **jobs, int *nb_jobs, AVFormatContext *ic,
+                              AVStream *st, AVPacket *pkt, AVDictionary **options)
+{
+    ProbeDecodeJob *job;
+
+    if (st->index >= *nb_jobs) {
+        int nb = ic->nb_streams;
+        job = av_realloc_array(*jobs, nb, sizeof(**jobs));
+        if (!job)
+            return AVERROR(ENOMEM);
+        memset(job + *nb_jobs, 0, (nb - *nb_jobs) * sizeof(*job));
+        *jobs    = job;
+        *nb_jobs = nb;
+    }
+    job = &(*jobs)[st->index];
+    job->ic      = ic;
+    job->st      = st;
+    job->options = options;
+
+    job->pkts = av_fast_realloc(job->pkts, &job->pkts_size,
+                                (job->nb_pkts + 1) * sizeof(*job->pkts));
+    if (!job->pkts)
+        return AVERROR(ENOMEM);
+    job->pkts[job->nb_pkts].pkt                  = pkt;
+    job->pkts[job->nb_pkts].codec_info_nb_frames = st->codec_info_nb_frames;
+    job->nb_pkts++;
+    return 0;
+}
+
+static void *probe_decode_worker(void *arg)
+{
+    ProbeDecodeJob *job = arg;
+    AVStream *st = job->st;
+    int codec_info_nb_frames = st->codec_info_nb_frames;
+    int i;
+
+    /* decode as if the packets had been decoded right after being read */
+    for (i = 0; i < job->nb_pkts; i++) {
+        st->codec_info_nb_frames = job->pkts[i].codec_info_nb_frames;
+        try_decode_frame(job->ic, st, job->pkts[i].pkt, job->options);
+    }
+    st->codec_info_nb_frames = codec_info_nb_frames;
+    job->nb_pkts = 0;
+    return NULL;
+}
+
+/**
+ * Decode the queued packets, the streams are decoded concurrently.
+ * Every stream only touches its own codec context.
+ */
+static void probe_decode_jobs(ProbeDecodeJob *jobs, int nb_jobs, int *nb_pending)
+{
+    int i;
+#if HAVE_THREADS
+    int nb_threads = av_cpu_count();
+    pthread_t *threads = av_malloc_array(nb_jobs, sizeof(*threads));
+    int *started = av_mallocz_array(nb_jobs, sizeof(*started));
+
+    if (threads && started && nb_threads > 1) {
+        int first = 0, running = 0;
+
+        for (i = 0; i < nb_jobs; i++) {
+            if (!jobs[i].nb_pkts)
+                continue;
+            if (running == nb_threads) {
+                for (; first < i; first++) {
+                    if (started[first]) {
+                        pthread_join(threads[first], NULL);
+                        started[first] = 0;
+                    }
+                }
+                running = 0;
+            }
+            started[i] = !pthread_create(&threads[i], NULL, probe_decode_worker, &jobs[i]);
+            running   += started[i];
+        }
+        for (i = 0; i < nb_jobs; i++)
+            if (started[i])
+                pthread_join(threads[i], NULL);
+    }
+    av_free(threads);
+    av_free(started);
+#endif
+
+    /* decode whatever could not be handed to a thread */
+    for (i = 0; i < nb_jobs; i++)
+        if (jobs[i].nb_pkts)
+            probe_decode_worker(&jobs[i]);
+    *nb_pending = 0;
+}
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     int i, count = 0, ret = 0, j;
@@ -3581,9 +3775,16 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
+    int fast_probe = (ic->flags & AVFMT_FLAG_FAST_PROBE) && !(ic->flags & AVFMT_FLAG_NOBUFFER);
+    ProbeDecodeJob *jobs = NULL;
+    int nb_jobs = 0, nb_pending = 0, nb_batches = 0;
+    int64_t start_time = av_gettime_relative(), decode_time = 0;
 
     flush_codecs = probesize > 0;
 
+    if (ic->probe_cache && ff_probe_cache_load(ic) >= 0)
+        goto probe_cache_hit;
+
     av_opt_set(ic, "skip_clear", "1", AV_OPT_SEARCH_CHILDREN);
 
     max_stream_analyze_duration = max_analyze_duration;
@@ -3696,6 +3897,22 @@ FF_ENABLE_DEPRECATION_WARNINGS
             break;
         }
 
+        /* Decode the queued packets once every stream missing parameters
+         * has some, so that all of them are decoded together. */
+        if (nb_pending) {
+            for (i = 0; i < ic->nb_streams; i++) {
+                if (!has_codec_parameters(ic->streams[i], NULL) &&
+                    (i >= nb_jobs || !jobs[i].nb_pkts))
+                    break;
+            }
+            if (i == ic->nb_streams || nb_pending >= FAST_PROBE_MAX_PENDING) {
+                int64_t t = av_gettime_relative();
+                probe_decode_jobs(jobs, nb_jobs, &nb_pending);
+                decode_time += av_gettime_relative() - t;
+                nb_batches++;
+            }
+        }
+
         /* check if one codec still needs to be handled */
         for (i = 0; i < ic->nb_streams; i++) {
             int fps_analyze_framecount = 20;
@@ -3720,6 +3937,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
                        st->info->codec_info_duration_fields/2 :
                        st->info->duration_count;
             if (!(st->r_frame_rate.num && st->avg_frame_rate.num) &&
+                !(fast_probe && (st->r_frame_rate.num || st->avg_frame_rate.num ||
+                                 st->internal->avctx->framerate.num)) &&
                 st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
                 if (count < fps_analyze_framecount)
                     break;
@@ -3743,10 +3962,20 @@ FF_ENABLE_DEPRECATION_WARNINGS
         analyzed_all_streams = 0;
         if (!missing_streams || !*missing_streams)
         if (i == ic->nb_streams) {
+            int all_streams_found = !(ic->ctx_flags & AVFMTCTX_NOHEADER);
+
             analyzed_all_streams = 1;
             /* NOTE: If the format has no header, then we need to read some
-             * packets to get most of the streams, so we cannot stop here. */
-            if (!(ic->ctx_flags & AVFMTCTX_NOHEADER)) {
+             * packets to get most of the streams, so we cannot stop here.
+             * In fast probe mode, the streams which already had packets are
+             * trusted to be all of them. */
+            if (fast_probe && !all_streams_found) {
+                for (i = 0; i < ic->nb_streams; i++)
+                    if (!ic->streams[i]->codec_info_nb_frames)
+                        break;
+                all_streams_found = i == ic->nb_streams;
+            }
+            if (all_streams_found) {
                 /* If we found the info for all the codecs, we can stop. */
                 ret = count;
                 av_log(ic, AV_LOG_DEBUG, "All info found\n");
@@ -3900,8 +4129,23 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (fast_probe) {
+            /* Trust complete parameters, otherwise queue the packet for
+             * decoding together with the other streams. */
+            if (!has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st)) {
+                ret = probe_queue_packet(&jobs, &nb_jobs, ic, st,
+                                         &ic->internal->packet_buffer_end->pkt,
+                                         (options && st->index < orig_nb_streams) ? &options[st->index] : NULL);
+                if (ret < 0)
+                    goto find_stream_info_err;
+                nb_pending++;
+            }
+        } else {
+            int64_t t = av_gettime_relative();
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
+            decode_time += av_gettime_relative() - t;
+        }
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt);
@@ -3910,6 +4154,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
         count++;
     }
 
+    if (nb_pending) {
+        int64_t t = av_gettime_relative();
+        probe_decode_jobs(jobs, nb_jobs, &nb_pending);
+        decode_time += av_gettime_relative() - t;
+        nb_batches++;
+    }
+
     if (eof_reached) {
         int stream_index;
         for (stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
@@ -4088,6 +4339,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
     }
 
+probe_cache_hit:
     compute_chapters_end(ic);
 
     /* update the stream parameters from the internal codec contexts */
@@ -4150,6 +4402,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
         st->internal->avctx_inited = 0;
     }
 
+    if (ic->probe_cache && ret >= 0 && ic->nb_streams && !ic->internal->probe_cache_valid)
+        ff_probe_cache_save(ic);
+
 find_stream_info_err:
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
@@ -4160,9 +4415,18 @@ find_stream_info_err:
         av_bsf_free(&ic->streams[i]->internal->extract_extradata.bsf);
         av_packet_free(&ic->streams[i]->internal->extract_extradata.pkt);
     }
+    for (i = 0; i < nb_jobs; i++)
+        av_freep(&jobs[i].pkts);
+    av_freep(&jobs);
     if (ic->pb)
         av_log(ic, AV_LOG_DEBUG, "After avformat_find_stream_info() pos: %"PRId64" bytes read:%"PRId64" seeks:%d frames:%d\n",
                avio_tell(ic->pb), ic->pb->bytes_read, ic->pb->seek_count, count);
+    if (fast_probe)
+        av_log(ic, AV_LOG_VERBOSE, "Stream info found in %.1f ms, %.1f ms of it decoding in %d batches, %d frames read\n",
+               (av_gettime_relative() - start_time) / 1000.0, decode_time / 1000.0, nb_batches, count);
+    else
+        av_log(ic, AV_LOG_VERBOSE, "Stream info found in %.1f ms, %.1f ms of it decoding, %d frames read\n",
+               (av_gettime_relative() - start_time) / 1000.0, decode_time / 1000.0, count);
     return ret;
 }
 
@@ -4445,6 +4709,9 @@ void avformat_close_input(AVFormatContext **ps)
 
     flush_packet_queue(s);
 
+    if (s->iformat && s->probe_cache)
+        ff_probe_cache_update(s);
+
     if (s->iformat)
         if (s->iformat->read_close)
             s->iformat->read_close(s);
@@ -0,0 +1,323 @@
+/*
+ * Background writer for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+
+#include "avio_internal.h"
+#if CONFIG_HTTP_PROTOCOL
+#include "http.h"
+#endif
+#include "internal.h"
+#include "url.h"
+#include "writequeue.h"
+
+#if HAVE_THREADS
+
+typedef struct WriteRequest {
+    char *url;
+    AVDictionary *options;
+    uint8_t *data;
+    int size;
+} WriteRequest;
+
+typedef struct PendingOutput {
+    AVIOContext *pb;
+    char *url;
+    AVDictionary *options;
+} PendingOutput;
+
+struct FFWriteQueue {
+    AVFormatContext *s;
+    int persistent;
+
+    AVThreadMessageQueue *queue;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int error;                  ///< first write error, protected by lock
+
+    /* writer thread state */
+    AVIOContext *conn;          ///< connection kept open for persistent HTTP
+    char *conn_method;          ///< HTTP method conn was opened with
+
+    /* muxer thread state */
+    PendingOutput *pending;
+    int nb_pending;
+};
+
+static void free_request(void *msg)
+{
+    WriteRequest *req = msg;
+
+    av_freep(&req->url);
+    av_dict_free(&req->options);
+    av_freep(&req->data);
+}
+
+static void close_connection(FFWriteQueue *wq)
+{
+    ff_format_io_close(wq->s, &wq->conn);
+    av_freep(&wq->conn_method);
+}
+
+static int write_request(FFWriteQueue *wq, WriteRequest *req)
+{
+    AVFormatContext *s = wq->s;
+    AVDictionaryEntry *method = av_dict_get(req->options, "method", NULL, 0);
+    int http = ff_is_http_proto(req->url);
+    int reuse = wq->persistent && http;
+    int ret;
+
+#if CONFIG_HTTP_PROTOCOL
+    /* a new request on an existing connection keeps the old method */
+    if (wq->conn && reuse &&
+        !strcmp(method ? method->value : "", wq->conn_method ? wq->conn_method : "")) {
+        ret = ff_http_do_new_request(ffio_geturlcontext(wq->conn), req->url);
+        if (ret < 0)
+            close_connection(wq);
+    } else
+#endif
+        close_connection(wq);
+
+    if (!wq->conn) {
+        if (method && !(wq->conn_method = av_strdup(method->value)))
+            return AVERROR(ENOMEM);
+        ret = s->io_open(s, &wq->conn, req->url, AVIO_FLAG_WRITE, &req->options);
+        if (ret < 0) {
+            av_freep(&wq->conn_method);
+            return ret;
+        }
+    }
+
+    avio_write(wq->conn, req->data, req->size);
+    avio_flush(wq->conn);
+    ret = wq->conn->error;
+
+#if CONFIG_HTTP_PROTOCOL
+    if (reuse && ret >= 0) {
+        ret = ffurl_shutdown(ffio_geturlcontext(wq->conn), AVIO_FLAG_WRITE);
+        if (ret < 0)
+            close_connection(wq);
+        return ret;
+    }
+#endif
+    close_connection(wq);
+    return ret;
+}
+
+static void *writer_thread(void *arg)
+{
+    FFWriteQueue *wq = arg;
+    WriteRequest req;
+    int ret;
+
+    while (av_thread_message_queue_recv(wq->queue, &req, 0) >= 0) {
+        ret = write_request(wq, &req);
+        if (ret < 0) {
+            av_log(wq->s, AV_LOG_ERROR, "Failed to write '%s': %s\n",
+                   req.url, av_err2str(ret));
+            pthread_mutex_lock(&wq->lock);
+            if (!wq->error)
+                wq->error = ret;
+            pthread_mutex_unlock(&wq->lock);
+        }
+        free_request(&req);
+    }
+    close_connection(wq);
+
+    return NULL;
+}
+
+static int get_error(FFWriteQueue *wq)
+{
+    int ret;
+
+    pthread_mutex_lock(&wq->lock);
+    ret = wq->error;
+    pthread_mutex_unlock(&wq->lock);
+
+    return ret;
+}
+
+int ff_write_queue_alloc(FFWriteQueue **pwq, AVFormatContext *s,
+                         int nb_pending, int persistent)
+{
+    FFWriteQueue *wq;
+    int ret;
+
+    wq = av_mallocz(sizeof(*wq));
+    if (!wq)
+        return AVERROR(ENOMEM);
+    wq->s          = s;
+    wq->persistent = persistent;
+
+    ret = av_thread_message_queue_alloc(&wq->queue, FFMAX(nb_pending, 1),
+                                        sizeof(WriteRequest));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(wq->queue, free_request);
+
+    ret = AVERROR(pthread_mutex_init(&wq->lock, NULL));
+    if (ret < 0)
+        goto fail;
+
+    ret = AVERROR(pthread_create(&wq->thread, NULL, writer_thread, wq));
+    if (ret < 0) {
+        pthread_mutex_destroy(&wq->lock);
+        goto fail;
+    }
+
+    *pwq = wq;
+    return 0;
+fail:
+    av_thread_message_queue_free(&wq->queue);
+    av_free(wq);
+    return ret;
+}
+
+int ff_write_queue_open(FFWriteQueue *wq, AVIOContext **pb, const char *url,
+                        AVDictionary **options)
+{
+    PendingOutput *pending, *out;
+    int ret;
+
+    pending = av_realloc_array(wq->pending, wq->nb_pending + 1, sizeof(*pending));
+    if (!pending)
+        return AVERROR(ENOMEM);
+    wq->pending = pending;
+    out = &wq->pending[wq->nb_pending];
+    memset(out, 0, sizeof(*out));
+
+    out->url = av_strdup(url);
+    if (!out->url)
+        return AVERROR(ENOMEM);
+    if (options && (ret = av_dict_copy(&out->options, *options, 0)) < 0)
+        goto fail;
+    if ((ret = avio_open_dyn_buf(&out->pb)) < 0)
+        goto fail;
+
+    *pb = out->pb;
+    wq->nb_pending++;
+    return 0;
+fail:
+    av_freep(&out->url);
+    av_dict_free(&out->options);
+    return ret;
+}
+
+static PendingOutput *find_pending(FFWriteQueue *wq, AVIOContext *pb)
+{
+    int i;
+
+    for (i = 0; pb && i < wq->nb_pending; i++)
+        if (wq->pending[i].pb == pb)
+            return &wq->pending[i];
+    return NULL;
+}
+
+int ff_write_queue_owns(FFWriteQueue *wq, AVIOContext *pb)
+{
+    return !!find_pending(wq, pb);
+}
+
+int ff_write_queue_close(FFWriteQueue *wq, AVIOContext **pb)
+{
+    PendingOutput *out = find_pending(wq, *pb);
+    WriteRequest req = { 0 };
+    int ret;
+
+    if (!out)
+        return AVERROR(EINVAL);
+
+    req.url     = out->url;
+    req.options = out->options;
+    req.size    = avio_close_dyn_buf(out->pb, &req.data);
+    *out = wq->pending[--wq->nb_pending];
+    *pb  = NULL;
+
+    ret = av_thread_message_queue_send(wq->queue, &req, 0);
+    if (ret < 0) {
+        free_request(&req);
+        return ret;
+    }
+
+    return get_error(wq);
+}
+
+int ff_write_queue_free(FFWriteQueue **pwq)
+{
+    FFWriteQueue *wq = *pwq;
+    int i, ret;
+
+    if (!wq)
+        return 0;
+
+    /* the writer drains every queued request before it sees EOF */
+    av_thread_message_queue_set_err_recv(wq->queue, AVERROR_EOF);
+    pthread_join(wq->thread, NULL);
+    ret = wq->error;
+
+    for (i = 0; i < wq->nb_pending; i++) {
+        ffio_free_dyn_buf(&wq->pending[i].pb);
+        av_freep(&wq->pending[i].url);
+        av_dict_free(&wq->pending[i].options);
+    }
+    av_freep(&wq->pending);
+    av_thread_message_queue_free(&wq->queue);
+    pthread_mutex_destroy(&wq->lock);
+    av_freep(pwq);
+
+    return ret;
+}
+
+#else
+
+int ff_write_queue_alloc(FFWriteQueue **pwq, AVFormatContext *s,
+                         int nb_pending, int persistent)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_write_queue_open(FFWriteQueue *wq, AVIOContext **pb, const char *url,
+                        AVDictionary **options)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_write_queue_owns(FFWriteQueue *wq, AVIOContext *pb)
+{
+    return 0;
+}
+
+int ff_write_queue_close(FFWriteQueue *wq, AVIOContext **pb)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_write_queue_free(FFWriteQueue **pwq)
+{
+    return 0;
+}
+
+#endif /* HAVE_THREADS */
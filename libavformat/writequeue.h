@@ -0,0 +1,78 @@
+/*
+ * Background writer for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_WRITEQUEUE_H
+#define AVFORMAT_WRITEQUEUE_H
+
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * A write queue lets a muxer produce complete output files (segments,
+ * playlists) in memory and hand them over to a single background thread
+ * which opens, writes and closes the real output. Files are uploaded in
+ * the order they were closed, so a playlist closed after a segment is
+ * never published before that segment.
+ */
+typedef struct FFWriteQueue FFWriteQueue;
+
+/**
+ * Allocate a write queue and start its writer thread.
+ *
+ * @param s          muxer context, its io_open/io_close callbacks are used
+ *                   by the writer thread
+ * @param nb_pending maximum number of closed files waiting to be written;
+ *                   closing more files blocks until the writer catches up
+ * @param persistent keep the HTTP connection open between requests
+ * @return 0 on success, a negative AVERROR code on failure, in particular
+ *         AVERROR(ENOSYS) if threads are not available
+ */
+int ff_write_queue_alloc(FFWriteQueue **pwq, AVFormatContext *s,
+                         int nb_pending, int persistent);
+
+/**
+ * Open an in-memory output that will be written to url once closed with
+ * ff_write_queue_close(). options are copied and used to open url.
+ */
+int ff_write_queue_open(FFWriteQueue *wq, AVIOContext **pb, const char *url,
+                        AVDictionary **options);
+
+/**
+ * Check whether pb was opened by ff_write_queue_open() and is still pending.
+ */
+int ff_write_queue_owns(FFWriteQueue *wq, AVIOContext *pb);
+
+/**
+ * Close an output opened with ff_write_queue_open() and queue its contents
+ * for writing. *pb is set to NULL.
+ *
+ * @return 0 on success, a negative AVERROR code if the data could not be
+ *         queued or if a previous write failed
+ */
+int ff_write_queue_close(FFWriteQueue *wq, AVIOContext **pb);
+
+/**
+ * Write all queued files, stop the writer thread and free the queue.
+ *
+ * @return 0 if every file was written, the first error encountered otherwise
+ */
+int ff_write_queue_free(FFWriteQueue **pwq);
+
+#endif /* AVFORMAT_WRITEQUEUE_H */
@@ -27,11 +27,108 @@
 #include "time_internal.h"
 #include "bprint.h"
 
+/* dictionaries with at least this many entries get a hash index */
+#define DICT_HASH_MIN 16
+
+typedef struct DictHashEntry {
+    uint32_t hash;
+    int next;
+} DictHashEntry;
+
 struct AVDictionary {
     int count;
     AVDictionaryEntry *elems;
+
+    /**
+     * Hash index of the keys, NULL for small dictionaries.
+     * buckets[] holds the first element of every chain, hash[] runs parallel
+     * to elems and links the elements of a chain. Keys are hashed case
+     * insensitively so that the index serves both matching modes.
+     */
+    int *buckets;
+    DictHashEntry *hash;
+    int nb_buckets;
 };
 
+static uint32_t dict_hash(const char *key)
+{
+    uint32_t h = 0x811C9DC5;
+
+    if (key)
+        while (*key)
+            h = (h ^ av_toupper(*(const uint8_t *)key++)) * 0x01000193;
+    return h;
+}
+
+static void dict_index_free(AVDictionary *m)
+{
+    av_freep(&m->buckets);
+    av_freep(&m->hash);
+    m->nb_buckets = 0;
+}
+
+static void dict_index_link(AVDictionary *m, int i)
+{
+    int *b = &m->buckets[m->hash[i].hash & (m->nb_buckets - 1)];
+
+    m->hash[i].next = *b;
+    *b = i;
+}
+
+/**
+ * Move element from to position to in the index, or remove it if to is
+ * negative.
+ */
+static void dict_index_move(AVDictionary *m, int from, int to)
+{
+    int *p = &m->buckets[m->hash[from].hash & (m->nb_buckets - 1)];
+
+    while (*p != from)
+        p = &m->hash[*p].next;
+    if (to < 0) {
+        *p = m->hash[from].next;
+    } else {
+        *p = to;
+        m->hash[to] = m->hash[from];
+    }
+}
+
+/**
+ * Add the last element to the index, building or growing the index when
+ * needed. The index is optional, so it is simply dropped if there is not
+ * enough memory for it.
+ */
+static void dict_index_add(AVDictionary *m)
+{
+    int i = m->count - 1;
+
+    /* an index once built is kept up to date even after deletions made
+     * the dictionary small again */
+    if (!m->buckets && m->count < DICT_HASH_MIN)
+        return;
+
+    if (m->count > m->nb_buckets) {
+        int nb_buckets = FFMAX(2 * m->nb_buckets, 2 * DICT_HASH_MIN);
+
+        if (nb_buckets > INT_MAX / 2 ||
+            av_reallocp_array(&m->buckets, nb_buckets, sizeof(*m->buckets)) < 0 ||
+            av_reallocp_array(&m->hash,    nb_buckets, sizeof(*m->hash))    < 0) {
+            dict_index_free(m);
+            return;
+        }
+        m->nb_buckets = nb_buckets;
+        memset(m->buckets, 0xFF, nb_buckets * sizeof(*m->buckets));
+        for (i = 0; i < m->count; i++) {
+            m->hash[i].hash = dict_hash(m->elems[i].key);
+            dict_index_link(m, i);
+        }
+        return;
+    }
+
+    m->hash[i].hash = dict_hash(m->elems[i].key);
+    dict_index_link(m, i);
+}
+
 int av_dict_count(const AVDictionary *m)
 {
     return m ? m->count : 0;
@@ -50,6 +147,22 @@ AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
     else
         i = 0;
 
+    if (m->buckets && !(flags & AV_DICT_IGNORE_SUFFIX)) {
+        uint32_t h = dict_hash(key);
+        int k, best = -1;
+
+        /* chains are unordered, so find the first match after prev */
+        for (k = m->buckets[h & (m->nb_buckets - 1)]; k >= 0; k = m->hash[k].next) {
+            if (k < (int)i || (best >= 0 && k > best) || m->hash[k].hash != h)
+                continue;
+            if (flags & AV_DICT_MATCH_CASE ? strcmp(m->elems[k].key, key)
+                                           : av_strcasecmp(m->elems[k].key, key))
+                continue;
+            best = k;
+        }
+        return best >= 0 ? &m->elems[best] : NULL;
+    }
+
     for (; i < m->count; i++) {
         const char *s = m->elems[i].key;
         if (flags & AV_DICT_MATCH_CASE)
@@ -101,6 +214,12 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
         else
             av_free(tag->value);
         av_free(tag->key);
+        if (m->buckets) {
+            int t = tag - m->elems;
+            dict_index_move(m, t, -1);
+            if (t != m->count - 1)
+                dict_index_move(m, m->count - 1, t);
+        }
         *tag = m->elems[--m->count];
     } else if (copy_value) {
         AVDictionaryEntry *tmp = av_realloc(m->elems,
@@ -124,10 +243,12 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             av_freep(&copy_value);
         }
         m->count++;
+        dict_index_add(m);
     } else {
         av_freep(&copy_key);
     }
     if (!m->count) {
+        dict_index_free(m);
         av_freep(&m->elems);
         av_freep(pm);
     }
@@ -136,6 +257,7 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
 
 err_out:
     if (m && !m->count) {
+        dict_index_free(m);
         av_freep(&m->elems);
         av_freep(pm);
     }
@@ -209,6 +331,7 @@ void av_dict_free(AVDictionary **pm)
             av_freep(&m->elems[m->count].key);
             av_freep(&m->elems[m->count].value);
         }
+        dict_index_free(m);
         av_freep(&m->elems);
     }
     av_freep(pm);
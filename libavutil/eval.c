@@ -154,6 +154,13 @@ static int strmatch(const char *s, const char *prefix)
     return !IS_IDENTIFIER_CHAR(s[i]);
 }
 
+typedef union ExprArg {
+    int const_index;
+    double (*func0)(double);
+    double (*func1)(void *, double);
+    double (*func2)(void *, double, double);
+} ExprArg;
+
 struct AVExpr {
     enum {
         e_value, e_const, e_func0, e_func1, e_func2,
@@ -163,23 +170,97 @@ struct AVExpr {
         e_last, e_st, e_while, e_taylor, e_root, e_floor, e_ceil, e_trunc, e_round,
         e_sqrt, e_not, e_random, e_hypot, e_gcd,
         e_if, e_ifnot, e_print, e_bitand, e_bitor, e_between, e_clip, e_atan2, e_lerp,
+        /* instructions of compiled programs only */
+        e_jz, e_jnz, e_jmp, e_scale, e_select, e_selectnot,
     } type;
     double value; // is sign in other types
-    union {
-        int const_index;
-        double (*func0)(double);
-        double (*func1)(void *, double);
-        double (*func2)(void *, double, double);
-    } a;
+    ExprArg a;
     struct AVExpr *param[3];
     double *var;
+    /* the compiled programs, set on the root node only */
+    struct ExprProgram *prog;
+    struct ExprProgram *batch_prog;
+    int nb_consts;
 };
 
+/**
+ * An instruction of a compiled expression. The operands are read from the
+ * registers reg, reg + 1 and reg + 2 and the result is written to reg, so
+ * that the registers are allocated like a stack while compiling the tree.
+ */
+typedef struct ExprInsn {
+    int type;
+    int reg;
+    double value;
+    ExprArg a;
+    int target;     ///< instruction to continue with for jumps
+    int nb_args;    ///< number of registers read, starting at reg
+} ExprInsn;
+
+typedef struct ExprProgram {
+    ExprInsn *insn;
+    int nb_insn;
+    int nb_regs;
+} ExprProgram;
+
+#define MAX_REGS 32
+#define BATCH_SIZE 32
+
 static double etime(double v)
 {
     return av_gettime() * 0.000001;
 }
 
+static av_always_inline double eval_unary(int type, double value, double d)
+{
+    switch (type) {
+    case e_squish: return 1/(1+exp(4*d));
+    case e_gauss:  return exp(-d*d/2)/sqrt(2*M_PI);
+    case e_isnan:  return value * !!isnan(d);
+    case e_isinf:  return value * !!isinf(d);
+    case e_floor:  return value * floor(d);
+    case e_ceil :  return value * ceil (d);
+    case e_trunc:  return value * trunc(d);
+    case e_round:  return value * round(d);
+    case e_sqrt:   return value * sqrt (d);
+    case e_not:    return value * (d == 0);
+    }
+    return NAN;
+}
+
+static av_always_inline double eval_binary(int type, double value, double d, double d2, double *var)
+{
+    switch (type) {
+    case e_mod: return value * (d - floor((!CONFIG_FTRAPV || d2) ? d / d2 : d * INFINITY) * d2);
+    case e_gcd: return value * av_gcd(d,d2);
+    case e_max: return value * (d >  d2 ?   d : d2);
+    case e_min: return value * (d <  d2 ?   d : d2);
+    case e_eq:  return value * (d == d2 ? 1.0 : 0.0);
+    case e_gt:  return value * (d >  d2 ? 1.0 : 0.0);
+    case e_gte: return value * (d >= d2 ? 1.0 : 0.0);
+    case e_lt:  return value * (d <  d2 ? 1.0 : 0.0);
+    case e_lte: return value * (d <= d2 ? 1.0 : 0.0);
+    case e_pow: return value * pow(d, d2);
+    case e_mul: return value * (d * d2);
+    case e_div: return value * ((!CONFIG_FTRAPV || d2 ) ? (d / d2) : d * INFINITY);
+    case e_add: return value * (d + d2);
+    case e_last:return value * d2;
+    case e_st : return value * (var[av_clip(d, 0, VARS-1)]= d2);
+    case e_hypot:return value * hypot(d, d2);
+    case e_atan2:return value * atan2(d, d2);
+    case e_bitand: return isnan(d) || isnan(d2) ? NAN : value * ((long int)d & (long int)d2);
+    case e_bitor:  return isnan(d) || isnan(d2) ? NAN : value * ((long int)d | (long int)d2);
+    }
+    return NAN;
+}
+
+static av_always_inline double eval_clip(double value, double x, double min, double max)
+{
+    if (isnan(min) || isnan(max) || isnan(x) || min > max)
+        return NAN;
+    return value * av_clipd(x, min, max);
+}
+
 static double eval_expr(Parser *p, AVExpr *e)
 {
     switch (e->type) {
@@ -188,17 +269,17 @@ static double eval_expr(Parser *p, AVExpr *e)
         case e_func0:  return e->value * e->a.func0(eval_expr(p, e->param[0]));
         case e_func1:  return e->value * e->a.func1(p->opaque, eval_expr(p, e->param[0]));
         case e_func2:  return e->value * e->a.func2(p->opaque, eval_expr(p, e->param[0]), eval_expr(p, e->param[1]));
-        case e_squish: return 1/(1+exp(4*eval_expr(p, e->param[0])));
-        case e_gauss: { double d = eval_expr(p, e->param[0]); return exp(-d*d/2)/sqrt(2*M_PI); }
         case e_ld:     return e->value * p->var[av_clip(eval_expr(p, e->param[0]), 0, VARS-1)];
-        case e_isnan:  return e->value * !!isnan(eval_expr(p, e->param[0]));
-        case e_isinf:  return e->value * !!isinf(eval_expr(p, e->param[0]));
-        case e_floor:  return e->value * floor(eval_expr(p, e->param[0]));
-        case e_ceil :  return e->value * ceil (eval_expr(p, e->param[0]));
-        case e_trunc:  return e->value * trunc(eval_expr(p, e->param[0]));
-        case e_round:  return e->value * round(eval_expr(p, e->param[0]));
-        case e_sqrt:   return e->value * sqrt (eval_expr(p, e->param[0]));
-        case e_not:    return e->value * (eval_expr(p, e->param[0]) == 0);
+        case e_squish:
+        case e_gauss:
+        case e_isnan:
+        case e_isinf:
+        case e_floor:
+        case e_ceil:
+        case e_trunc:
+        case e_round:
+        case e_sqrt:
+        case e_not:    return eval_unary(e->type, e->value, eval_expr(p, e->param[0]));
         case e_if:     return e->value * (eval_expr(p, e->param[0]) ? eval_expr(p, e->param[1]) :
                                           e->param[2] ? eval_expr(p, e->param[2]) : 0);
         case e_ifnot:  return e->value * (!eval_expr(p, e->param[0]) ? eval_expr(p, e->param[1]) :
@@ -208,7 +289,7 @@ static double eval_expr(Parser *p, AVExpr *e)
             double min = eval_expr(p, e->param[1]), max = eval_expr(p, e->param[2]);
             if (isnan(min) || isnan(max) || isnan(x) || min > max)
                 return NAN;
-            return e->value * av_clipd(eval_expr(p, e->param[0]), min, max);
+            return eval_clip(e->value, eval_expr(p, e->param[0]), min, max);
         }
         case e_between: {
             double d = eval_expr(p, e->param[0]);
@@ -303,27 +384,7 @@ static double eval_expr(Parser *p, AVExpr *e)
         default: {
             double d = eval_expr(p, e->param[0]);
             double d2 = eval_expr(p, e->param[1]);
-            switch (e->type) {
-                case e_mod: return e->value * (d - floor((!CONFIG_FTRAPV || d2) ? d / d2 : d * INFINITY) * d2);
-                case e_gcd: return e->value * av_gcd(d,d2);
-                case e_max: return e->value * (d >  d2 ?   d : d2);
-                case e_min: return e->value * (d <  d2 ?   d : d2);
-                case e_eq:  return e->value * (d == d2 ? 1.0 : 0.0);
-                case e_gt:  return e->value * (d >  d2 ? 1.0 : 0.0);
-                case e_gte: return e->value * (d >= d2 ? 1.0 : 0.0);
-                case e_lt:  return e->value * (d <  d2 ? 1.0 : 0.0);
-                case e_lte: return e->value * (d <= d2 ? 1.0 : 0.0);
-                case e_pow: return e->value * pow(d, d2);
-                case e_mul: return e->value * (d * d2);
-                case e_div: return e->value * ((!CONFIG_FTRAPV || d2 ) ? (d / d2) : d * INFINITY);
-                case e_add: return e->value * (d + d2);
-                case e_last:return e->value * d2;
-                case e_st : return e->value * (p->var[av_clip(d, 0, VARS-1)]= d2);
-                case e_hypot:return e->value * hypot(d, d2);
-                case e_atan2:return e->value * atan2(d, d2);
-                case e_bitand: return isnan(d) || isnan(d2) ? NAN : e->value * ((long int)d & (long int)d2);
-                case e_bitor:  return isnan(d) || isnan(d2) ? NAN : e->value * ((long int)d | (long int)d2);
-            }
+            return eval_binary(e->type, e->value, d, d2, p->var);
         }
     }
     return NAN;
@@ -331,6 +392,13 @@ static double eval_expr(Parser *p, AVExpr *e)
 
 static int parse_expr(AVExpr **e, Parser *p);
 
+static void free_program(ExprProgram **prog)
+{
+    if (*prog)
+        av_freep(&(*prog)->insn);
+    av_freep(prog);
+}
+
 void av_expr_free(AVExpr *e)
 {
     if (!e) return;
@@ -338,6 +406,8 @@ void av_expr_free(AVExpr *e)
     av_expr_free(e->param[1]);
     av_expr_free(e->param[2]);
     av_freep(&e->var);
+    free_program(&e->prog);
+    free_program(&e->batch_prog);
     av_freep(&e);
 }
 
@@ -676,6 +746,302 @@ static int verify_expr(AVExpr *e)
     }
 }
 
+enum {
+    EXPR_STATE = 1, ///< reads or writes the variables
+    EXPR_SIDE  = 2, ///< writes the variables or logs
+    EXPR_LOOP  = 4, ///< evaluates a subexpression repeatedly
+    EXPR_TIME  = 8, ///< depends on the time of evaluation
+};
+
+static int expr_flags(AVExpr *e)
+{
+    int flags;
+
+    if (!e)
+        return 0;
+    flags = expr_flags(e->param[0]) | expr_flags(e->param[1]) | expr_flags(e->param[2]);
+    switch (e->type) {
+    case e_ld:     return flags | EXPR_STATE;
+    case e_st:
+    case e_random: return flags | EXPR_STATE | EXPR_SIDE;
+    case e_print:  return flags | EXPR_SIDE;
+    case e_while:
+    case e_taylor:
+    case e_root:   return flags | EXPR_STATE | EXPR_LOOP;
+    case e_func0:  return flags | (e->a.func0 == etime ? EXPR_TIME : 0);
+    }
+    return flags;
+}
+
+/**
+ * Replace the subexpressions which only depend on numbers by their value.
+ */
+static void fold_constants(AVExpr *e)
+{
+    Parser p = { 0 };
+    int i;
+
+    if (!e)
+        return;
+    for (i = 0; i < 3; i++)
+        fold_constants(e->param[i]);
+
+    switch (e->type) {
+    case e_value:
+    case e_const:
+    case e_func1:
+    case e_func2:
+        return;
+    }
+    if (expr_flags(e))
+        return;
+    for (i = 0; i < 3; i++)
+        if (e->param[i] && e->param[i]->type != e_value)
+            return;
+
+    p.class = &eval_class;
+    e->value = eval_expr(&p, e);
+    e->type  = e_value;
+    for (i = 0; i < 3; i++) {
+        av_expr_free(e->param[i]);
+        e->param[i] = NULL;
+    }
+}
+
+static int emit(ExprProgram *prog, int type, int reg, double value)
+{
+    ExprInsn *insn;
+
+    if (!(prog->nb_insn & (prog->nb_insn - 1))) {
+        insn = av_realloc_array(prog->insn, FFMAX(2 * prog->nb_insn, 1), sizeof(*insn));
+        if (!insn)
+            return AVERROR(ENOMEM);
+        prog->insn = insn;
+    }
+    insn = &prog->insn[prog->nb_insn++];
+    memset(insn, 0, sizeof(*insn));
+    insn->type  = type;
+    insn->reg   = reg;
+    insn->value = value;
+    return 0;
+}
+
+/**
+ * Compile the expression e, storing its result in the register reg.
+ * In batch programs if() and ifnot() evaluate both branches and select the
+ * result, so that the program can be run on many elements at once.
+ */
+static int compile_expr(ExprProgram *prog, AVExpr *e, int reg, int batch)
+{
+    int i, ret, jump;
+
+    if (reg + 3 > MAX_REGS)
+        return AVERROR(ENOSYS);
+    prog->nb_regs = FFMAX(prog->nb_regs, reg + 3);
+
+    switch (e->type) {
+    case e_if:
+    case e_ifnot:
+        if ((ret = compile_expr(prog, e->param[0], reg, batch)) < 0)
+            return ret;
+        if (batch) {
+            if ((ret = compile_expr(prog, e->param[1], reg + 1, batch)) < 0 ||
+                (ret = e->param[2] ? compile_expr(prog, e->param[2], reg + 2, batch) :
+                                     emit(prog, e_value, reg + 2, 0)) < 0 ||
+                (ret = emit(prog, e->type == e_if ? e_select : e_selectnot, reg, e->value)) < 0)
+                return ret;
+            prog->insn[prog->nb_insn - 1].nb_args = 3;
+            return 0;
+        }
+        jump = prog->nb_insn;
+        if ((ret = emit(prog, e->type == e_if ? e_jz : e_jnz, reg, 0)) < 0 ||
+            (ret = compile_expr(prog, e->param[1], reg, batch)) < 0)
+            return ret;
+        prog->insn[jump].target = prog->nb_insn + 1;
+        jump = prog->nb_insn;
+        if ((ret = emit(prog, e_jmp, reg, 0)) < 0 ||
+            (ret = e->param[2] ? compile_expr(prog, e->param[2], reg, batch) :
+                                 emit(prog, e_value, reg, 0)) < 0)
+            return ret;
+        prog->insn[jump].target = prog->nb_insn;
+        return e->value != 1 ? emit(prog, e_scale, reg, e->value) : 0;
+    case e_clip:
+        /* the value is evaluated twice by eval_expr() */
+        if (expr_flags(e->param[0]) & EXPR_SIDE)
+            return AVERROR(ENOSYS);
+        break;
+    case e_between:
+        /* the upper bound is not evaluated if the value is below the lower */
+        if (expr_flags(e->param[2]) & EXPR_SIDE)
+            return AVERROR(ENOSYS);
+        break;
+    case e_random:
+    case e_print:
+    case e_while:
+    case e_taylor:
+    case e_root:
+        return AVERROR(ENOSYS);
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (!e->param[i])
+            break;
+        if ((ret = compile_expr(prog, e->param[i], reg + i, batch)) < 0)
+            return ret;
+    }
+    if ((ret = emit(prog, e->type, reg, e->value)) < 0)
+        return ret;
+    prog->insn[prog->nb_insn - 1].a       = e->a;
+    prog->insn[prog->nb_insn - 1].nb_args = i;
+    return 0;
+}
+
+static int compile_program(ExprProgram **pprog, AVExpr *e, int batch)
+{
+    ExprProgram *prog = av_mallocz(sizeof(*prog));
+    int ret;
+
+    if (!prog)
+        return AVERROR(ENOMEM);
+    if ((ret = compile_expr(prog, e, 0, batch)) < 0) {
+        free_program(&prog);
+        return ret;
+    }
+    *pprog = prog;
+    return 0;
+}
+
+static av_always_inline double run_insn(const ExprInsn *insn, double *r,
+                                        const double *const_values, void *opaque, double *var)
+{
+    switch (insn->type) {
+    case e_value:  return insn->value;
+    case e_const:  return insn->value * const_values[insn->a.const_index];
+    case e_func0:  return insn->value * insn->a.func0(r[0]);
+    case e_func1:  return insn->value * insn->a.func1(opaque, r[0]);
+    case e_func2:  return insn->value * insn->a.func2(opaque, r[0], r[1]);
+    case e_ld:     return insn->value * var[av_clip(r[0], 0, VARS-1)];
+    case e_squish:
+    case e_gauss:
+    case e_isnan:
+    case e_isinf:
+    case e_floor:
+    case e_ceil:
+    case e_trunc:
+    case e_round:
+    case e_sqrt:
+    case e_not:    return eval_unary(insn->type, insn->value, r[0]);
+    case e_clip:   return eval_clip(insn->value, r[0], r[1], r[2]);
+    case e_between:return insn->value * (r[0] >= r[1] && r[0] <= r[2]);
+    case e_lerp:   return r[0] + (r[1] - r[0]) * r[2];
+    case e_scale:  return insn->value * r[0];
+    case e_select: return insn->value * (r[0] ? r[1] : r[2]);
+    case e_selectnot: return insn->value * (!r[0] ? r[1] : r[2]);
+    }
+    return eval_binary(insn->type, insn->value, r[0], r[1], var);
+}
+
+static double run_program(const ExprProgram *prog, const double *const_values,
+                          void *opaque, double *var)
+{
+    double r[MAX_REGS];
+    int i;
+
+    for (i = 0; i < prog->nb_insn; i++) {
+        const ExprInsn *insn = &prog->insn[i];
+        double *d = &r[insn->reg];
+
+        switch (insn->type) {
+        case e_value:
+            d[0] = insn->value;
+            break;
+        case e_const:
+            d[0] = insn->value * const_values[insn->a.const_index];
+            break;
+        case e_add:
+            d[0] = insn->value * (d[0] + d[1]);
+            break;
+        case e_mul:
+            d[0] = insn->value * (d[0] * d[1]);
+            break;
+        case e_jz:
+            if (!d[0])
+                i = insn->target - 1;
+            break;
+        case e_jnz:
+            if (d[0])
+                i = insn->target - 1;
+            break;
+        case e_jmp:
+            i = insn->target - 1;
+            break;
+        default:
+            d[0] = run_insn(insn, d, const_values, opaque, var);
+        }
+    }
+    return r[0];
+}
+
+/**
+ * Run a batch program on nb <= BATCH_SIZE elements, one instruction at a
+ * time for all the elements.
+ */
+static void run_batch(const ExprProgram *prog, double *dst, int nb,
+                      const double *const_values, const double * const *const_arrays,
+                      void *opaque)
+{
+    double r[MAX_REGS][BATCH_SIZE];
+    int i, j, k;
+
+    for (i = 0; i < prog->nb_insn; i++) {
+        const ExprInsn *insn = &prog->insn[i];
+        double *d0 = r[insn->reg], *d1 = r[insn->reg + 1], *d2 = r[insn->reg + 2];
+        double value = insn->value;
+
+        switch (insn->type) {
+        case e_value:
+            for (j = 0; j < nb; j++)
+                d0[j] = value;
+            break;
+        case e_const:
+            if (const_arrays && const_arrays[insn->a.const_index]) {
+                const double *src = const_arrays[insn->a.const_index];
+                for (j = 0; j < nb; j++)
+                    d0[j] = value * src[j];
+            } else {
+                for (j = 0; j < nb; j++)
+                    d0[j] = value * const_values[insn->a.const_index];
+            }
+            break;
+        case e_mul:
+            for (j = 0; j < nb; j++)
+                d0[j] = value * (d0[j] * d1[j]);
+            break;
+        case e_add:
+            for (j = 0; j < nb; j++)
+                d0[j] = value * (d0[j] + d1[j]);
+            break;
+        case e_last:
+            for (j = 0; j < nb; j++)
+                d0[j] = value * d1[j];
+            break;
+        case e_select:
+            for (j = 0; j < nb; j++)
+                d0[j] = value * (d0[j] ? d1[j] : d2[j]);
+            break;
+        default:
+            /* only the operands were written, the registers above are unset */
+            for (j = 0; j < nb; j++) {
+                double x[3] = { 0 };
+                for (k = 0; k < insn->nb_args; k++)
+                    x[k] = r[insn->reg + k][j];
+                d0[j] = run_insn(insn, x, const_values, opaque, NULL);
+            }
+        }
+    }
+    memcpy(dst, r[0], nb * sizeof(*dst));
+}
+
 int av_expr_parse(AVExpr **expr, const char *s,
                   const char * const *const_names,
                   const char * const *func1_names, double (* const *funcs1)(void *, double),
@@ -687,7 +1053,7 @@ int av_expr_parse(AVExpr **expr, const char *s,
     char *w = av_malloc(strlen(s) + 1);
     char *wp = w;
     const char *s0 = s;
-    int ret = 0;
+    int i, ret = 0;
 
     if (!w)
         return AVERROR(ENOMEM);
@@ -723,6 +1089,18 @@ int av_expr_parse(AVExpr **expr, const char *s,
         ret = AVERROR(ENOMEM);
         goto end;
     }
+
+    fold_constants(e);
+    for (i = 0; const_names && const_names[i]; i++)
+        e->nb_consts++;
+    /* expressions which cannot be compiled are evaluated on the tree */
+    if ((ret = compile_program(&e->prog, e, 0)) == AVERROR(ENOMEM))
+        goto end;
+    if (!(expr_flags(e) & (EXPR_STATE | EXPR_SIDE)) &&
+        (ret = compile_program(&e->batch_prog, e, 1)) == AVERROR(ENOMEM))
+        goto end;
+    ret = 0;
+
     *expr = e;
     e = NULL;
 end:
@@ -734,6 +1112,9 @@ end:
 double av_expr_eval(AVExpr *e, const double *const_values, void *opaque)
 {
     Parser p = { 0 };
+
+    if (e->prog)
+        return run_program(e->prog, const_values, opaque, e->var);
     p.var= e->var;
 
     p.const_values = const_values;
@@ -741,6 +1122,50 @@ double av_expr_eval(AVExpr *e, const double *const_values, void *opaque)
     return eval_expr(&p, e);
 }
 
+int av_expr_eval_batch(AVExpr *e, double *dst, int nb,
+                       const double *const_values, const double * const *const_arrays,
+                       void *opaque)
+{
+    double buf[16], *values = buf;
+    int i, j;
+
+    if (e->batch_prog) {
+        for (i = 0; i < nb; i += BATCH_SIZE) {
+            const double *arrays[16], **parrays = NULL;
+
+            /* offset the arrays to the current chunk */
+            if (const_arrays) {
+                parrays = e->nb_consts <= FF_ARRAY_ELEMS(arrays) ? arrays :
+                          av_malloc_array(e->nb_consts, sizeof(*parrays));
+                if (!parrays)
+                    return AVERROR(ENOMEM);
+                for (j = 0; j < e->nb_consts; j++)
+                    parrays[j] = const_arrays[j] ? const_arrays[j] + i : NULL;
+            }
+            run_batch(e->batch_prog, dst + i, FFMIN(nb - i, BATCH_SIZE),
+                      const_values, parrays, opaque);
+            if (parrays != arrays)
+                av_free(parrays);
+        }
+        return 0;
+    }
+
+    if (e->nb_consts > FF_ARRAY_ELEMS(buf) &&
+        !(values = av_malloc_array(e->nb_consts, sizeof(*values))))
+        return AVERROR(ENOMEM);
+    if (const_values)
+        memcpy(values, const_values, e->nb_consts * sizeof(*values));
+    for (i = 0; i < nb; i++) {
+        for (j = 0; j < e->nb_consts; j++)
+            if (const_arrays && const_arrays[j])
+                values[j] = const_arrays[j][i];
+        dst[i] = av_expr_eval(e, values, opaque);
+    }
+    if (values != buf)
+        av_free(values);
+    return 0;
+}
+
 int av_expr_parse_and_eval(double *d, const char *s,
                            const char * const *const_names, const double *const_values,
                            const char * const *func1_names, double (* const *funcs1)(void *, double),
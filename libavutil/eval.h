@@ -86,6 +86,31 @@ int av_expr_parse(AVExpr **expr, const char *s,
  */
 double av_expr_eval(AVExpr *e, const double *const_values, void *opaque);
 
+/**
+ * Evaluate a previously parsed expression for several values of some of
+ * the constants. This gives the same results as calling av_expr_eval()
+ * for each element in order, but is faster for expressions which do not
+ * use variables.
+ *
+ * The functions from funcs1 and funcs2 may also be evaluated for the branch
+ * of if() and ifnot() which is not taken, so they should not have side
+ * effects.
+ *
+ * @param dst array where the nb results are stored
+ * @param nb number of elements to evaluate
+ * @param const_values a zero terminated array of values for the identifiers from av_expr_parse() const_names,
+ *                     may be NULL if const_arrays points to values for every identifier
+ * @param const_arrays NULL, or an array of pointers for each identifier from
+ *                     av_expr_parse() const_names; if the pointer is not
+ *                     NULL it points to nb values used instead of the value
+ *                     from const_values
+ * @param opaque a pointer which will be passed to all functions from funcs1 and funcs2
+ * @return 0 on success, a negative AVERROR code otherwise
+ */
+int av_expr_eval_batch(AVExpr *e, double *dst, int nb,
+                       const double *const_values, const double * const *const_arrays,
+                       void *opaque);
+
 /**
  * Free a parsed expression previously created with av_expr_parse().
  */
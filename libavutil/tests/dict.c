@@ -19,6 +19,7 @@
  */
 
 #include "libavutil/dict.c"
+#include "libavutil/time.h"
 
 static void print_dict(const AVDictionary *m)
 {
@@ -49,12 +50,121 @@ static void test_separators(const AVDictionary *m, const char pair, const char v
     av_dict_free(&dict);
 }
 
-int main(void)
+static void test_large(void)
+{
+    AVDictionary *dict = NULL;
+    AVDictionaryEntry *e;
+    char key[32];
+    int i, missing = 0;
+
+    for (i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        av_dict_set_int(&dict, key, i, 0);
+    }
+    for (i = 0; i < 1000; i += 3) {
+        snprintf(key, sizeof(key), "KEY%d", i);
+        av_dict_set(&dict, key, NULL, 0);
+    }
+    for (i = 0; i < 1000; i += 5) {
+        snprintf(key, sizeof(key), "key%d", i);
+        av_dict_set_int(&dict, key, -i, 0);
+    }
+    av_dict_set(&dict, "key10", "dup", AV_DICT_MULTIKEY);
+    printf("%d entries\n", av_dict_count(dict));
+
+    for (i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "Key%d", i);
+        e = av_dict_get(dict, key, NULL, 0);
+        if (!e) {
+            missing++;
+            continue;
+        }
+        if (strtol(e->value, NULL, 10) != (i % 5 ? i : -i))
+            printf("%s: wrong value %s\n", key, e->value);
+    }
+    printf("%d missing\n", missing);
+    printf("%s\n", av_dict_get(dict, "Key", NULL, AV_DICT_MATCH_CASE) ? "found" : "not found");
+    e = NULL;
+    while ((e = av_dict_get(dict, "key10", e, 0)))
+        printf("%s %s\n", e->key, e->value);
+    e = NULL;
+    i = 0;
+    while ((e = av_dict_get(dict, "key99", e, AV_DICT_IGNORE_SUFFIX)))
+        i++;
+    printf("%d entries with prefix key99\n", i);
+    av_dict_free(&dict);
+}
+
+/**
+ * times building and querying dictionaries of the given size,
+ * run with "dict <size> [<iterations>]"
+ */
+static void benchmark(int size, int iterations)
+{
+    AVDictionary *dict = NULL;
+    char key[64];
+    int64_t set = 0, get = 0, t;
+    int i, n;
+
+    for (n = 0; n < iterations; n++) {
+        t = av_gettime_relative();
+        for (i = 0; i < size; i++) {
+            snprintf(key, sizeof(key), "lavfi.signalstats.KEY%d", i);
+            av_dict_set(&dict, key, "0.000000", 0);
+        }
+        set += av_gettime_relative() - t;
+
+        t = av_gettime_relative();
+        for (i = 0; i < size; i++) {
+            snprintf(key, sizeof(key), "lavfi.signalstats.key%d", size - 1 - i);
+            if (!av_dict_get(dict, key, NULL, 0))
+                abort();
+        }
+        get += av_gettime_relative() - t;
+        av_dict_free(&dict);
+    }
+    printf("%d entries: %f us per av_dict_set(), %f us per av_dict_get()\n", size,
+           (double)set / size / iterations, (double)get / size / iterations);
+}
+
+static void test_shrink(void)
+{
+    AVDictionary *dict = NULL;
+    AVDictionaryEntry *e;
+    char key[32];
+    int i;
+
+    for (i = 0; i < 20; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        av_dict_set_int(&dict, key, i, 0);
+    }
+    for (i = 0; i < 10; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        av_dict_set(&dict, key, NULL, 0);
+    }
+    av_dict_set(&dict, "new", "1", 0);
+    e = av_dict_get(dict, "new", NULL, 0);
+    printf("new %s\n", e ? e->value : "not found");
+    av_dict_set(&dict, "new", "2", 0);
+    av_dict_set(&dict, "key15", "15 new", 0);
+    printf("%d entries\n", av_dict_count(dict));
+    e = NULL;
+    while ((e = av_dict_get(dict, "", e, AV_DICT_IGNORE_SUFFIX)))
+        printf("%s %s\n", e->key, e->value);
+    av_dict_free(&dict);
+}
+
+int main(int argc, char **argv)
 {
     AVDictionary *dict = NULL;
     AVDictionaryEntry *e;
     char *buffer = NULL;
 
+    if (argc > 1) {
+        benchmark(FFMAX(atoi(argv[1]), 1), argc > 2 ? FFMAX(atoi(argv[2]), 1) : 100);
+        return 0;
+    }
+
     printf("Testing av_dict_get_string() and av_dict_parse_string()\n");
     av_dict_get_string(dict, &buffer, '=', ',');
     printf("%s\n", buffer);
@@ -132,5 +242,11 @@ int main(void)
     printf("%s\n", e->value);
     av_dict_free(&dict);
 
+    printf("\nTesting a large dictionary\n");
+    test_large();
+
+    printf("\nTesting a dictionary shrunk below the index size\n");
+    test_shrink();
+
     return 0;
 }
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "libavutil/common.h"
 #include "libavutil/libm.h"
 #include "libavutil/eval.h"
 
@@ -168,6 +169,33 @@ int main(int argc, char **argv)
     if (ret < 0)
         printf("av_expr_parse_and_eval failed\n");
 
+    /* check av_expr_eval_batch() against av_expr_eval() with a varying PI */
+    for (expr = exprs; *expr; expr++) {
+        double values[FF_ARRAY_ELEMS(const_values)], pis[37], batch[37];
+        const double *arrays[FF_ARRAY_ELEMS(const_values)] = { pis };
+        AVExpr *e0, *e1;
+
+        if (av_expr_parse(&e0, *expr, const_names, NULL, NULL, NULL, NULL, 0, NULL) < 0)
+            continue;
+        if (av_expr_parse(&e1, *expr, const_names, NULL, NULL, NULL, NULL, 0, NULL) < 0) {
+            av_expr_free(e0);
+            continue;
+        }
+        memcpy(values, const_values, sizeof(values));
+        for (i = 0; i < FF_ARRAY_ELEMS(pis); i++)
+            pis[i] = (i - 10) * 0.37;
+        av_expr_eval_batch(e1, batch, FF_ARRAY_ELEMS(pis), const_values, arrays, NULL);
+        for (i = 0; i < FF_ARRAY_ELEMS(pis); i++) {
+            values[0] = pis[i];
+            d = av_expr_eval(e0, values, NULL);
+            if (d != batch[i] && !(isnan(d) && isnan(batch[i])))
+                printf("'%s' for PI=%f: av_expr_eval_batch() %f != av_expr_eval() %f\n",
+                       *expr, pis[i], batch[i], d);
+        }
+        av_expr_free(e0);
+        av_expr_free(e1);
+    }
+
     if (argc > 1 && !strcmp(argv[1], "-t")) {
         for (i = 0; i < 1050; i++) {
             START_TIMER;
@@ -423,25 +423,29 @@ av_cold int swri_rematrix_init(SwrContext *s){
             s->mix_any_f = (mix_any_func_type*)get_mix_any_func_clip_s16(s);
         }
     }else if(s->midbuf.fmt == AV_SAMPLE_FMT_FLTP){
-        s->native_matrix = av_calloc(nb_in * nb_out, sizeof(float));
+        /* the extra trailing 1.0 lets mix_2_1 accumulate into its output */
+        s->native_matrix = av_calloc(nb_in * nb_out + 1, sizeof(float));
         s->native_one    = av_mallocz(sizeof(float));
         if (!s->native_matrix || !s->native_one)
             return AVERROR(ENOMEM);
         for (i = 0; i < nb_out; i++)
             for (j = 0; j < nb_in; j++)
                 ((float*)s->native_matrix)[i * nb_in + j] = s->matrix[i][j];
+        ((float*)s->native_matrix)[nb_in * nb_out] = 1.0;
         *((float*)s->native_one) = 1.0;
         s->mix_1_1_f = (mix_1_1_func_type*)copy_float;
         s->mix_2_1_f = (mix_2_1_func_type*)sum2_float;
         s->mix_any_f = (mix_any_func_type*)get_mix_any_func_float(s);
     }else if(s->midbuf.fmt == AV_SAMPLE_FMT_DBLP){
-        s->native_matrix = av_calloc(nb_in * nb_out, sizeof(double));
+        /* the extra trailing 1.0 lets mix_2_1 accumulate into its output */
+        s->native_matrix = av_calloc(nb_in * nb_out + 1, sizeof(double));
         s->native_one    = av_mallocz(sizeof(double));
         if (!s->native_matrix || !s->native_one)
             return AVERROR(ENOMEM);
         for (i = 0; i < nb_out; i++)
             for (j = 0; j < nb_in; j++)
                 ((double*)s->native_matrix)[i * nb_in + j] = s->matrix[i][j];
+        ((double*)s->native_matrix)[nb_in * nb_out] = 1.0;
         *((double*)s->native_one) = 1.0;
         s->mix_1_1_f = (mix_1_1_func_type*)copy_double;
         s->mix_2_1_f = (mix_2_1_func_type*)sum2_double;
@@ -494,6 +498,17 @@ av_cold void swri_rematrix_free(SwrContext *s){
     av_freep(&s->native_simd_one);
 }
 
+static void mix_2_1(SwrContext *s, uint8_t *out, const uint8_t *in1, const uint8_t *in2,
+                    int index1, int index2, int len, int len1, int off)
+{
+    if(s->mix_2_1_simd && len1)
+        s->mix_2_1_simd(out    , in1    , in2    , s->native_simd_matrix, index1, index2, len1);
+    else
+        s->mix_2_1_f   (out    , in1    , in2    , s->native_matrix, index1, index2, len1);
+    if(len != len1)
+        s->mix_2_1_f   (out+off, in1+off, in2+off, s->native_matrix, index1, index2, len-len1);
+}
+
 int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mustcopy){
     int out_i, in_i, i, j;
     int len1 = 0;
@@ -534,40 +549,48 @@ int swri_rematrix(SwrContext *s, AudioData *out, AudioData *in, int len, int mus
         case 2: {
             int in_i1 = s->matrix_ch[out_i][1];
             int in_i2 = s->matrix_ch[out_i][2];
-            if(s->mix_2_1_simd && len1)
-                s->mix_2_1_simd(out->ch[out_i]    , in->ch[in_i1]    , in->ch[in_i2]    , s->native_simd_matrix, in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len1);
-            else
-                s->mix_2_1_f   (out->ch[out_i]    , in->ch[in_i1]    , in->ch[in_i2]    , s->native_matrix, in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len1);
-            if(len != len1)
-                s->mix_2_1_f   (out->ch[out_i]+off, in->ch[in_i1]+off, in->ch[in_i2]+off, s->native_matrix, in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len-len1);
+            mix_2_1(s, out->ch[out_i], in->ch[in_i1], in->ch[in_i2],
+                    in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len, len1, off);
             break;}
         default:
-            if(s->int_sample_fmt == AV_SAMPLE_FMT_FLTP){
-                for(i=0; i<len; i++){
-                    float v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((float*)in->ch[in_i])[i] * s->matrix_flt[out_i][in_i];
-                    }
-                    ((float*)out->ch[out_i])[i]= v;
-                }
-            }else if(s->int_sample_fmt == AV_SAMPLE_FMT_DBLP){
-                for(i=0; i<len; i++){
-                    double v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((double*)in->ch[in_i])[i] * s->matrix[out_i][in_i];
-                    }
-                    ((double*)out->ch[out_i])[i]= v;
+            if(s->int_sample_fmt == AV_SAMPLE_FMT_FLTP || s->int_sample_fmt == AV_SAMPLE_FMT_DBLP){
+                /* Accumulate one input at a time into the output, the last
+                 * native_matrix entry is 1.0. The per sample summation order
+                 * is the same as for a direct dot product. */
+                int one   = in->ch_count*out->ch_count;
+                int in_i1 = s->matrix_ch[out_i][1];
+                int in_i2 = s->matrix_ch[out_i][2];
+                mix_2_1(s, out->ch[out_i], in->ch[in_i1], in->ch[in_i2],
+                        in->ch_count*out_i + in_i1, in->ch_count*out_i + in_i2, len, len1, off);
+                for(j=3; j<=s->matrix_ch[out_i][0]; j++){
+                    in_i= s->matrix_ch[out_i][j];
+                    mix_2_1(s, out->ch[out_i], out->ch[out_i], in->ch[in_i],
+                            one, in->ch_count*out_i + in_i, len, len1, off);
                 }
             }else{
-                for(i=0; i<len; i++){
-                    int v=0;
-                    for(j=0; j<s->matrix_ch[out_i][0]; j++){
-                        in_i= s->matrix_ch[out_i][1+j];
-                        v+= ((int16_t*)in->ch[in_i])[i] * s->matrix32[out_i][in_i];
+                int nb_in = s->matrix_ch[out_i][0];
+                const uint8_t *src[SWR_CH_MAX];
+                int coeff[SWR_CH_MAX];
+
+                for(j=0; j<nb_in; j++){
+                    in_i    = s->matrix_ch[out_i][1+j];
+                    src[j]  = in->ch[in_i];
+                    coeff[j]= s->matrix32[out_i][in_i];
+                }
+                if(s->int_sample_fmt == AV_SAMPLE_FMT_S32P){
+                    for(i=0; i<len; i++){
+                        int64_t v=0;
+                        for(j=0; j<nb_in; j++)
+                            v+= ((const int32_t*)src[j])[i] * (int64_t)coeff[j];
+                        ((int32_t*)out->ch[out_i])[i]= (v + 16384)>>15;
+                    }
+                }else{
+                    for(i=0; i<len; i++){
+                        int v=0;
+                        for(j=0; j<nb_in; j++)
+                            v+= ((const int16_t*)src[j])[i] * coeff[j];
+                        ((int16_t*)out->ch[out_i])[i]= (v + 16384)>>15;
                     }
-                    ((int16_t*)out->ch[out_i])[i]= (v + 16384)>>15;
                 }
             }
         }
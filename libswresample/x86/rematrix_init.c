@@ -77,11 +77,11 @@ av_cold int swri_rematrix_init_x86(struct SwrContext *s){
             s->mix_1_1_simd = ff_mix_1_1_a_float_avx;
             s->mix_2_1_simd = ff_mix_2_1_a_float_avx;
         }
-        s->native_simd_matrix = av_mallocz_array(num, sizeof(float));
+        s->native_simd_matrix = av_mallocz_array(num + 1, sizeof(float));
         s->native_simd_one = av_mallocz(sizeof(float));
         if (!s->native_simd_matrix || !s->native_simd_one)
             return AVERROR(ENOMEM);
-        memcpy(s->native_simd_matrix, s->native_matrix, num * sizeof(float));
+        memcpy(s->native_simd_matrix, s->native_matrix, (num + 1) * sizeof(float));
         memcpy(s->native_simd_one, s->native_one, sizeof(float));
     }
 #endif
@@ -168,12 +168,27 @@ static const struct {
     #if CONFIG_HFLIP_FILTER
         { "vf_hflip", checkasm_check_vf_hflip },
     #endif
+    #if CONFIG_LUT3D_FILTER
+        { "vf_lut3d", checkasm_check_vf_lut3d },
+    #endif
     #if CONFIG_NLMEANS_FILTER
         { "vf_nlmeans", checkasm_check_nlmeans },
     #endif
+    #if CONFIG_PSNR_FILTER
+        { "vf_psnr", checkasm_check_vf_psnr },
+    #endif
+    #if CONFIG_SSIM_FILTER
+        { "vf_ssim", checkasm_check_vf_ssim },
+    #endif
     #if CONFIG_THRESHOLD_FILTER
         { "vf_threshold", checkasm_check_vf_threshold },
     #endif
+    #if CONFIG_TONEMAP_FILTER
+        { "vf_tonemap", checkasm_check_vf_tonemap },
+    #endif
+#endif
+#if CONFIG_SWRESAMPLE
+    { "sw_resample", checkasm_check_sw_resample },
 #endif
 #if CONFIG_SWSCALE
     { "sw_rgb", checkasm_check_sw_rgb },
@@ -0,0 +1,227 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/channel_layout.h"
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#include "libswresample/resample.h"
+#include "libswresample/swresample_internal.h"
+
+#include "checkasm.h"
+
+#define FILTER_LENGTH 32
+#define FILTER_ALLOC  FFALIGN(FILTER_LENGTH, 8)
+#define PHASE_COUNT   256
+#define DST_LEN       256
+/* enough input for DST_LEN output samples at a 44100 -> 48000 ratio */
+#define SRC_LEN       (DST_LEN + FILTER_ALLOC + 16)
+
+#define MIX_LEN       256
+
+static void randomize_filter(void *bank, enum AVSampleFormat fmt, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P: ((int16_t *)bank)[i] = (int)(rnd() & 0x3ff) - 0x200;           break;
+        case AV_SAMPLE_FMT_S32P: ((int32_t *)bank)[i] = (int)(rnd() & 0x1ffffff) - 0x1000000;   break;
+        case AV_SAMPLE_FMT_FLTP: ((float   *)bank)[i] = (int)(rnd() & 0xffff) / 65536.0f - 0.5f; break;
+        case AV_SAMPLE_FMT_DBLP: ((double  *)bank)[i] = (int)(rnd() & 0xffff) / 65536.0  - 0.5;  break;
+        }
+    }
+}
+
+static void randomize_samples(void *buf, enum AVSampleFormat fmt, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P: ((int16_t *)buf)[i] = rnd();                                   break;
+        case AV_SAMPLE_FMT_S32P: ((int32_t *)buf)[i] = rnd();                                   break;
+        case AV_SAMPLE_FMT_FLTP: ((float   *)buf)[i] = (int)(rnd() & 0xffff) / 32768.0f - 1.0f; break;
+        case AV_SAMPLE_FMT_DBLP: ((double  *)buf)[i] = (int)(rnd() & 0xffff) / 32768.0  - 1.0;  break;
+        }
+    }
+}
+
+static int compare_samples(const void *a, const void *b, enum AVSampleFormat fmt,
+                           int n, int linear)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P:
+            if (FFABS(((const int16_t *)a)[i] - ((const int16_t *)b)[i]) > linear)
+                return 0;
+            break;
+        case AV_SAMPLE_FMT_S32P:
+            if (FFABS((int64_t)((const int32_t *)a)[i] - ((const int32_t *)b)[i]) > linear)
+                return 0;
+            break;
+        case AV_SAMPLE_FMT_FLTP:
+            if (!float_near_abs_eps(((const float *)a)[i], ((const float *)b)[i], 1e-5))
+                return 0;
+            break;
+        case AV_SAMPLE_FMT_DBLP:
+            if (!double_near_abs_eps(((const double *)a)[i], ((const double *)b)[i], 1e-12))
+                return 0;
+            break;
+        }
+    }
+    return 1;
+}
+
+static void check_resample(enum AVSampleFormat fmt, const char *name)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,  [SRC_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [DST_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [DST_LEN * 8]);
+    int bps = av_get_bytes_per_sample(fmt);
+    ResampleContext c = { 0 };
+    int linear;
+
+    declare_func(int, ResampleContext *c, void *dst, const void *src,
+                 int n, int update_ctx);
+
+    /* phase_count + 1 filters, the linear variant interpolates with the next one */
+    c.filter_bank = av_mallocz((PHASE_COUNT + 1) * FILTER_ALLOC * bps);
+    if (!c.filter_bank) {
+        fail();
+        return;
+    }
+    c.format        = fmt;
+    c.felem_size    = bps;
+    c.filter_length = FILTER_LENGTH;
+    c.filter_alloc  = FILTER_ALLOC;
+    c.phase_count   = PHASE_COUNT;
+    c.src_incr      = 160;
+    c.dst_incr      = 147 * PHASE_COUNT;
+    c.dst_incr_div  = c.dst_incr / c.src_incr;
+    c.dst_incr_mod  = c.dst_incr % c.src_incr;
+    swri_resample_dsp_init(&c);
+
+    for (linear = 0; linear < 2; linear++) {
+        void *func = linear ? c.dsp.resample_linear : c.dsp.resample_common;
+
+        if (check_func(func, "resample_%s_%s", linear ? "linear" : "common", name)) {
+            int i, ret0, ret1, index, frac, ref_index, ref_frac;
+
+            for (i = 0; i <= PHASE_COUNT; i++)
+                randomize_filter(c.filter_bank + i * FILTER_ALLOC * bps, fmt, FILTER_LENGTH);
+            randomize_samples(src, fmt, SRC_LEN);
+            index = rnd() % PHASE_COUNT;
+            frac  = rnd() % c.src_incr;
+
+            memset(dst0, 0, DST_LEN * bps);
+            memset(dst1, 0, DST_LEN * bps);
+            c.index = index;
+            c.frac  = frac;
+            ret0 = call_ref(&c, dst0, src, DST_LEN, 1);
+            ref_index = c.index;
+            ref_frac  = c.frac;
+            c.index = index;
+            c.frac  = frac;
+            ret1 = call_new(&c, dst1, src, DST_LEN, 1);
+            if (ret0 != ret1 || c.index != ref_index || c.frac != ref_frac ||
+                !compare_samples(dst0, dst1, fmt, DST_LEN, linear))
+                fail();
+
+            c.index = 0;
+            c.frac  = 0;
+            bench_new(&c, dst1, src, DST_LEN, 0);
+        }
+    }
+    av_freep(&c.filter_bank);
+}
+
+static void check_rematrix(void)
+{
+    LOCAL_ALIGNED_32(float, src0, [MIX_LEN + 1]);
+    LOCAL_ALIGNED_32(float, src1, [MIX_LEN + 1]);
+    LOCAL_ALIGNED_32(float, dst0, [MIX_LEN + 1]);
+    LOCAL_ALIGNED_32(float, dst1, [MIX_LEN + 1]);
+    SwrContext *swr;
+    void *matrix;
+    int off, i;
+
+    swr = swr_alloc_set_opts(NULL, AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLTP, 48000,
+                             AV_CH_LAYOUT_5POINT1, AV_SAMPLE_FMT_FLTP, 48000, 0, NULL);
+    if (!swr || swr_init(swr) < 0) {
+        fail();
+        swr_free(&swr);
+        return;
+    }
+    /* the simd functions use native_simd_matrix, a copy of native_matrix */
+    matrix = swr->mix_2_1_simd ? swr->native_simd_matrix : swr->native_matrix;
+
+    randomize_samples(src0, AV_SAMPLE_FMT_FLTP, MIX_LEN + 1);
+    randomize_samples(src1, AV_SAMPLE_FMT_FLTP, MIX_LEN + 1);
+
+    if (check_func(swr->mix_1_1_simd ? swr->mix_1_1_simd : swr->mix_1_1_f, "mix_1_1_float")) {
+        declare_func(void, void *out, const void *in, void *coeffp,
+                     integer index, integer len);
+
+        /* the aligned functions have to handle unaligned buffers as well */
+        for (off = 0; off < 2; off++) {
+            for (i = 0; i < 4; i++) {
+                call_ref(dst0 + off, src0 + off, matrix, i, MIX_LEN);
+                call_new(dst1 + off, src0 + off, matrix, i, MIX_LEN);
+                if (!float_near_abs_eps_array(dst0 + off, dst1 + off, 1e-6, MIX_LEN))
+                    fail();
+            }
+        }
+        bench_new(dst1, src0, matrix, 0, MIX_LEN);
+    }
+    report("mix_1_1");
+
+    if (check_func(swr->mix_2_1_simd ? swr->mix_2_1_simd : swr->mix_2_1_f, "mix_2_1_float")) {
+        declare_func(void, void *out, const void *in1, const void *in2,
+                     void *coeffp, integer index1, integer index2, integer len);
+
+        for (off = 0; off < 2; off++) {
+            for (i = 0; i < 4; i++) {
+                call_ref(dst0 + off, src0 + off, src1 + off, matrix, i, 5 - i, MIX_LEN);
+                call_new(dst1 + off, src0 + off, src1 + off, matrix, i, 5 - i, MIX_LEN);
+                if (!float_near_abs_eps_array(dst0 + off, dst1 + off, 1e-6, MIX_LEN))
+                    fail();
+            }
+        }
+        bench_new(dst1, src0, src1, matrix, 0, 1, MIX_LEN);
+    }
+    report("mix_2_1");
+
+    swr_free(&swr);
+}
+
+void checkasm_check_sw_resample(void)
+{
+    check_resample(AV_SAMPLE_FMT_S16P, "int16");
+    check_resample(AV_SAMPLE_FMT_S32P, "int32");
+    check_resample(AV_SAMPLE_FMT_FLTP, "float");
+    check_resample(AV_SAMPLE_FMT_DBLP, "double");
+    report("resample");
+
+    check_rematrix();
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/vf_lut3d.h"
+#include "libavutil/mem.h"
+
+#define WIDTH 256
+#define LUT_SIZE 33
+
+static float rnd_float(float max)
+{
+    return (float)rnd() / UINT32_MAX * max;
+}
+
+void checkasm_check_vf_lut3d(void)
+{
+    LOCAL_ALIGNED_32(float, src, [3 * WIDTH]);
+    LOCAL_ALIGNED_32(float, dst_ref, [3 * WIDTH]);
+    LOCAL_ALIGNED_32(float, dst_new, [3 * WIDTH]);
+    struct rgbvec *lut = av_malloc_array(MAX_LEVEL * MAX_LEVEL * MAX_LEVEL, sizeof(*lut));
+    LUT3DDSPContext dsp;
+    int i, j, k;
+
+    declare_func(void, float *dst_r, float *dst_g, float *dst_b,
+                 const float *src_r, const float *src_g, const float *src_b,
+                 const struct rgbvec *lut, int lutsize, int len);
+
+    if (!lut)
+        return;
+
+    for (i = 0; i < LUT_SIZE; i++) {
+        for (j = 0; j < LUT_SIZE; j++) {
+            for (k = 0; k < LUT_SIZE; k++) {
+                struct rgbvec *v = &lut[(i * MAX_LEVEL + j) * MAX_LEVEL + k];
+                v->r = rnd_float(1.0f);
+                v->g = rnd_float(1.0f);
+                v->b = rnd_float(1.0f);
+            }
+        }
+    }
+
+    for (i = 0; i < 3 * WIDTH; i++)
+        src[i] = rnd_float(LUT_SIZE - 1);
+    /* the upper edge of the LUT has no next entry to interpolate with */
+    src[0] = src[WIDTH + 1] = src[2 * WIDTH + 2] = LUT_SIZE - 1;
+    src[3] = src[WIDTH + 3] = src[2 * WIDTH + 3] = LUT_SIZE - 1;
+
+    ff_lut3d_init(&dsp);
+
+    if (check_func(dsp.interp_tetrahedral, "interp_tetrahedral")) {
+        call_ref(dst_ref, dst_ref + WIDTH, dst_ref + 2 * WIDTH,
+                 src, src + WIDTH, src + 2 * WIDTH, lut, LUT_SIZE, WIDTH);
+        call_new(dst_new, dst_new + WIDTH, dst_new + 2 * WIDTH,
+                 src, src + WIDTH, src + 2 * WIDTH, lut, LUT_SIZE, WIDTH);
+        if (!float_near_abs_eps_array(dst_ref, dst_new, 1e-5f, 3 * WIDTH))
+            fail();
+        bench_new(dst_new, dst_new + WIDTH, dst_new + 2 * WIDTH,
+                  src, src + WIDTH, src + 2 * WIDTH, lut, LUT_SIZE, WIDTH);
+    }
+    report("interp_tetrahedral");
+
+    av_free(lut);
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "checkasm.h"
+#include "libavfilter/psnr.h"
+#include "libavutil/intreadwrite.h"
+
+#define WIDTH 1920
+
+static void check_sse_line(int bpp)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf, [WIDTH * 2]);
+    LOCAL_ALIGNED_32(uint8_t, ref, [WIDTH * 2]);
+    PSNRDSPContext dsp;
+    const int mask = (1 << bpp) - 1;
+    int i;
+
+    declare_func(uint64_t, const uint8_t *buf, const uint8_t *ref, int w);
+
+    for (i = 0; i < WIDTH; i++) {
+        if (bpp > 8) {
+            AV_WN16A(buf + 2 * i, rnd() & mask);
+            AV_WN16A(ref + 2 * i, rnd() & mask);
+        } else {
+            buf[i] = rnd() & mask;
+            ref[i] = rnd() & mask;
+        }
+    }
+
+    ff_psnr_init(&dsp, bpp);
+
+    if (check_func(dsp.sse_line, "sse_line_%d", bpp)) {
+        /* odd widths exercise the tail handling */
+        if (call_ref(buf, ref, WIDTH) != call_new(buf, ref, WIDTH) ||
+            call_ref(buf, ref, WIDTH - 7) != call_new(buf, ref, WIDTH - 7))
+            fail();
+        bench_new(buf, ref, WIDTH);
+    }
+}
+
+void checkasm_check_vf_psnr(void)
+{
+    check_sse_line(8);
+    report("sse_line_8");
+
+    check_sse_line(10);
+    check_sse_line(16);
+    report("sse_line_16");
+}
@@ -0,0 +1,116 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/ssim.h"
+
+#define BLOCKS 64
+#define STRIDE (BLOCKS * 4 + 32)
+
+#define randomize_buffers(buf, size)      \
+    do {                                  \
+        int j;                            \
+        for (j = 0; j < size; j++)        \
+            buf[j] = rnd() & 0xFF;        \
+    } while (0)
+
+static void ssim_4x4_sums(const uint8_t *buf, const uint8_t *ref,
+                          int (*sums)[4], int w)
+{
+    int x, y, z;
+
+    for (z = 0; z < w; z++) {
+        memset(sums[z], 0, sizeof(sums[z]));
+        for (y = 0; y < 4; y++) {
+            for (x = 0; x < 4; x++) {
+                int a = buf[z * 4 + x + y * STRIDE];
+                int b = ref[z * 4 + x + y * STRIDE];
+
+                sums[z][0] += a;
+                sums[z][1] += b;
+                sums[z][2] += a * a + b * b;
+                sums[z][3] += a * b;
+            }
+        }
+    }
+}
+
+static void check_ssim_4x4_line(SSIMDSPContext *dsp)
+{
+    LOCAL_ALIGNED_16(uint8_t, buf, [STRIDE * 4]);
+    LOCAL_ALIGNED_16(uint8_t, ref,  [STRIDE * 4]);
+    LOCAL_ALIGNED_16(int, sums_ref, [BLOCKS], [4]);
+    LOCAL_ALIGNED_16(int, sums_new, [BLOCKS], [4]);
+
+    declare_func(void, const uint8_t *buf, ptrdiff_t buf_stride,
+                 const uint8_t *ref, ptrdiff_t ref_stride,
+                 int (*sums)[4], int w);
+
+    randomize_buffers(buf, STRIDE * 4);
+    randomize_buffers(ref,  STRIDE * 4);
+
+    if (check_func(dsp->ssim_4x4_line, "ssim_4x4_line")) {
+        memset(sums_ref, 0, sizeof(int[BLOCKS][4]));
+        memset(sums_new, 0, sizeof(int[BLOCKS][4]));
+        call_ref(buf, STRIDE, ref, STRIDE, sums_ref, BLOCKS);
+        call_new(buf, STRIDE, ref, STRIDE, sums_new, BLOCKS);
+        if (memcmp(sums_ref, sums_new, sizeof(int[BLOCKS][4])))
+            fail();
+        bench_new(buf, STRIDE, ref, STRIDE, sums_new, BLOCKS);
+    }
+}
+
+static void check_ssim_end_line(SSIMDSPContext *dsp)
+{
+    LOCAL_ALIGNED_16(uint8_t, buf, [STRIDE * 8]);
+    LOCAL_ALIGNED_16(uint8_t, ref,  [STRIDE * 8]);
+    LOCAL_ALIGNED_16(int, sum0, [BLOCKS + 1], [4]);
+    LOCAL_ALIGNED_16(int, sum1, [BLOCKS + 1], [4]);
+    float ssim_ref, ssim_new;
+
+    declare_func_float(float, const int (*sum0)[4], const int (*sum1)[4], int w);
+
+    randomize_buffers(buf, STRIDE * 8);
+    randomize_buffers(ref,  STRIDE * 8);
+    /* make the two rows similar so the scores are not all close to 0 */
+    memcpy(ref, buf, STRIDE * 4);
+    ssim_4x4_sums(buf,              ref,              sum0, BLOCKS + 1);
+    ssim_4x4_sums(buf + STRIDE * 4, ref + STRIDE * 4, sum1, BLOCKS + 1);
+
+    if (check_func(dsp->ssim_end_line, "ssim_end_line")) {
+        ssim_ref = call_ref((const int (*)[4])sum0, (const int (*)[4])sum1, BLOCKS);
+        ssim_new = call_new((const int (*)[4])sum0, (const int (*)[4])sum1, BLOCKS);
+        if (!float_near_abs_eps(ssim_ref, ssim_new, BLOCKS * 1e-5f))
+            fail();
+        bench_new((const int (*)[4])sum0, (const int (*)[4])sum1, BLOCKS);
+    }
+}
+
+void checkasm_check_vf_ssim(void)
+{
+    SSIMDSPContext dsp;
+
+    ff_ssim_init(&dsp);
+
+    check_ssim_4x4_line(&dsp);
+    report("ssim_4x4_line");
+
+    check_ssim_end_line(&dsp);
+    report("ssim_end_line");
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/vf_tonemap.h"
+#include "libavutil/mem.h"
+
+#define WIDTH 256
+
+static const struct {
+    const char *name;
+    float param;
+} algorithms[TONEMAP_MAX] = {
+    [TONEMAP_NONE]     = { "none",     1.0f },
+    [TONEMAP_LINEAR]   = { "linear",   1.0f },
+    [TONEMAP_GAMMA]    = { "gamma",    1.8f },
+    [TONEMAP_CLIP]     = { "clip",     1.0f },
+    [TONEMAP_REINHARD] = { "reinhard", 1.0f },
+    [TONEMAP_HABLE]    = { "hable",    1.0f },
+    [TONEMAP_MOBIUS]   = { "mobius",   0.3f },
+};
+
+static void check_tonemap(float desat)
+{
+    LOCAL_ALIGNED_32(float, src, [3 * WIDTH]);
+    LOCAL_ALIGNED_32(float, dst_ref, [3 * WIDTH]);
+    LOCAL_ALIGNED_32(float, dst_new, [3 * WIDTH]);
+    static const float coeffs[3] = { 0.2126f, 0.7152f, 0.0722f };
+    const float peak = 10.0f;
+    TonemapDSPContext dsp;
+    int i;
+
+    declare_func(void, float *dst_r, float *dst_g, float *dst_b,
+                 const float *src_r, const float *src_g, const float *src_b,
+                 const float *coeffs, float desat, float param, float peak,
+                 int width);
+
+    for (i = 0; i < 3 * WIDTH; i++)
+        src[i] = (float)rnd() / UINT32_MAX * peak;
+
+    for (i = 0; i < TONEMAP_MAX; i++) {
+        float param = algorithms[i].param;
+
+        ff_tonemap_init(&dsp, i);
+
+        if (check_func(dsp.tonemap_line, "tonemap_%s%s", algorithms[i].name, desat > 0 ? "_desat" : "")) {
+            call_ref(dst_ref, dst_ref + WIDTH, dst_ref + 2 * WIDTH,
+                     src, src + WIDTH, src + 2 * WIDTH, coeffs, desat, param, peak, WIDTH);
+            call_new(dst_new, dst_new + WIDTH, dst_new + 2 * WIDTH,
+                     src, src + WIDTH, src + 2 * WIDTH, coeffs, desat, param, peak, WIDTH);
+            if (!float_near_abs_eps_array_ulp(dst_ref, dst_new, 1e-6f, 16, 3 * WIDTH))
+                fail();
+            bench_new(dst_new, dst_new + WIDTH, dst_new + 2 * WIDTH,
+                      src, src + WIDTH, src + 2 * WIDTH, coeffs, desat, param, peak, WIDTH);
+        }
+    }
+}
+
+void checkasm_check_vf_tonemap(void)
+{
+    check_tonemap(0.0f);
+    check_tonemap(2.0f);
+    report("tonemap");
+}
@@ -0,0 +1,251 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/intfloat.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "libavfilter/dnn/dnn_backend_native.h"
+#include "libavfilter/dnn/dnn_backend_native_layer_conv2d.h"
+
+#define EPSON 0.00001
+
+#define CLAMP_TO_EDGE(x, w) ((x) < 0 ? 0 : ((x) >= (w) ? (w - 1) : (x)))
+
+static AVLFG lfg;
+
+static float rnd_float(void)
+{
+    return av_lfg_get(&lfg) / (float)UINT32_MAX - 0.5f;
+}
+
+// the direct convolution the native backend used before dnn_execute_layer_conv2d()
+static void convolve_ref(const float *input, float *output, const ConvolutionalParams *conv_params, int width, int height)
+{
+    int radius = conv_params->kernel_size >> 1;
+    int src_linesize = width * conv_params->input_num;
+    int filter_linesize = conv_params->kernel_size * conv_params->input_num;
+    int filter_size = conv_params->kernel_size * filter_linesize;
+    int pad_size = (conv_params->padding_method == VALID) ? (conv_params->kernel_size - 1) / 2 * conv_params->dilation : 0;
+
+    for (int y = pad_size; y < height - pad_size; ++y) {
+        for (int x = pad_size; x < width - pad_size; ++x) {
+            for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter) {
+                output[n_filter] = conv_params->biases[n_filter];
+
+                for (int ch = 0; ch < conv_params->input_num; ++ch) {
+                    for (int kernel_y = 0; kernel_y < conv_params->kernel_size; ++kernel_y) {
+                        for (int kernel_x = 0; kernel_x < conv_params->kernel_size; ++kernel_x) {
+                            float input_pel;
+                            if (conv_params->padding_method == SAME_CLAMP_TO_EDGE) {
+                                int y_pos = CLAMP_TO_EDGE(y + (kernel_y - radius) * conv_params->dilation, height);
+                                int x_pos = CLAMP_TO_EDGE(x + (kernel_x - radius) * conv_params->dilation, width);
+                                input_pel = input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
+                            } else {
+                                int y_pos = y + (kernel_y - radius) * conv_params->dilation;
+                                int x_pos = x + (kernel_x - radius) * conv_params->dilation;
+                                input_pel = (x_pos < 0 || x_pos >= width || y_pos < 0 || y_pos >= height) ? 0.0 :
+                                                   input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
+                            }
+
+                            output[n_filter] += input_pel * conv_params->kernel[n_filter * filter_size + kernel_y * filter_linesize +
+                                                                                kernel_x * conv_params->input_num + ch];
+                        }
+                    }
+                }
+                switch (conv_params->activation){
+                case RELU:
+                    output[n_filter] = FFMAX(output[n_filter], 0.0);
+                    break;
+                case TANH:
+                    output[n_filter] = 2.0f  / (1.0f + exp(-2.0f * output[n_filter])) - 1.0f;
+                    break;
+                case SIGMOID:
+                    output[n_filter] = 1.0f / (1.0f + exp(-output[n_filter]));
+                    break;
+                case NONE:
+                    break;
+                case LEAKY_RELU:
+                    output[n_filter] = FFMAX(output[n_filter], 0.0) + 0.2 * FFMIN(output[n_filter], 0.0);
+                }
+            }
+            output += conv_params->output_num;
+        }
+    }
+}
+
+static int test_conv2d(int input_num, int output_num, int kernel_size, int dilation,
+                       DNNConvPaddingParam padding, DNNActivationFunc activation)
+{
+    const int width = 23, height = 17, nb_slices = 3;
+    int pad_size = padding == VALID ? (kernel_size - 1) / 2 * dilation : 0;
+    int out_width  = width  - 2 * pad_size;
+    int out_height = height - 2 * pad_size;
+    int kernel_len = input_num * output_num * kernel_size * kernel_size;
+    int output_len = out_width * out_height * output_num;
+    ConvolutionalParams params = { 0 };
+    AVFloatDSPContext *fdsp = NULL;
+    float *input, *expected_output, *output, *scratch, *kernel = NULL;
+    int i, ret = 1;
+
+    params.input_num      = input_num;
+    params.output_num     = output_num;
+    params.kernel_size    = kernel_size;
+    params.dilation       = dilation;
+    params.padding_method = padding;
+    params.activation     = activation;
+
+    input           = av_malloc_array(width * height * input_num, sizeof(*input));
+    expected_output = av_malloc_array(output_len, sizeof(*expected_output));
+    output          = av_malloc_array(output_len, sizeof(*output));
+    scratch         = av_malloc_array(dnn_layer_conv2d_scratch_size(&params), sizeof(*scratch));
+    params.kernel   = av_malloc_array(kernel_len, sizeof(*params.kernel));
+    params.biases   = av_malloc_array(output_num, sizeof(*params.biases));
+    fdsp            = avpriv_float_dsp_alloc(0);
+    if (!input || !expected_output || !output || !scratch ||
+        !params.kernel || !params.biases || !fdsp)
+        goto end;
+
+    for (i = 0; i < width * height * input_num; i++)
+        input[i] = rnd_float();
+    for (i = 0; i < kernel_len; i++)
+        params.kernel[i] = rnd_float();
+    for (i = 0; i < output_num; i++)
+        params.biases[i] = rnd_float();
+
+    convolve_ref(input, expected_output, &params, width, height);
+
+    kernel = dnn_prepare_layer_conv2d(&params);
+    if (!kernel)
+        goto end;
+    for (i = 0; i < nb_slices; i++)
+        dnn_execute_layer_conv2d(input, output, &params, kernel, width, height,
+                                 out_height *  i      / nb_slices,
+                                 out_height * (i + 1) / nb_slices, scratch, fdsp);
+
+    for (i = 0; i < output_len; i++) {
+        if (fabs(output[i] - expected_output[i]) > EPSON) {
+            printf("conv2d %d->%d k%d d%d p%d a%d: at index %d, output: %f, expected_output: %f\n",
+                   input_num, output_num, kernel_size, dilation, padding, activation,
+                   i, output[i], expected_output[i]);
+            goto end;
+        }
+    }
+    ret = 0;
+
+end:
+    av_free(input);
+    av_free(expected_output);
+    av_free(output);
+    av_free(scratch);
+    av_free(kernel);
+    av_free(params.kernel);
+    av_free(params.biases);
+    av_free(fdsp);
+    return ret;
+}
+
+static void write_conv(FILE *f, int input_num, int output_num, int kernel_size,
+                       DNNActivationFunc activation)
+{
+    int i, n = input_num * output_num * kernel_size * kernel_size + output_num;
+    uint32_t header[7] = { CONV, 1, SAME, activation, input_num, output_num, kernel_size };
+
+    fwrite(header, sizeof(header), 1, f);
+    for (i = 0; i < n; i++) {
+        uint32_t v = av_float2int(rnd_float() * 0.2f);
+        fwrite(&v, sizeof(v), 1, f);
+    }
+}
+
+/**
+ * Run an ESPCN like super resolution network, the default model layout of
+ * the sr filter, on a width x height input.
+ */
+static int bench_model(const char *filename, int width, int height, int runs)
+{
+    uint32_t layers[] = { 4 }, d2s[] = { DEPTH_TO_SPACE, 2 };
+    DNNInputData input = { .dt = DNN_FLOAT, .width = width, .height = height, .channels = 1 };
+    DNNData output;
+    DNNModel *model;
+    const char *output_name = "y";
+    int64_t t;
+    FILE *f;
+    int i;
+
+    f = fopen(filename, "wb");
+    if (!f)
+        return 1;
+    fwrite(layers, sizeof(layers), 1, f);
+    write_conv(f,  1, 64, 5, TANH);
+    write_conv(f, 64, 32, 3, TANH);
+    write_conv(f, 32,  4, 3, SIGMOID);
+    fwrite(d2s, sizeof(d2s), 1, f);
+    fclose(f);
+
+    model = ff_dnn_load_model_native(filename);
+    if (!model || model->set_input_output(model->model, &input, "x", &output_name, 1) != DNN_SUCCESS) {
+        ff_dnn_free_model_native(&model);
+        return 1;
+    }
+    for (i = 0; i < width * height; i++)
+        ((float *)input.data)[i] = rnd_float() + 0.5f;
+
+    t = av_gettime_relative();
+    for (i = 0; i < runs; i++)
+        ff_dnn_execute_model_native(model, &output, 1);
+    t = av_gettime_relative() - t;
+
+    printf("%dx%d -> %dx%d: %.2f ms per frame\n", width, height,
+           output.width, output.height, t / 1000.0 / runs);
+
+    ff_dnn_free_model_native(&model);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const DNNConvPaddingParam paddings[] = { VALID, SAME, SAME_CLAMP_TO_EDGE };
+    int p;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+
+    if (argc > 2 && !strcmp(argv[1], "-b"))
+        return bench_model(argv[2], argc > 3 ? atoi(argv[3]) : 480,
+                           argc > 4 ? atoi(argv[4]) : 270, 10);
+
+    for (p = 0; p < FF_ARRAY_ELEMS(paddings); p++) {
+        if (test_conv2d( 1, 16, 5, 1, paddings[p], TANH))
+            return 1;
+        if (test_conv2d( 3,  5, 3, 2, paddings[p], RELU))
+            return 1;
+        if (test_conv2d(16,  4, 3, 1, paddings[p], SIGMOID))
+            return 1;
+        if (test_conv2d( 4, 32, 1, 1, paddings[p], LEAKY_RELU))
+            return 1;
+        if (test_conv2d( 2,  3, 4, 1, paddings[p], NONE))
+            return 1;
+    }
+
+    return 0;
+}
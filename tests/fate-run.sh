@@ -358,6 +358,15 @@ refcmp_metadata(){
         -f null /dev/null | awk -v ref=${ref} -v fuzz=${fuzz} -f ${base}/refcmp-metadata.awk -
 }
 
+slice_threads(){
+    filter=$1
+    pixfmt=$2
+    out_pixfmt=${3:-$2}
+    ffmpeg $FLAGS $ENC_OPTS -filter_threads 4 \
+        -lavfi "testsrc2=size=320x240:rate=1:duration=3,format=${pixfmt},split[ref][tmp];[ref]${filter}:threads=1,format=${out_pixfmt}[ref1];[tmp]${filter},format=${out_pixfmt}[tmp1];[tmp1][ref1]psnr,metadata=print:key=lavfi.psnr.psnr_avg:file=-" \
+        -f null /dev/null
+}
+
 pixfmt_conversion(){
     conversion="${test#pixfmt-}"
     outdir="tests/data/pixfmt"
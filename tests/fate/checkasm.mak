@@ -22,6 +22,7 @@ FATE_CHECKASM = fate-checkasm-aacpsdsp                                  \
                 fate-checkasm-pixblockdsp                               \
                 fate-checkasm-sbrdsp                                    \
                 fate-checkasm-synth_filter                              \
+                fate-checkasm-sw_resample                               \
                 fate-checkasm-sw_rgb                                    \
                 fate-checkasm-v210dec                                   \
                 fate-checkasm-v210enc                                   \
@@ -29,7 +30,11 @@ FATE_CHECKASM = fate-checkasm-aacpsdsp                                  \
                 fate-checkasm-vf_colorspace                             \
                 fate-checkasm-vf_gblur                                  \
                 fate-checkasm-vf_hflip                                  \
+                fate-checkasm-vf_lut3d                                  \
+                fate-checkasm-vf_psnr                                   \
+                fate-checkasm-vf_ssim                                   \
                 fate-checkasm-vf_threshold                              \
+                fate-checkasm-vf_tonemap                                \
                 fate-checkasm-videodsp                                  \
                 fate-checkasm-vp8dsp                                    \
                 fate-checkasm-vp9dsp                                    \
@@ -394,6 +394,10 @@ FATE_AFILTER-yes += fate-filter-formats
 fate-filter-formats: libavfilter/tests/formats$(EXESUF)
 fate-filter-formats: CMD = run libavfilter/tests/formats$(EXESUF)
 
+FATE_AFILTER-$(CONFIG_AFIR_FILTER) += fate-filter-partconv
+fate-filter-partconv: libavfilter/tests/partconv$(EXESUF)
+fate-filter-partconv: CMD = run libavfilter/tests/partconv$(EXESUF)
+
 FATE_SAMPLES_AVCONV += $(FATE_AFILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_AFILTER-yes)
 fate-afilter: $(FATE_AFILTER-yes) $(FATE_AFILTER_SAMPLES-yes)
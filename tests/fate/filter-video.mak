@@ -793,6 +793,20 @@ fate-filter-refcmp-ssim-rgb: CMD = refcmp_metadata ssim rgb24 0.015
 FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-yuv
 fate-filter-refcmp-ssim-yuv: CMD = refcmp_metadata ssim yuv422p 0.015
 
+SLICE_THREADS_DEPS = FFMPEG LAVFI_INDEV TESTSRC2_FILTER FORMAT_FILTER SPLIT_FILTER PSNR_FILTER METADATA_FILTER NULL_MUXER
+
+FATE_FILTER-$(call ALLYES, $(SLICE_THREADS_DEPS) ZSCALE_FILTER) += fate-filter-zscale-slices-resize
+fate-filter-zscale-slices-resize: CMD = slice_threads zscale=w=176:h=144:f=spline36 yuv420p
+
+FATE_FILTER-$(call ALLYES, $(SLICE_THREADS_DEPS) ZSCALE_FILTER) += fate-filter-zscale-slices-matrix
+fate-filter-zscale-slices-matrix: CMD = slice_threads zscale=min=470bg:m=709 yuv420p
+
+FATE_FILTER-$(call ALLYES, $(SLICE_THREADS_DEPS) ZSCALE_FILTER) += fate-filter-zscale-slices-chroma
+fate-filter-zscale-slices-chroma: CMD = slice_threads zscale=min=470bg:m=709 yuv420p yuv444p
+
+FATE_FILTER-$(call ALLYES, $(SLICE_THREADS_DEPS) ZSCALE_FILTER) += fate-filter-zscale-slices-alpha
+fate-filter-zscale-slices-alpha: CMD = slice_threads zscale=w=400:h=300 yuva420p
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)